@@ -6,8 +6,16 @@
  */
 
 #include <assert.h>
+#include <algorithm>
+#include <thread>
 #include <student/application.hpp>
 
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /**
  * @brief Constructor
  *
@@ -23,13 +31,19 @@ Application::Application(int32_t width,int32_t height):Window(width,height,"izgP
   perspectiveCamera.setNear(0.1f);
   auto const aspect = static_cast<float>(width) / static_cast<float>(height);
   perspectiveCamera.setAspect(aspect);
+  setSwapChainLength(2);
   timer.reset();
 }
 
 /**
  * @brief Destructor
  */
-Application::~Application(){}
+Application::~Application(){
+  // render thread of the GPU writes into image of swap chain
+  if(method)method->gpu.waitIdle();
+  // presenter thread writes into the surface of the window
+  swapChain = nullptr;
+}
 
     
 /**
@@ -50,26 +64,64 @@ void Application::setMethod(uint32_t m){
   selectedMethod = m;
 }
 
+/**
+ * @brief This function selects number of threads that methods render with
+ *
+ * @param n number of threads, 0 selects all cores
+ */
+void Application::setThreadCount(uint32_t n){
+  if(n == 0)n = std::max(std::thread::hardware_concurrency(),1u);
+  nofThreads = n;
+  if(method)method->gpu.setThreadCount(nofThreads);
+}
+
+/**
+ * @brief This function selects number of framebuffers of swap chain
+ *
+ * Frame is rendered while previous frames are presented,
+ * 2 is double buffering, 3 is triple buffering.
+ *
+ * @param n number of images of swap chain (at least 1)
+ */
+void Application::setSwapChainLength(uint32_t n){
+  // GPU renders into image of old swap chain until it acquires image of new one
+  auto newSwapChain = std::make_unique<SwapChain>(n,[&](uint8_t const*color,uint32_t width,uint32_t height){
+    presentImage(color,width,height);
+  });
+  if(method && !zeroCopy)newSwapChain->acquire(method->gpu);
+  // new image does not contain the frame drawn into image of old swap chain
+  framePending = false;
+  swapChain = nullptr;
+  swapChain = std::move(newSwapChain);
+}
+
 void Application::createMethodIfItDoesNotExist(){
   if(method)return;
   method = methodFactories[selectedMethod]();
+  method->gpu.setThreadCount(nofThreads);
   int w,h;
   SDL_GetWindowSize(getWindow(),&w,&h);
-  method->gpu.createFramebuffer(w,h);
+  framebufferFormat = surfaceFormat();
+  method->gpu.createFramebuffer(w,h,framebufferFormat);
+  framePending = false;
+  bindSurface();
   SDL_SetWindowTitle(getWindow(),methodName.at(selectedMethod).c_str());
 }
 
 void Application::idle(){
   createMethodIfItDoesNotExist();
 
+  // events and application logic are processed while render thread of the GPU rasterizes the previous frame
   method->onUpdate(timer.elapsedFromLast());
 
   auto const proj = perspectiveCamera.getProjection();
   auto const view = orbitCamera      .getView      ();
   auto const camera = glm::vec3(glm::inverse(view)*glm::vec4(0.f,0.f,0.f,1.f));
-  method->onDraw(proj,view,light,camera);
 
   swap();
+
+  method->onDraw(proj,view,light,camera);
+  framePending = true;
 }
 
 void Application::resize(SDL_Event const&event){
@@ -79,7 +131,51 @@ void Application::resize(SDL_Event const&event){
   perspectiveCamera.setAspect(aspect);
   if(method)
     method->gpu.resizeFramebuffer(event.window.data1,event.window.data2);
+  // frame drawn before resize does not fit the surface
+  framePending = false;
+  swapChain->finish();
+  std::lock_guard<std::mutex>lock(surfaceMutex);
   reInitRenderer();
+  bindSurface();
+}
+
+/**
+ * @brief This function returns color format of the window surface.
+ *
+ * @return format of 4 byte pixels of the surface, RGBA8 if the surface has other pixels
+ */
+ColorFormat Application::surfaceFormat()const{
+  auto const format = surface->format;
+  if(format->BytesPerPixel == 4 && format->Rshift == 16 && format->Gshift == 8 && format->Bshift == 0)
+    return ColorFormat::BGRA8;
+  return ColorFormat::RGBA8;
+}
+
+/**
+ * @brief This function lets the GPU render directly into the window surface if pixels of both match.
+ *
+ * Rows of the surface go from top to bottom, GPU flips them.
+ * Otherwise the GPU renders RGBA8 frames into images of swap chain,
+ * they are converted into the surface by presenter thread of swap chain.
+ */
+void Application::bindSurface(){
+  if(!method)return;
+  auto&gpu = method->gpu;
+  auto const format = surface->format;
+  bool const rgba = format->Rshift == 0  && format->Gshift == 8 && format->Bshift == 16;
+  bool const bgra = format->Rshift == 16 && format->Gshift == 8 && format->Bshift == 0;
+  zeroCopy = !SDL_MUSTLOCK(surface) && format->BytesPerPixel == 4 && (rgba || bgra) &&
+             gpu.getFramebufferWidth () == static_cast<uint32_t>(surface->w) &&
+             gpu.getFramebufferHeight() == static_cast<uint32_t>(surface->h);
+  auto const neededFormat = zeroCopy ? surfaceFormat() : ColorFormat::RGBA8;
+  if(neededFormat != framebufferFormat){
+    framebufferFormat = neededFormat;
+    gpu.createFramebuffer(gpu.getFramebufferWidth(),gpu.getFramebufferHeight(),framebufferFormat);
+  }
+  if(zeroCopy)
+    gpu.setColorBufferMemory(static_cast<uint8_t*>(surface->pixels),static_cast<uint32_t>(surface->pitch),true);
+  else
+    swapChain->acquire(gpu);
 }
 
 void Application::mouseMotionLMask(uint32_t mState,float xrel,float yrel){
@@ -139,30 +235,116 @@ void Application::keyDown(SDL_Event const&event){
 }
 
 void Application::swap(){
-  auto&gpu = method->gpu;
+  if(!framePending)return;
+  framePending = false;
+
+  // frame drawn by the previous idle is presented when render thread of the GPU has finished it
+  method->gpu.waitFence(method->frame);
 
-  auto frame = gpu.getFramebufferColor();
-  auto const w = gpu.getFramebufferWidth();
-  auto const h = gpu.getFramebufferHeight(); 
+  // GPU has rendered directly into the surface
+  if(zeroCopy){
+    method->gpu.finish();
+    SDL_UpdateWindowSurface(window);
+    return;
+  }
+
+  // frame was rendered into image of swap chain, GPU continues with the next image
+  swapChain->present(method->gpu);
+
+  // window shows the newest presented frame, surface is not shown while presenter thread writes it
+  std::unique_lock<std::mutex>lock(surfaceMutex,std::try_to_lock);
+  if(!lock)return;
+  auto const presentedFrames = swapChain->getPresentedFrames();
+  if(presentedFrames == shownFrames)return;
+  shownFrames = presentedFrames;
+  SDL_UpdateWindowSurface(window);
+}
 
-  copyToSDLSurface(surface,frame,w,h);
+/**
+ * @brief This function is called by presenter thread of swap chain, it converts frame into the surface.
+ *
+ * @param color RGBA8 pixels
+ * @param width width of frame
+ * @param height height of frame
+ */
+void Application::presentImage(uint8_t const*color,uint32_t width,uint32_t height){
+  std::lock_guard<std::mutex>lock(surfaceMutex);
+  // frame rendered before resize of the window does not fit the surface
+  if(width != static_cast<uint32_t>(surface->w) || height != static_cast<uint32_t>(surface->h))return;
+  SDL_LockSurface(surface);
+  copyToSDLSurface(surface,color,width,height);
+  SDL_UnlockSurface(surface);
+}
+
+/**
+ * @brief This function converts the beginning of row of RGBA8 pixels into 4 byte pixels.
+ *
+ * @param dst row of surface
+ * @param src row of color buffer
+ * @param width number of pixels
+ * @param dstByte byte of destination pixel for red, green, blue and alpha channel
+ *
+ * @return number of converted pixels, the rest is converted by scalar loop
+ */
+static uint32_t swizzleRow(uint8_t*dst,uint8_t const*src,uint32_t width,uint32_t const*dstByte){
+  uint32_t x = 0;
+#if defined(__SSSE3__)
+  // pshufb picks source byte for every destination byte of 4 pixels
+  alignas(16) int8_t mask[16];
+  for(uint32_t p=0;p<4;++p)
+    for(uint32_t c=0;c<4;++c)
+      mask[p*4+dstByte[c]] = static_cast<int8_t>(p*4+c);
+  __m128i const shuffle = _mm_load_si128(reinterpret_cast<__m128i const*>(mask));
+  for(;x+4<=width;x+=4){
+    __m128i const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+x*4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+x*4),_mm_shuffle_epi8(pixels,shuffle));
+  }
+#elif defined(__SSE2__)
+  // every channel is shifted to its byte inside 32 bit pixel
+  __m128i const byteMask = _mm_set1_epi32(0xff);
+  __m128i srcShift[4],dstShift[4];
+  for(uint32_t c=0;c<4;++c){
+    srcShift[c] = _mm_cvtsi32_si128(static_cast<int>(c*8));
+    dstShift[c] = _mm_cvtsi32_si128(static_cast<int>(dstByte[c]*8));
+  }
+  for(;x+4<=width;x+=4){
+    __m128i const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+x*4));
+    __m128i result = _mm_setzero_si128();
+    for(uint32_t c=0;c<4;++c){
+      __m128i const channel = _mm_and_si128(_mm_srl_epi32(pixels,srcShift[c]),byteMask);
+      result = _mm_or_si128(result,_mm_sll_epi32(channel,dstShift[c]));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+x*4),result);
+  }
+#else
+  (void)dst;(void)src;(void)width;(void)dstByte;
+#endif
+  return x;
 }
 
 void copyToSDLSurface(SDL_Surface*surface,uint8_t const*const frame,uint32_t width,uint32_t height){
   uint32_t const bitsPerByte    = 8;
+  uint32_t const bytesPerPixel  = surface->format->BytesPerPixel;
   uint32_t const swizzleTable[] = {
       surface->format->Rshift / bitsPerByte,
       surface->format->Gshift / bitsPerByte,
       surface->format->Bshift / bitsPerByte,
+      // alpha goes to the remaining byte of 4 byte pixel
+      6 - (surface->format->Rshift + surface->format->Gshift + surface->format->Bshift) / bitsPerByte,
   };
+  bool const vectorized = bytesPerPixel == 4 &&
+    swizzleTable[0] < 4 && swizzleTable[1] < 4 && swizzleTable[2] < 4 && swizzleTable[3] < 4 &&
+    swizzleTable[0] != swizzleTable[1] && swizzleTable[0] != swizzleTable[2] && swizzleTable[1] != swizzleTable[2];
 
   uint8_t* const  pixels      = (uint8_t*)surface->pixels;
   for (size_t y = 0; y < height; ++y) {
     size_t const reversedY = height - y - 1;
-    size_t const rowStart  = reversedY * width;
-    for (size_t x = 0; x < width; ++x) {
-      auto const color    = frame + (y*width+x)*4;
-      auto const dstPixel = pixels + reversedY * surface->pitch + x * surface->format->BytesPerPixel;
+    uint8_t* const dstRow = pixels + reversedY * surface->pitch;
+    uint8_t const* const srcRow = frame + y * width * 4;
+    size_t x = vectorized ? swizzleRow(dstRow,srcRow,width,swizzleTable) : 0;
+    for (; x < width; ++x) {
+      auto const color    = srcRow + x*4;
+      auto const dstPixel = dstRow + x * bytesPerPixel;
       for (uint32_t c = 0; c < 3; ++c)
         dstPixel[swizzleTable[c]] = color[c];
     }
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 
 #include <BasicCamera/OrbitCamera.h>
 #include <BasicCamera/PerspectiveCamera.h>
@@ -15,6 +16,7 @@
 #include <student/gpu.hpp>
 #include <student/window.hpp>
 #include <student/method.hpp>
+#include <student/swapChain.hpp>
 #include <student/timer.hpp>
 
 /**
@@ -28,6 +30,8 @@ class Application: protected Window{
     void registerMethod(std::string const&name);
     void start();
     void setMethod(uint32_t m);
+    void setThreadCount(uint32_t n);
+    void setSwapChainLength(uint32_t n);
   private:
     void idle();
     void resize(SDL_Event const&event);
@@ -41,6 +45,9 @@ class Application: protected Window{
     void quit      (uint32_t key);
     void createMethodIfItDoesNotExist();
     void swap();
+    void presentImage(uint8_t const*color,uint32_t width,uint32_t height);
+    void bindSurface();
+    ColorFormat surfaceFormat()const;
 
     using MethodFactory = std::function<std::shared_ptr<Method>()>;
 
@@ -51,6 +58,7 @@ class Application: protected Window{
     std::vector<MethodFactory>     methodFactories                              ;
     std::vector<std::string>       methodName                                   ;
     size_t                         selectedMethod    = 0                        ;
+    uint32_t                       nofThreads        = 1                        ;
     std::shared_ptr<Method>        method                                       ;
 
     glm::uvec2                     windowSize                                   ;
@@ -59,11 +67,20 @@ class Application: protected Window{
 
     Timer<float>                   timer                                        ;
 
+    std::mutex                     surfaceMutex                                 ;///< guards surface, presenter thread writes it
+    uint64_t                       shownFrames       = 0                        ;///< number of presented frames shown in window
+    std::unique_ptr<SwapChain>     swapChain                                    ;///< presents frames while next frame is rendered
+    ColorFormat                    framebufferFormat = ColorFormat::RGBA8       ;///< color format of framebuffer of method
+    bool                           zeroCopy          = false                    ;///< GPU renders directly into the window surface
+    bool                           framePending      = false                    ;///< frame drawn by method is not presented yet
+
 
 };
 
 /**
- * @brief This function swaps color buffer with SDL_Surface
+ * @brief This function converts color buffer into SDL_Surface, rows are flipped and channels are swizzled.
+ *
+ * Surfaces with 4 byte pixels are converted by SIMD shuffles.
  *
  * @param surface sdl surface
  * @param color color buffer (RGBA8UI)
@@ -31,6 +31,8 @@ class Arguments{
       method              = args->getu32   ("-m",0,"selects a rendering method");
       groundTruthFile     = args->gets     ("-g","../tests/output.bmp","specify groundTruth image");
       perfTests           = args->getu32   ("-f",10,"number of frames that are tests during performance tests");
+      nofThreads          = args->getu32   ("-t",1,"number of rendering threads (0 - all cores)");
+      swapChainLength     = args->getu32   ("-b",2,"number of framebuffers of swap chain (2 - double buffering, 3 - triple buffering)");
 
       auto printHelp  = args->isPresent("-h"    ,"prints help");
       printHelp |= args->isPresent("--help","prints help");
@@ -50,5 +52,7 @@ class Arguments{
   bool takeScreenShot;///< should we take a screnshot
   bool stop = false; ///< should we immediately stop
   uint32_t perfTests; ///< number of frames in performance tests
+  uint32_t nofThreads = 1; ///< number of rendering threads
+  uint32_t swapChainLength = 2; ///< number of framebuffers of swap chain
 };
 
@@ -0,0 +1,185 @@
+/*!
+ * @file
+ * @brief This file contains implementation of command buffer.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <student/commandBuffer.hpp>
+
+/**
+ * @brief This function appends command.
+ *
+ * @param type type of command
+ * @param object vertex puller or program
+ * @param value id of uniform or number of vertices
+ *
+ * @return recorded command
+ */
+Command&CommandBuffer::record(CommandType type,ObjectID object,uint32_t value){
+  commands.emplace_back();
+  auto&command  = commands.back();
+  command.type   = type;
+  command.object = object;
+  command.value  = value;
+  return command;
+}
+
+/**
+ * @brief This function records binding of vertex puller.
+ *
+ * @param vao vertex puller
+ */
+void CommandBuffer::bindVertexPuller(VertexPullerID vao){
+  record(CommandType::BIND_VERTEX_PULLER,vao);
+}
+
+/**
+ * @brief This function records unbinding of vertex puller.
+ */
+void CommandBuffer::unbindVertexPuller(){
+  record(CommandType::UNBIND_VERTEX_PULLER);
+}
+
+/**
+ * @brief This function records activation of shader program.
+ *
+ * @param prg shader program
+ */
+void CommandBuffer::useProgram(ProgramID prg){
+  record(CommandType::USE_PROGRAM,prg);
+}
+
+/**
+ * @brief This function records setting of uniform value (1 float).
+ *
+ * @param prg shader program
+ * @param uniformId id of uniform value
+ * @param d value of uniform variable
+ */
+void CommandBuffer::programUniform1f(ProgramID prg,uint32_t uniformId,float const&d){
+  record(CommandType::PROGRAM_UNIFORM_1F,prg,uniformId).data.v1 = d;
+}
+
+/**
+ * @brief This function records setting of uniform value (2 floats).
+ *
+ * @param prg shader program
+ * @param uniformId id of uniform value
+ * @param d value of uniform variable
+ */
+void CommandBuffer::programUniform2f(ProgramID prg,uint32_t uniformId,glm::vec2 const&d){
+  record(CommandType::PROGRAM_UNIFORM_2F,prg,uniformId).data.v2 = d;
+}
+
+/**
+ * @brief This function records setting of uniform value (3 floats).
+ *
+ * @param prg shader program
+ * @param uniformId id of uniform value
+ * @param d value of uniform variable
+ */
+void CommandBuffer::programUniform3f(ProgramID prg,uint32_t uniformId,glm::vec3 const&d){
+  record(CommandType::PROGRAM_UNIFORM_3F,prg,uniformId).data.v3 = d;
+}
+
+/**
+ * @brief This function records setting of uniform value (4 floats).
+ *
+ * @param prg shader program
+ * @param uniformId id of uniform value
+ * @param d value of uniform variable
+ */
+void CommandBuffer::programUniform4f(ProgramID prg,uint32_t uniformId,glm::vec4 const&d){
+  record(CommandType::PROGRAM_UNIFORM_4F,prg,uniformId).data.v4 = d;
+}
+
+/**
+ * @brief This function records setting of uniform value (4x4 matrix).
+ *
+ * @param prg shader program
+ * @param uniformId id of uniform value
+ * @param d value of uniform variable
+ */
+void CommandBuffer::programUniformMatrix4f(ProgramID prg,uint32_t uniformId,glm::mat4 const&d){
+  record(CommandType::PROGRAM_UNIFORM_MATRIX4F,prg,uniformId).data.m4 = d;
+}
+
+/**
+ * @brief This function records clear of framebuffer.
+ *
+ * @param r red channel
+ * @param g green channel
+ * @param b blue channel
+ * @param a alpha channel
+ */
+void CommandBuffer::clear(float r,float g,float b,float a){
+  record(CommandType::CLEAR).data.v4 = glm::vec4(r,g,b,a);
+}
+
+/**
+ * @brief This function records draw call.
+ *
+ * @param nofVertices number of vertices
+ */
+void CommandBuffer::drawTriangles(uint32_t nofVertices){
+  record(CommandType::DRAW_TRIANGLES,emptyID,nofVertices);
+}
+
+/**
+ * @brief This function records draw call of part of index buffer, it is recorded as multi draw with one draw.
+ *
+ * @param nofVertices number of vertices
+ * @param firstIndex number of the first index
+ * @param baseVertex value that is added to vertex numbers (indices or vertex numbers of non indexed draw)
+ */
+void CommandBuffer::drawTriangles(uint32_t nofVertices,uint32_t firstIndex,int32_t baseVertex){
+  DrawIndirectCommand draw;
+  draw.count      = nofVertices;
+  draw.firstIndex = firstIndex;
+  draw.baseVertex = baseVertex;
+  multiDrawTriangles(&draw,1);
+}
+
+/**
+ * @brief This function records instanced draw call.
+ *
+ * @param nofVertices number of vertices of one instance
+ * @param nofInstances number of instances
+ */
+void CommandBuffer::drawTrianglesInstanced(uint32_t nofVertices,uint32_t nofInstances){
+  record(CommandType::DRAW_TRIANGLES_INSTANCED,emptyID,nofVertices).instances = nofInstances;
+}
+
+/**
+ * @brief This function records multi draw call, draws are copied.
+ *
+ * Nothing is recorded for null draws, like GPU::multiDrawTriangles does nothing for them.
+ *
+ * @param draws array of draws
+ * @param nofDraws number of draws
+ */
+void CommandBuffer::multiDrawTriangles(DrawIndirectCommand const*draws,uint32_t nofDraws){
+  if(!draws)return;
+  record(CommandType::MULTI_DRAW_TRIANGLES,emptyID,nofDraws).offset = this->draws.size();
+  this->draws.insert(this->draws.end(),draws,draws+nofDraws);
+}
+
+/**
+ * @brief This function records indirect draw call, draws are read from buffer when the command is executed.
+ *
+ * @param buffer buffer with draw records
+ * @param offset offset of the first record in bytes
+ * @param nofDraws number of records
+ */
+void CommandBuffer::drawTrianglesIndirect(BufferID buffer,uint64_t offset,uint32_t nofDraws){
+  record(CommandType::DRAW_TRIANGLES_INDIRECT,buffer,nofDraws).offset = offset;
+}
+
+/**
+ * @brief This function removes all recorded commands, memory is kept for next recording.
+ */
+void CommandBuffer::reset(){
+  commands.clear();
+  draws.clear();
+}
@@ -0,0 +1,86 @@
+/*!
+ * @file
+ * @brief This file contains command buffer that records GPU commands for later execution.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <student/fwd.hpp>
+
+/**
+ * @brief This enum represents type of recorded command.
+ */
+enum class CommandType{
+  BIND_VERTEX_PULLER      ,///< bindVertexPuller
+  UNBIND_VERTEX_PULLER    ,///< unbindVertexPuller
+  USE_PROGRAM             ,///< useProgram
+  PROGRAM_UNIFORM_1F      ,///< programUniform1f
+  PROGRAM_UNIFORM_2F      ,///< programUniform2f
+  PROGRAM_UNIFORM_3F      ,///< programUniform3f
+  PROGRAM_UNIFORM_4F      ,///< programUniform4f
+  PROGRAM_UNIFORM_MATRIX4F,///< programUniformMatrix4f
+  CLEAR                   ,///< clear
+  DRAW_TRIANGLES          ,///< drawTriangles
+  DRAW_TRIANGLES_INSTANCED,///< drawTrianglesInstanced
+  MULTI_DRAW_TRIANGLES    ,///< multiDrawTriangles
+  DRAW_TRIANGLES_INDIRECT ,///< drawTrianglesIndirect
+};
+
+/**
+ * @brief This struct represents one recorded command, all parameters are stored by value.
+ */
+struct Command{
+  CommandType type                           ;///< type of command
+  ObjectID    object    = emptyID            ;///< vertex puller, program or buffer with draw records
+  uint32_t    value     = 0                  ;///< id of uniform, number of vertices or number of draws
+  uint32_t    instances = 1                  ;///< number of instances of draw call
+  uint64_t    offset    = 0                  ;///< offset of draw records in buffer (bytes) or in recorded draws
+  Uniform     data                           ;///< value of uniform or clear color (v4)
+};
+
+/**
+ * @brief This class records GPU commands, they are executed by GPU::submit or GPU::execute.
+ *
+ * Commands are recorded by value, so uniform values are snapshots taken at the time of recording
+ * and the command buffer can be reused or destroyed right after it is submitted.
+ */
+class CommandBuffer{
+  public:
+    void bindVertexPuller      (VertexPullerID vao);
+    void unbindVertexPuller    ();
+    void useProgram            (ProgramID prg);
+    void programUniform1f      (ProgramID prg,uint32_t uniformId,float     const&d);
+    void programUniform2f      (ProgramID prg,uint32_t uniformId,glm::vec2 const&d);
+    void programUniform3f      (ProgramID prg,uint32_t uniformId,glm::vec3 const&d);
+    void programUniform4f      (ProgramID prg,uint32_t uniformId,glm::vec4 const&d);
+    void programUniformMatrix4f(ProgramID prg,uint32_t uniformId,glm::mat4 const&d);
+    void clear                 (float r,float g,float b,float a);
+    void drawTriangles         (uint32_t nofVertices);
+    void drawTriangles         (uint32_t nofVertices,uint32_t firstIndex,int32_t baseVertex);
+    void drawTrianglesInstanced(uint32_t nofVertices,uint32_t nofInstances);
+    void multiDrawTriangles    (DrawIndirectCommand const*draws,uint32_t nofDraws);
+    void drawTrianglesIndirect (BufferID buffer,uint64_t offset,uint32_t nofDraws);
+    void reset                 ();
+
+    /**
+     * @brief This function returns recorded commands.
+     *
+     * @return commands in order of recording
+     */
+    std::vector<Command>const&getCommands()const{return commands;}
+
+    /**
+     * @brief This function returns draws recorded by multiDrawTriangles.
+     *
+     * @return draws of all multi draw commands
+     */
+    std::vector<DrawIndirectCommand>const&getDraws()const{return draws;}
+  private:
+    Command&record(CommandType type,ObjectID object = emptyID,uint32_t value = 0);
+    std::vector<Command>            commands;///< recorded commands
+    std::vector<DrawIndirectCommand>draws   ;///< copies of draws of multi draw commands
+};
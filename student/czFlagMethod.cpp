@@ -28,6 +28,39 @@ void czFlag_VS(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&unifor
   outVertex.attributes[0].v2 = coord;
 }
 
+/**
+ * @brief Czech flag batched vertex shader, it computes the same as czFlag_VS for whole batch
+ *
+ * @param outVertices out vertices
+ * @param inVertices in vertices
+ * @param uniforms uniform variables
+ */
+void czFlag_VSBatch(OutVertexBatch&outVertices,InVertexBatch const&inVertices,Uniforms const&uniforms){
+  auto const& posX   = inVertices.attributes[0][0];
+  auto const& posY   = inVertices.attributes[0][1];
+  auto const& coordX = inVertices.attributes[1][0];
+  auto const& coordY = inVertices.attributes[1][1];
+  auto const& mvp    = uniforms.uniform[0].m4;
+
+  auto time = uniforms.uniform[1].v1;
+
+  // sine is evaluated once per vertex, not once per row of matrix
+  float z[vertexShaderBatchSize];
+  for(uint32_t v=0;v<vertexShaderBatchSize;++v)
+    z[v] = (coordX[v]*0.5f)*glm::sin(coordX[v]*10.f + time);
+
+  for(uint32_t r=0;r<4;++r){
+    auto const m0 = mvp[0][r],m1 = mvp[1][r],m2 = mvp[2][r],m3 = mvp[3][r];
+    for(uint32_t v=0;v<vertexShaderBatchSize;++v)
+      outVertices.gl_Position[r][v] = (m0*posX[v] + m1*posY[v]) + (m2*z[v] + m3);
+  }
+
+  for(uint32_t v=0;v<vertexShaderBatchSize;++v){
+    outVertices.attributes[0][0][v] = coordX[v];
+    outVertices.attributes[0][1][v] = coordY[v];
+  }
+}
+
 /**
  * @brief Czech flag fragment shader
  *
@@ -48,7 +81,34 @@ void czFlag_FS(OutFragment&outFragment,InFragment const&inFragment,Uniforms cons
   }
 }
 
-CZFlagMethod::CZFlagMethod(){
+/**
+ * @brief Czech flag batched fragment shader, it computes the same as czFlag_FS for whole batch
+ *
+ * @param outFragments output fragments
+ * @param inFragments input fragments
+ * @param uniforms uniform variables
+ */
+void czFlag_FSBatch(OutFragmentBatch&outFragments,InFragmentBatch const&inFragments,Uniforms const&uniforms){
+  auto const& vCoordX = inFragments.attributes[0][0];
+  auto const& vCoordY = inFragments.attributes[0][1];
+  for(uint32_t f=0;f<fragmentShaderBatchSize;++f){
+    bool const blue  = vCoordY[f] > vCoordX[f] && 1.f-vCoordY[f]>vCoordX[f];
+    bool const red   = !blue && vCoordY[f] < 0.5f;
+    bool const white = !blue && !red;
+    outFragments.gl_FragColor[0][f] = red || white?1.f:0.f;
+    outFragments.gl_FragColor[1][f] = white       ?1.f:0.f;
+    outFragments.gl_FragColor[2][f] = blue || white?1.f:0.f;
+    outFragments.gl_FragColor[3][f] = 1.f;
+  }
+}
+
+/**
+ * @brief Constructor of czech flag method
+ *
+ * @param nx number of vertices of the flag in x direction
+ * @param ny number of vertices of the flag in y direction
+ */
+CZFlagMethod::CZFlagMethod(uint32_t nx,uint32_t ny):NX(nx),NY(ny){
   struct Vertex{
     glm::vec2 position;
     glm::vec2 texCoord;
@@ -99,7 +159,7 @@ CZFlagMethod::CZFlagMethod(){
   gpu.setVertexPullerIndexing(vao,IndexType::UINT32,ebo);
 
   prg = gpu.createProgram();
-  gpu.attachShaders(prg,czFlag_VS,czFlag_FS);
+  gpu.attachShaders(prg,czFlag_VSBatch,czFlag_FSBatch);
   gpu.setVS2FSType(prg,0,AttributeType::VEC2);
 }
 
@@ -113,17 +173,21 @@ void CZFlagMethod::onUpdate(float dt){
 }
 
 void CZFlagMethod::onDraw(glm::mat4 const&proj,glm::mat4 const&view,glm::vec3 const&light,glm::vec3 const&camera){
-  gpu.clear(0,0,0,1);
+  // frame is rasterized by render thread of the GPU, the application continues with the next frame meanwhile
+  commandBuffer.reset();
+  commandBuffer.clear(0,0,0,1);
 
-  gpu.bindVertexPuller(vao);
-  gpu.useProgram(prg);
+  commandBuffer.bindVertexPuller(vao);
+  commandBuffer.useProgram(prg);
 
   auto mvp = proj*view;
-  gpu.programUniformMatrix4f(prg,0,mvp);
-  gpu.programUniform1f      (prg,1,time);
+  commandBuffer.programUniformMatrix4f(prg,0,mvp);
+  commandBuffer.programUniform1f      (prg,1,time);
+
+  commandBuffer.drawTriangles((NX-1)*(NY-1)*6);
 
-  gpu.drawTriangles((NX-1)*(NY-1)*6);
+  commandBuffer.unbindVertexPuller();
 
-  gpu.unbindVertexPuller();
+  frame = gpu.submit(commandBuffer);
 }
 
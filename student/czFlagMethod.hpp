@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <student/commandBuffer.hpp>
 #include <student/method.hpp>
 
 /**
@@ -14,7 +15,7 @@
  */
 class CZFlagMethod: public Method{
   public:
-    CZFlagMethod();
+    CZFlagMethod(uint32_t nx = 100,uint32_t ny = 10);
     virtual ~CZFlagMethod();
     virtual void onDraw(glm::mat4 const&proj,glm::mat4 const&view,glm::vec3 const&light,glm::vec3 const&camera) override;
     virtual void onUpdate(float dt) override;
@@ -22,9 +23,10 @@ class CZFlagMethod: public Method{
     VertexPullerID vao;///< id of vertex puller
     BufferID vbo;///< vertex buffer
     BufferID ebo;///< index buffer
+    CommandBuffer commandBuffer;///< commands of one frame, they are executed by render thread of the GPU
     float time = 0.f;///< elapsed time
-    uint32_t const NX = 100 ;///< nof vertices in x direction
-    uint32_t const NY = 10 ;///< nof vertices in y direction
+    uint32_t const NX;///< nof vertices in x direction
+    uint32_t const NY;///< nof vertices in y direction
 
 };
 
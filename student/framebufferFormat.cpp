@@ -0,0 +1,70 @@
+/*!
+ * @file
+ * @brief This file contains conversions of framebuffer pixel formats.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <student/framebufferFormat.hpp>
+
+/**
+ * @brief This function converts float to half float.
+ *
+ * Values are rounded to nearest even, values out of range become infinity.
+ *
+ * @param value float value
+ *
+ * @return bits of half float
+ */
+uint16_t floatToHalf(float value){
+  uint32_t bits;
+  std::memcpy(&bits,&value,sizeof(bits));
+  uint32_t const sign = (bits >> 16) & 0x8000;
+  uint32_t const abs  = bits & 0x7fffffff;
+
+  if(abs >= 0x7f800000)return static_cast<uint16_t>(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+  if(abs >= 0x477ff000)return static_cast<uint16_t>(sign | 0x7c00);
+
+  uint32_t half,rest,halfway;
+  if(abs < 0x38800000){
+    // subnormal half, value is mantissa * 2^-24
+    if(abs < 0x33000000)return static_cast<uint16_t>(sign);
+    uint32_t const shift    = 126 - (abs >> 23);
+    uint32_t const mantissa = (abs & 0x7fffff) | 0x800000;
+    half    = mantissa >> shift;
+    rest    = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  }else{
+    half    = (abs - 0x38000000) >> 13;
+    rest    = abs & 0x1fff;
+    halfway = 0x1000;
+  }
+  if(rest > halfway || (rest == halfway && (half & 1)))half++;
+  return static_cast<uint16_t>(sign | half);
+}
+
+/**
+ * @brief This function converts half float to float.
+ *
+ * @param value bits of half float
+ *
+ * @return float value
+ */
+float halfToFloat(uint16_t value){
+  uint32_t const sign     = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t const exponent = (value >> 10) & 0x1f;
+  uint32_t const mantissa = value & 0x3ff;
+  if(exponent == 0){
+    float const abs = std::ldexp(static_cast<float>(mantissa),-24);
+    return sign ? -abs : abs;
+  }
+  uint32_t const bits = exponent == 31 ?
+    sign | 0x7f800000 | (mantissa << 13) :
+    sign | ((exponent + 112) << 23) | (mantissa << 13);
+  float result;
+  std::memcpy(&result,&bits,sizeof(result));
+  return result;
+}
@@ -0,0 +1,246 @@
+/*!
+ * @file
+ * @brief This file contains pixel formats of color and depth buffer.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <cstring>
+
+#include <student/fwd.hpp>
+
+/**
+ * @brief This enum represents format of color buffer pixel.
+ */
+enum class ColorFormat{
+  RGBA8   = 0,///< 4 x 8 bit unsigned normalized
+  RGB565  = 1,///< 5 bit red, 6 bit green, 5 bit blue unsigned normalized, alpha is always 1
+  RGBA16F = 2,///< 4 x 16 bit half float
+  BGRA8   = 3,///< 4 x 8 bit unsigned normalized, blue is stored first (layout of common window surfaces)
+};
+
+/**
+ * @brief This enum represents format of depth buffer pixel.
+ *
+ * Fixed point formats store window depth (z + 1) / 2 clamped to <0, 1>,
+ * so depth cleared to value greater than 1 equals depth of the far plane.
+ */
+enum class DepthFormat{
+  D32F = 0,///< 32 bit float, normalized device depth is stored as is
+  D24  = 1,///< 24 bit unsigned normalized stored in 32 bits
+  D16  = 2,///< 16 bit unsigned normalized
+};
+
+uint16_t floatToHalf(float    value);
+float    halfToFloat(uint16_t value);
+
+/**
+ * @brief This function returns size of color buffer pixel.
+ *
+ * @param format color format
+ *
+ * @return size in bytes
+ */
+inline uint32_t colorFormatSize(ColorFormat format){
+  switch(format){
+    case ColorFormat::RGBA8  :return 4;
+    case ColorFormat::RGB565 :return 2;
+    case ColorFormat::RGBA16F:return 8;
+    case ColorFormat::BGRA8  :return 4;
+  }
+  return 0;
+}
+
+/**
+ * @brief This function returns size of depth buffer pixel.
+ *
+ * @param format depth format
+ *
+ * @return size in bytes
+ */
+inline uint32_t depthFormatSize(DepthFormat format){
+  switch(format){
+    case DepthFormat::D32F:return 4;
+    case DepthFormat::D24 :return 4;
+    case DepthFormat::D16 :return 2;
+  }
+  return 0;
+}
+
+/**
+ * @brief This function writes color into color buffer pixel.
+ *
+ * RGBA8 and BGRA8 channels are truncated, RGB565 channels are clamped and rounded.
+ *
+ * @param dst pixel
+ * @param format color format
+ * @param color color
+ */
+inline void encodeColor(uint8_t*dst,ColorFormat format,glm::vec4 const&color){
+  switch(format){
+    case ColorFormat::RGBA8:
+      dst[0] = color[0] * 255;
+      dst[1] = color[1] * 255;
+      dst[2] = color[2] * 255;
+      dst[3] = color[3] * 255;
+      return;
+    case ColorFormat::BGRA8:
+      dst[0] = color[2] * 255;
+      dst[1] = color[1] * 255;
+      dst[2] = color[0] * 255;
+      dst[3] = color[3] * 255;
+      return;
+    case ColorFormat::RGB565:{
+      auto const channel = [](float c,float max){
+        return static_cast<uint16_t>((c > 0.f ? (c < 1.f ? c : 1.f) : 0.f) * max + .5f);
+      };
+      uint16_t const pixel = static_cast<uint16_t>(channel(color[0],31.f) << 11 | channel(color[1],63.f) << 5 | channel(color[2],31.f));
+      std::memcpy(dst,&pixel,sizeof(pixel));
+      return;
+    }
+    case ColorFormat::RGBA16F:{
+      uint16_t const pixel[4] = {floatToHalf(color[0]),floatToHalf(color[1]),floatToHalf(color[2]),floatToHalf(color[3])};
+      std::memcpy(dst,pixel,sizeof(pixel));
+      return;
+    }
+  }
+}
+
+/**
+ * @brief This function converts color buffer pixel to RGBA8.
+ *
+ * @param rgba8 output color
+ * @param src pixel
+ * @param format color format
+ */
+inline void decodeColor(uint8_t*rgba8,uint8_t const*src,ColorFormat format){
+  switch(format){
+    case ColorFormat::RGBA8:
+      std::memcpy(rgba8,src,4);
+      return;
+    case ColorFormat::BGRA8:
+      rgba8[0] = src[2];
+      rgba8[1] = src[1];
+      rgba8[2] = src[0];
+      rgba8[3] = src[3];
+      return;
+    case ColorFormat::RGB565:{
+      uint16_t pixel;
+      std::memcpy(&pixel,src,sizeof(pixel));
+      uint8_t const r = pixel >> 11;
+      uint8_t const g = (pixel >> 5) & 63;
+      uint8_t const b = pixel & 31;
+      rgba8[0] = static_cast<uint8_t>(r << 3 | r >> 2);
+      rgba8[1] = static_cast<uint8_t>(g << 2 | g >> 4);
+      rgba8[2] = static_cast<uint8_t>(b << 3 | b >> 2);
+      rgba8[3] = 255;
+      return;
+    }
+    case ColorFormat::RGBA16F:{
+      uint16_t pixel[4];
+      std::memcpy(pixel,src,sizeof(pixel));
+      for(int c=0;c<4;++c){
+        float const v = halfToFloat(pixel[c]);
+        rgba8[c] = static_cast<uint8_t>((v > 0.f ? (v < 1.f ? v : 1.f) : 0.f) * 255);
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * @brief This function converts RGBA8 color to color buffer pixel.
+ *
+ * @param dst pixel
+ * @param format color format
+ * @param rgba8 color
+ */
+inline void encodeColor(uint8_t*dst,ColorFormat format,uint8_t const*rgba8){
+  if(format == ColorFormat::RGBA8){
+    std::memcpy(dst,rgba8,4);
+    return;
+  }
+  if(format == ColorFormat::BGRA8){
+    decodeColor(dst,rgba8,format);
+    return;
+  }
+  encodeColor(dst,format,glm::vec4(rgba8[0],rgba8[1],rgba8[2],rgba8[3]) / 255.f);
+}
+
+/**
+ * @brief This struct contains conversions of depth for one depth format.
+ *
+ * Quantization is monotonic, so depth test and hierarchical z-buffer can compare floats before quantization.
+ *
+ * @tparam FORMAT depth format
+ */
+template<DepthFormat FORMAT>
+struct DepthTraits;
+
+template<>
+struct DepthTraits<DepthFormat::D32F>{
+  using Type = float;
+  static Type  quantize(float z){return z;}
+  static float toFloat (Type  d){return d;}
+};
+
+template<>
+struct DepthTraits<DepthFormat::D24>{
+  using Type = uint32_t;
+  static Type quantize(float z){
+    // double keeps all 24 bits of the result
+    double const d = (static_cast<double>(z) + 1.0) * .5;
+    if(!(d > 0.0))return 0;
+    if(d >= 1.0)return 0xffffff;
+    return static_cast<Type>(d * 16777215.0 + .5);
+  }
+  static float toFloat(Type d){return static_cast<float>(d / 16777215.0 * 2.0 - 1.0);}
+};
+
+template<>
+struct DepthTraits<DepthFormat::D16>{
+  using Type = uint16_t;
+  static Type quantize(float z){
+    float const d = (z + 1.f) * .5f;
+    if(!(d > 0.f))return 0;
+    if(d >= 1.f)return 0xffff;
+    return static_cast<Type>(d * 65535.f + .5f);
+  }
+  static float toFloat(Type d){return static_cast<float>(d / 65535.0 * 2.0 - 1.0);}
+};
+
+/**
+ * @brief This function writes depth into depth buffer.
+ *
+ * @param buffer depth buffer
+ * @param pixel index of pixel
+ * @param format depth format
+ * @param z normalized device depth
+ */
+inline void storeDepth(uint8_t*buffer,size_t pixel,DepthFormat format,float z){
+  switch(format){
+    case DepthFormat::D32F:reinterpret_cast<float   *>(buffer)[pixel] = z;return;
+    case DepthFormat::D24 :reinterpret_cast<uint32_t*>(buffer)[pixel] = DepthTraits<DepthFormat::D24>::quantize(z);return;
+    case DepthFormat::D16 :reinterpret_cast<uint16_t*>(buffer)[pixel] = DepthTraits<DepthFormat::D16>::quantize(z);return;
+  }
+}
+
+/**
+ * @brief This function reads depth from depth buffer.
+ *
+ * @param buffer depth buffer
+ * @param pixel index of pixel
+ * @param format depth format
+ *
+ * @return normalized device depth
+ */
+inline float loadDepth(uint8_t const*buffer,size_t pixel,DepthFormat format){
+  switch(format){
+    case DepthFormat::D32F:return reinterpret_cast<float const*>(buffer)[pixel];
+    case DepthFormat::D24 :return DepthTraits<DepthFormat::D24>::toFloat(reinterpret_cast<uint32_t const*>(buffer)[pixel]);
+    case DepthFormat::D16 :return DepthTraits<DepthFormat::D16>::toFloat(reinterpret_cast<uint16_t const*>(buffer)[pixel]);
+  }
+  return 0.f;
+}
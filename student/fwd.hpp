@@ -45,6 +45,7 @@ union Attribute{
 struct InVertex{
   Attribute attributes[maxAttributes]; ///< vertex attributes
   uint32_t  gl_VertexID              ; ///< vertex id
+  uint32_t  gl_InstanceID            ; ///< instance id
 };
 
 /**
@@ -98,6 +99,18 @@ enum class IndexType{
   UINT32 = 4, ///< uint32_t type
 };
 
+/**
+ * @brief This struct represents one draw of multi draw and indirect draw calls.
+ *
+ * Indirect draw calls read tightly packed array of these records from buffer.
+ */
+struct DrawIndirectCommand{
+  uint32_t count         = 0; ///< number of vertices of one instance
+  uint32_t firstIndex    = 0; ///< number of the first index (the first vertex without indexing)
+  int32_t  baseVertex    = 0; ///< value that is added to every vertex number
+  uint32_t instanceCount = 1; ///< number of instances
+};
+
 /**
  * @brief Function type for vertex shader
  *
@@ -122,6 +135,77 @@ using FragmentShader = void(*)(
     InFragment  const&inFragment ,
     Uniforms    const&uniforms   );
 
+uint32_t const vertexShaderBatchSize = 8;///< number of vertices processed by one call of batched vertex shader
+
+/**
+ * @brief This struct represents batch of input vertices in structure of arrays form.
+ *
+ * Component c of attribute a of vertex v is stored in attributes[a][c][v].
+ * All lanes contain valid vertices, unused lanes repeat the last vertex of the batch.
+ */
+struct InVertexBatch{
+  float    attributes[maxAttributes][4][vertexShaderBatchSize]; ///< vertex attributes
+  uint32_t gl_VertexID[vertexShaderBatchSize]                  ; ///< vertex ids
+  uint32_t gl_InstanceID[vertexShaderBatchSize]                ; ///< instance ids
+  uint32_t count                                                ; ///< number of used lanes
+};
+
+/**
+ * @brief This struct represents batch of output vertices in structure of arrays form.
+ *
+ * Component c of attribute a of vertex v is stored in attributes[a][c][v].
+ */
+struct OutVertexBatch{
+  float attributes[maxAttributes][4][vertexShaderBatchSize]; ///< vertex attributes
+  float gl_Position[4][vertexShaderBatchSize]               ; ///< clip space positions
+};
+
+/**
+ * @brief Function type for batched vertex shader
+ *
+ * @param outVertices output vertices
+ * @param inVertices input vertices
+ * @param uniforms uniform variables
+ */
+using BatchVertexShader = void(*)(
+    OutVertexBatch      &outVertices,
+    InVertexBatch  const&inVertices ,
+    Uniforms       const&uniforms   );
+
+uint32_t const fragmentShaderBatchSize = 8;///< number of fragments processed by one call of batched fragment shader
+
+/**
+ * @brief This struct represents batch of input fragments in structure of arrays form.
+ *
+ * Component c of attribute a of fragment f is stored in attributes[a][c][f].
+ * Only attributes selected by setVS2FSType are valid.
+ * Fragments are gathered along scanlines of one triangle, lane f is valid if bit f of mask is set.
+ */
+struct InFragmentBatch{
+  float    attributes[maxAttributes][4][fragmentShaderBatchSize]; ///< fragment attributes
+  float    gl_FragCoord[4][fragmentShaderBatchSize]              ; ///< fragment coordinates
+  uint32_t mask                                                   ; ///< active lanes
+};
+
+/**
+ * @brief This struct represents batch of output fragments in structure of arrays form.
+ */
+struct OutFragmentBatch{
+  float gl_FragColor[4][fragmentShaderBatchSize]; ///< fragment colors
+};
+
+/**
+ * @brief Function type for batched fragment shader
+ *
+ * @param outFragments output fragments
+ * @param inFragments input fragments
+ * @param uniforms uniform variables
+ */
+using BatchFragmentShader = void(*)(
+    OutFragmentBatch      &outFragments,
+    InFragmentBatch  const&inFragments ,
+    Uniforms         const&uniforms    );
+
 using ObjectID       = uint64_t;///< object id (program, buffer, vertex puller)
 using BufferID       = ObjectID;///< buffer id
 using VertexPullerID = ObjectID;///< vertex puller id
@@ -4,11 +4,20 @@
  *
  * @author Tomáš Milet, imilet@fit.vutbr.cz
  */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <type_traits>
 #include <student/gpu.hpp>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 /// \addtogroup gpu_init
 /// @{
@@ -25,19 +34,22 @@ GPU::GPU(){
  * @brief Destructor of GPU
  */
 GPU::~GPU(){
-    
-    unbindVertexPuller();
-    
-    for (std::list<Buffer>::iterator item = BufferList.begin(); item != BufferList.end(); item++) {
-        if (item->data)
-            free(item->data);
+    // submitted command buffers are executed before the GPU is destroyed
+    if (renderThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(submitMutex);
+            stopRenderThread = true;
+        }
+        buffersSubmitted.notify_all();
+        renderThread.join();
     }
 
+    unbindVertexPuller();
     
-    for (std::list<VertexPullerSettings>::iterator item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->heads)
-            free(item->heads);
-        }
+    BufferTable.forEach([](Buffer& item) {
+        if (item.data)
+            free(item.data);
+    });
         
     deleteFramebuffer();
 
@@ -62,17 +74,12 @@ BufferID GPU::createBuffer(uint64_t size) {
   /// Velikost bufferu je v parameteru size (v bajtech).<br>
   /// Funkce by měla vrátit unikátní identifikátor identifikátor bufferu.<br>
   /// Na grafické kartě by mělo být možné alkovat libovolné množství bufferů o libovolné velikosti.<br>
+    waitForSubmitted();
     Buffer newBuffer;
-    if (!BufferList.empty())
-        newBuffer.id = BufferList.back().id + 1;
-    else
-        newBuffer.id = 1;
-
     newBuffer.data = malloc(sizeof(char) * size);
-    if (newBuffer.data != NULL) {
-        BufferList.push_back(newBuffer);
-        return newBuffer.id;
-    }
+    newBuffer.size = size;
+    if (newBuffer.data != NULL)
+        return BufferTable.insert(newBuffer);
 
   return emptyID; 
 }
@@ -86,16 +93,15 @@ void GPU::deleteBuffer(BufferID buffer) {
   /// \todo Tato funkce uvolní buffer na grafické kartě.
   /// Buffer pro smazání je vybrán identifikátorem v parameteru "buffer".
   /// Po uvolnění bufferu je identifikátor volný a může být znovu použit při vytvoření nového bufferu.
-    std::list<Buffer>::iterator item;
-    for (item = BufferList.begin(); item != BufferList.end(); item++) {
-        if (item->id == buffer) {
-            if (item->data)
-                free(item->data);
-
-            BufferList.erase(item);
-            break;
-        }
-    }
+    waitForSubmitted();
+    Buffer* item = BufferTable.get(buffer);
+    if (!item)
+        return;
+
+    if (item->data)
+        free(item->data);
+
+    BufferTable.erase(buffer);
 }
 
 /**
@@ -112,15 +118,10 @@ void GPU::setBufferData(BufferID buffer, uint64_t offset, uint64_t size, void co
   /// Parametr size určuje, kolik dat (v bajtech) se překopíruje.<br>
   /// Parametr offset určuje místo v bufferu (posun v bajtech) kam se data nakopírují.<br>
   /// Parametr data obsahuje ukazatel na data na cpu pro kopírování.<br>
-    std::list<Buffer>::iterator item;
-    for (item = BufferList.begin(); item != BufferList.end(); item++) {
-        if (item->id == buffer) {
-                
-                memcpy((uint8_t*)item->data+offset, data, size);
-            break;
-        }
-    }
-    return;
+    waitForSubmitted();
+    Buffer* item = BufferTable.get(buffer);
+    if (item && item->data)
+        memcpy((uint8_t*)item->data + offset, data, size);
 
 }
 
@@ -142,15 +143,10 @@ void GPU::getBufferData(BufferID buffer,
   /// Parametr size určuje kolik dat (v bajtech) se překopíruje.<br>
   /// Parametr offset určuje místo v bufferu (posun v bajtech) odkud se začne kopírovat.<br>
   /// Parametr data obsahuje ukazatel, kam se data nakopírují.<br>
-    std::list<Buffer>::iterator item;
-    for (item = BufferList.begin(); item != BufferList.end(); item++) {
-        if (item->id == buffer) {
-            if (item->data != NULL)
-                memcpy(data, (uint8_t*)item->data + offset, size);
-            break;
-        }
-    }
-    return;
+    waitForSubmitted();
+    Buffer* item = BufferTable.get(buffer);
+    if (item && item->data)
+        memcpy(data, (uint8_t*)item->data + offset, size);
 }
 
 /**
@@ -164,14 +160,8 @@ bool GPU::isBuffer(BufferID buffer) {
   /// \todo Tato funkce by měla vrátit true pokud buffer je identifikátor existující bufferu.<br>
   /// Tato funkce by měla vrátit false, pokud buffer není identifikátor existujícího bufferu. (nebo bufferu, který byl smazán).<br>
   /// Pro emptyId vrací false.<br>
-
-    std::list<Buffer>::iterator item;
-    for (item = BufferList.begin(); item != BufferList.end(); item++) {
-        if (item->id == buffer) {
-            return true;
-        }
-    }
-  return false; 
+  waitForSubmitted();
+  return BufferTable.contains(buffer); 
 }
 
 /// @}
@@ -190,16 +180,8 @@ ObjectID GPU::createVertexPuller     (){
   /// \todo Tato funkce vytvoří novou práznou tabulku s nastavením pro vertex puller.<br>
   /// Funkce by měla vrátit identifikátor nové tabulky.
   /// Prázdná tabulka s nastavením neobsahuje indexování a všechny čtecí hlavy jsou vypnuté.
-    VertexPullerSettings newVertexPuller;
-    if (!VertexPullerList.empty())
-        newVertexPuller.id = VertexPullerList.back().id + 1;
-    else
-        newVertexPuller.id = 1;
-
-    newVertexPuller.heads = (HeadSettings*)malloc(sizeof(HeadSettings) * maxAttributes);
-    VertexPullerList.push_back(newVertexPuller);
-    return newVertexPuller.id;
-  return emptyID;
+  waitForSubmitted();
+  return VertexPullerTable.insert(VertexPullerSettings());
 }
 
 /**
@@ -211,15 +193,8 @@ void     GPU::deleteVertexPuller     (VertexPullerID vao){
   /// \todo Tato funkce by měla odstranit tabulku s nastavení pro vertex puller.<br>
   /// Parameter "vao" obsahuje identifikátor tabulky s nastavením.<br>
   /// Po uvolnění nastavení je identifiktátor volný a může být znovu použit.<br
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            if(item->heads)
-                free(item->heads);
-            VertexPullerList.erase(item);
-            break;
-        }
-    }
+    waitForSubmitted();
+    VertexPullerTable.erase(vao);
 }
 
 /**
@@ -240,17 +215,13 @@ void     GPU::setVertexPullerHead(VertexPullerID vao, uint32_t head, AttributeTy
     /// Parametr "stride" nastaví krok čtecí hlavy.<br>
     /// Parametr "offset" nastaví počáteční pozici čtecí hlavy.<br>
     /// Parametr "buffer" vybere buffer, ze kterého bude čtecí hlava číst.<br>
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            if (head < maxAttributes) {
-                item->heads[head].type = type;
-                item->heads[head].stride = stride;
-                item->heads[head].offset = offset;
-                item->heads[head].buf = buffer;
-            }
-            break;
-        }
+    waitForSubmitted();
+    VertexPullerSettings* item = VertexPullerTable.get(vao);
+    if (item && head < maxAttributes) {
+        item->heads[head].type = type;
+        item->heads[head].stride = stride;
+        item->heads[head].offset = offset;
+        item->heads[head].buf = buffer;
     }
 }
 
@@ -267,14 +238,12 @@ void     GPU::setVertexPullerIndexing(VertexPullerID vao,IndexType type,BufferID
   /// Parametr "vao" vybírá tabulku s nastavením.<br>
   /// Parametr "type" volí typ indexu, který je uložený v bufferu.<br>
   /// Parametr "buffer" volí buffer, ve kterém jsou uloženy indexy.<br>
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            item->indexing.buf = buffer;
-            item->indexing.type = type;
-            item->indexing.enabled = true;
-            break;
-        }
+    waitForSubmitted();
+    VertexPullerSettings* item = VertexPullerTable.get(vao);
+    if (item) {
+        item->indexing.buf = buffer;
+        item->indexing.type = type;
+        item->indexing.enabled = true;
     }
 }
 
@@ -289,15 +258,10 @@ void     GPU::enableVertexPullerHead(VertexPullerID vao, uint32_t head) {
     /// Pokud je čtecí hlava povolena, hodnoty z bufferu se budou kopírovat do atributu vrcholů vertex shaderu.<br>
     /// Parametr "vao" volí tabulku s nastavením vertex pulleru (vybírá vertex puller).<br>
     /// Parametr "head" volí čtecí hlavu.<br>
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            if (head < maxAttributes) {
-                item->heads[head].enabled = true;
-            }
-            break;
-        }
-    }
+    waitForSubmitted();
+    VertexPullerSettings* item = VertexPullerTable.get(vao);
+    if (item && head < maxAttributes)
+        item->heads[head].enabled = true;
 }
 
 
@@ -311,15 +275,27 @@ void     GPU::disableVertexPullerHead(VertexPullerID vao,uint32_t head){
   /// \todo Tato funkce zakáže čtecí hlavu daného vertex pulleru.<br>
   /// Pokud je čtecí hlava zakázána, hodnoty z bufferu se nebudou kopírovat do atributu vrcholu.<br>
   /// Parametry "vao" a "head" vybírají vertex puller a čtecí hlavu.<br>
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            if (head < maxAttributes) {
-                item->heads[head].enabled = false;
-            }
-            break;
-        }
-    }
+    waitForSubmitted();
+    VertexPullerSettings* item = VertexPullerTable.get(vao);
+    if (item && head < maxAttributes)
+        item->heads[head].enabled = false;
+}
+
+/**
+ * @brief This function sets how often vertex puller's head advances during instanced draw calls.
+ *
+ * Head with divisor 0 reads one element per vertex.
+ * Head with divisor N reads one element per N instances, all vertices of the instance get the same value.
+ *
+ * @param vao vertex puller id
+ * @param head head id
+ * @param divisor number of instances that read the same element
+ */
+void     GPU::setVertexPullerHeadDivisor(VertexPullerID vao,uint32_t head,uint32_t divisor){
+    waitForSubmitted();
+    VertexPullerSettings* item = VertexPullerTable.get(vao);
+    if (item && head < maxAttributes)
+        item->heads[head].divisor = divisor;
 }
 
 /**
@@ -330,13 +306,9 @@ void     GPU::disableVertexPullerHead(VertexPullerID vao,uint32_t head){
 void     GPU::bindVertexPuller       (VertexPullerID vao){
   /// \todo Tato funkce aktivuje nastavení vertex pulleru.<br>
   /// Pokud je daný vertex puller aktivován, atributy z bufferů jsou vybírány na základě jeho nastavení.<br>
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            bindedVPid = item->id;
-            break;
-        }
-    }
+    waitForSubmitted();
+    if (VertexPullerTable.contains(vao))
+        bindedVPid = vao;
 }
 
 /**
@@ -345,6 +317,7 @@ void     GPU::bindVertexPuller       (VertexPullerID vao){
 void     GPU::unbindVertexPuller     (){
   /// \todo Tato funkce deaktivuje vertex puller.
   /// To většinou znamená, že se vybere neexistující "emptyID" vertex puller.
+    waitForSubmitted();
     bindedVPid = emptyID;
 }
 
@@ -358,13 +331,8 @@ void     GPU::unbindVertexPuller     (){
 bool     GPU::isVertexPuller         (VertexPullerID vao){
   /// \todo Tato funkce otestuje, zda daný vertex puller existuje.
   /// Pokud ano, funkce vrací true.
-    std::list<VertexPullerSettings>::iterator item;
-    for (item = VertexPullerList.begin(); item != VertexPullerList.end(); item++) {
-        if (item->id == vao) {
-            return true;
-        }
-    }
-  return false;
+  waitForSubmitted();
+  return VertexPullerTable.contains(vao);
 }
 
 /// @}
@@ -383,15 +351,8 @@ ProgramID        GPU::createProgram         (){
   /// Funkce vrací unikátní identifikátor nového proramu.<br>
   /// Program je seznam nastavení, které obsahuje: ukazatel na vertex a fragment shader.<br>
   /// Dále obsahuje uniformní proměnné a typ výstupních vertex attributů z vertex shaderu, které jsou použity pro interpolaci do fragment atributů.<br>
-    Program newProgram;
-    if (!ProgramList.empty())
-        newProgram.id = ProgramList.back().id + 1;
-    else
-        newProgram.id = 1;
-
-    ProgramList.push_back(newProgram);
-    return newProgram.id;
-  return emptyID;
+  waitForSubmitted();
+  return ProgramTable.insert(Program());
 }
 
 /**
@@ -403,13 +364,8 @@ void             GPU::deleteProgram         (ProgramID prg){
   /// \todo Tato funkce by měla smazat vybraný shader program.<br>
   /// Funkce smaže nastavení shader programu.<br>
   /// Identifikátor programu se stane volným a může být znovu využit.<br>
-    std::list<Program>::iterator item;
-    for (item = ProgramList.begin(); item != ProgramList.end(); item++) {
-        if (item->id == prg) {
-            item = ProgramList.erase(item);
-            break;
-        }
-    }
+    waitForSubmitted();
+    ProgramTable.erase(prg);
 }
 
 /**
@@ -421,12 +377,71 @@ void             GPU::deleteProgram         (ProgramID prg){
  */
 void             GPU::attachShaders         (ProgramID prg,VertexShader vs,FragmentShader fs){
   /// \todo Tato funkce by měla připojít k vybranému shader programu vertex a fragment shader.
-    for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-        if (item->id == prg) {
-            item->VS = vs;
-            item->FS = fs;
-            break;
-        }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item) {
+        item->VS = vs;
+        item->batchVS = nullptr;
+        item->FS = fs;
+        item->batchFS = nullptr;
+    }
+}
+
+/**
+ * @brief This function attaches batched vertex shader and fragment shader to shader program.
+ *
+ * Batched vertex shader transforms vertexShaderBatchSize vertices per call in structure of arrays form.
+ *
+ * @param prg shader program
+ * @param vs batched vertex shader
+ * @param fs fragment shader
+ */
+void             GPU::attachShaders         (ProgramID prg,BatchVertexShader vs,FragmentShader fs){
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item) {
+        item->VS = nullptr;
+        item->batchVS = vs;
+        item->FS = fs;
+        item->batchFS = nullptr;
+    }
+}
+
+/**
+ * @brief This function attaches vertex shader and batched fragment shader to shader program.
+ *
+ * Batched fragment shader shades up to fragmentShaderBatchSize fragments per call in structure of arrays form.
+ *
+ * @param prg shader program
+ * @param vs vertex shader
+ * @param fs batched fragment shader
+ */
+void             GPU::attachShaders         (ProgramID prg,VertexShader vs,BatchFragmentShader fs){
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item) {
+        item->VS = vs;
+        item->batchVS = nullptr;
+        item->FS = nullptr;
+        item->batchFS = fs;
+    }
+}
+
+/**
+ * @brief This function attaches batched vertex and batched fragment shader to shader program.
+ *
+ * @param prg shader program
+ * @param vs batched vertex shader
+ * @param fs batched fragment shader
+ */
+void             GPU::attachShaders         (ProgramID prg,BatchVertexShader vs,BatchFragmentShader fs){
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item) {
+        item->VS = nullptr;
+        item->batchVS = vs;
+        item->FS = nullptr;
+        item->batchFS = fs;
     }
 }
 
@@ -444,11 +459,11 @@ void             GPU::setVS2FSType          (ProgramID prg,uint32_t attrib,Attri
   /// Tyto atributy obsahují interpolované hodnoty vertex atributů.<br>
   /// Tato funkce vybere jakého typu jsou tyto interpolované atributy.<br>
   /// Bez jakéhokoliv nastavení jsou atributy prázdne AttributeType::EMPTY<br>
-    for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-        if (item->id == prg) {
-            item->attributes[attrib] = type;
-            break;
-        }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item && attrib < maxAttributes) {
+        item->attributes[attrib] = type;
+        buildVaryingLayout(item->varyings, item->attributes);
     }
 }
 
@@ -459,12 +474,9 @@ void             GPU::setVS2FSType          (ProgramID prg,uint32_t attrib,Attri
  */
 void             GPU::useProgram            (ProgramID prg){
   /// \todo tato funkce by měla vybrat aktivní shader program.
-    for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-        if (item->id == prg) {
-            ActiveProgramID = item->id;
-            break;
-        }
-    }
+    waitForSubmitted();
+    if (ProgramTable.contains(prg))
+        ActiveProgramID = prg;
 }
 
 /**
@@ -477,12 +489,8 @@ void             GPU::useProgram            (ProgramID prg){
 bool             GPU::isProgram             (ProgramID prg){
   /// \todo tato funkce by měla zjistit, zda daný program existuje.<br>
   /// Funkce vráti true, pokud program existuje.<br>
-    for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-        if (item->id == prg) {
-            return true;
-        }
-    }
-  return false;
+  waitForSubmitted();
+  return ProgramTable.contains(prg);
 }
 
 /**
@@ -497,15 +505,10 @@ void             GPU::programUniform1f(ProgramID prg, uint32_t uniformId, float
     /// Parametr "prg" vybírá shader program.<br>
     /// Parametr "uniformId" vybírá uniformní proměnnou. Maximální počet uniformních proměnných je uložen v programné \link maxUniforms \endlink.<br>
     /// Parametr "d" obsahuje data (1 float).<br>
-    if (uniformId >= 0 && uniformId < maxUniforms) {
-        for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-            if (item->id == prg) {
-                item->un.uniform[uniformId].v1 = d;
-                break;
-
-            }
-        }
-    }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item && uniformId < maxUniforms)
+        item->un.uniform[uniformId].v1 = d;
 }
 
 /**
@@ -518,15 +521,10 @@ void             GPU::programUniform1f(ProgramID prg, uint32_t uniformId, float
 void             GPU::programUniform2f      (ProgramID prg,uint32_t uniformId,glm::vec2 const&d){
   /// \todo tato funkce dělá obdobnou věc jako funkce programUniform1f.<br>
   /// Místo 1 floatu nahrává 2 floaty.
-    if (uniformId >= 0 && uniformId < maxUniforms) {
-        for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-            if (item->id == prg) {
-                item->un.uniform[uniformId].v2 = d;
-                break;
-
-            }
-        }
-    }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item && uniformId < maxUniforms)
+        item->un.uniform[uniformId].v2 = d;
 }
 
 /**
@@ -539,15 +537,10 @@ void             GPU::programUniform2f      (ProgramID prg,uint32_t uniformId,gl
 void             GPU::programUniform3f      (ProgramID prg, uint32_t uniformId, glm::vec3 const& d){
     /// \todo tato funkce dělá obdobnou věc jako funkce programUniform1f.<br>
     /// Místo 1 floatu nahrává 3 floaty.
-    if (uniformId >= 0 && uniformId < maxUniforms) {
-        for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-            if (item->id == prg) {
-                item->un.uniform[uniformId].v3 = d;
-                break;
-
-            }
-        }
-    }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item && uniformId < maxUniforms)
+        item->un.uniform[uniformId].v3 = d;
 }
 
 /**
@@ -560,15 +553,10 @@ void             GPU::programUniform3f      (ProgramID prg, uint32_t uniformId,
 void             GPU::programUniform4f      (ProgramID prg, uint32_t uniformId, glm::vec4 const& d){
   /// \todo tato funkce dělá obdobnou věc jako funkce programUniform1f.<br>
   /// Místo 1 floatu nahrává 4 floaty.
-    if (uniformId >= 0 && uniformId < maxUniforms) {
-        for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-            if (item->id == prg) {
-                item->un.uniform[uniformId].v4 = d;
-                break;
-
-            }
-        }
-    }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item && uniformId < maxUniforms)
+        item->un.uniform[uniformId].v4 = d;
 }
 
 /**
@@ -581,15 +569,10 @@ void             GPU::programUniform4f      (ProgramID prg, uint32_t uniformId,
 void             GPU::programUniformMatrix4f(ProgramID prg,uint32_t uniformId,glm::mat4 const&d){
   /// \todo tato funkce dělá obdobnou věc jako funkce programUniform1f.<br>
   /// Místo 1 floatu nahrává matici 4x4 (16 floatů).
-    if (uniformId >= 0 && uniformId < maxUniforms) {
-        for (std::list<Program>::iterator item = ProgramList.begin(); item != ProgramList.end(); item++) {
-            if (item->id == prg) {
-                item->un.uniform[uniformId].m4 = d;
-                break;
-
-            }
-        }
-    }
+    waitForSubmitted();
+    Program* item = ProgramTable.get(prg);
+    if (item && uniformId < maxUniforms)
+        item->un.uniform[uniformId].m4 = d;
 }
 
 /// @}
@@ -607,34 +590,25 @@ void             GPU::programUniformMatrix4f(ProgramID prg,uint32_t uniformId,gl
  *
  * @param width width of framebuffer
  * @param height height of framebuffer
+ * @param colorFormat format of color buffer
+ * @param depthFormat format of depth buffer
  */
-void GPU::createFramebuffer      (uint32_t width,uint32_t height){
+void GPU::createFramebuffer      (uint32_t width,uint32_t height,ColorFormat colorFormat,DepthFormat depthFormat){
   /// \todo Tato funkce by měla alokovat framebuffer od daném rozlišení.<br>
   /// Framebuffer se skládá z barevného a hloukového bufferu.<br>
   /// Buffery obsahují width x height pixelů.<br>
   /// Barevný pixel je složen z 4 x uint8_t hodnot - to reprezentuje RGBA barvu.<br>
   /// Hloubkový pixel obsahuje 1 x float - to reprezentuje hloubku.<br>
   /// Nultý pixel framebufferu je vlevo dole.<br>
-
-    if (Width != 0 && Height != 0 && colorBuf != nullptr && depthBuf != nullptr)
-    {
-        resizeFramebuffer(width, height);
-    }
-
-    Width = width;
-    Height = height;
-
-    if (colorBuf == nullptr || depthBuf == nullptr) {
-        colorBuf = (uint8_t*)malloc(sizeof(uint8_t) * 4 * width * height);
-        depthBuf = (float*)malloc(sizeof(float) * width * height);
-    }
-    else 
-    {
-        colorBuf = (uint8_t*)realloc(colorBuf, sizeof(uint8_t) * 4 * width * height);
-        depthBuf = (float*)realloc(depthBuf, sizeof(float) * width * height);
-    }
-    clear(0, 0, 0, 0);
-
+    waitForSubmitted();
+
+    // existing framebuffer is reallocated with the new formats, new one is cleared by resize
+    bool const existed = colorBuf != nullptr && depthBuf != nullptr && Width != 0 && Height != 0;
+    this->colorFormat = colorFormat;
+    this->depthFormat = depthFormat;
+    resizeFramebuffer(width, height);
+    if (existed)
+        clear(0, 0, 0, 0);
 }
 
 /**
@@ -642,49 +616,134 @@ void GPU::createFramebuffer      (uint32_t width,uint32_t height){
  */
 void GPU::deleteFramebuffer      (){
   /// \todo tato funkce by měla dealokovat framebuffer
-    if (Width == 0 || Height == 0 || colorBuf == nullptr || depthBuf == nullptr)
+    waitForSubmitted();
+    if (colorBuf == nullptr && depthBuf == nullptr)
         return;
 
+    // memory of the caller bound by setColorBufferMemory is not owned by the GPU
+    if (!externalColor)
+        free(colorBuf);
+    free(depthBuf);
+    colorBuf = nullptr;
+    depthBuf = nullptr;
+    externalColor = false;
+    flipRows = false;
+
+    colorView.clear();
+    colorView.shrink_to_fit();
+    depthView.clear();
+    depthView.shrink_to_fit();
+    colorViewOut = false;
+    depthViewOut = false;
+    pendingClears.clear();
+    clearsPending = false;
+    hizValid = false;
+    visibilityBuf.clear();
 
     Width = 0;
     Height = 0;
-    
 }
 
 /**
  * @brief This function resizes framebuffer.
  *
+ * It is the only place that allocates color and depth buffers, createFramebuffer uses it too.
+ *
  * @param width new width of framebuffer
  * @param height new heght of framebuffer
  */
 void     GPU::resizeFramebuffer(uint32_t width,uint32_t height){
   /// \todo Tato funkce by měla změnit velikost framebuffer.
-    if (colorBuf == nullptr || depthBuf == nullptr || Width == 0 || Height == 0) {
-        createFramebuffer(width, height);
-        return;
+    waitForSubmitted();
+    bool const created = colorBuf == nullptr || depthBuf == nullptr || Width == 0 || Height == 0;
+
+    // clears pending in every tile stay pending for the new size, other pending clears are written
+    // into the pixels that realloc keeps
+    uint8_t carriedClears = 0;
+    if (!created && clearsPending) {
+        carriedClears = pendingClearColor | pendingClearDepth;
+        for (uint8_t const clears : pendingClears)
+            carriedClears &= clears;
+        resolveClears((uint8_t)((pendingClearColor | pendingClearDepth) & ~carriedClears));
+    }
+
+    // memory of the caller does not fit new size, color buffer returns to memory of the GPU
+    if (externalColor) {
+        colorBuf = nullptr;
+        externalColor = false;
+        flipRows = false;
     }
 
     Width = width;
     Height = height;
+    updatePixelOffsets();
+    pendingClears.assign((size_t)hizTilesX * hizTilesY, carriedClears);
+    clearsPending = carriedClears != 0;
+    colorViewOut = false;
+    depthViewOut = false;
+
+    colorBuf = (uint8_t*)realloc(colorBuf, colorFormatSize(colorFormat) * framebufferPixels());
+    depthBuf = (uint8_t*)realloc(depthBuf, depthFormatSize(depthFormat) * framebufferPixels());
+    hizValid = (carriedClears & pendingClearDepth) != 0;
+    if (hizValid) {
+        hizBuf.assign((size_t)hizTilesX * hizTilesY, clearDepthValue);
+        hizLayers.assign((size_t)hizTilesX * hizTilesY, HiZLayer());
+    }
 
+    // ids of pending visibility buffer do not match pixels any more, they are dropped
+    visibilityBuf.assign(framebufferPixels(), emptyVisibility);
+    visibilityDraws.clear();
+    visibilityTriangles.clear();
+    visibilityPlanes.clear();
 
+    // contents of new framebuffer are defined
+    if (created)
+        clear(0, 0, 0, 0);
+}
 
-    if (colorBuf != nullptr)
-        colorBuf = (uint8_t*)realloc(colorBuf, sizeof(uint8_t) * 4 * width * height);
-    if (depthBuf != nullptr)
-        depthBuf = (float*)realloc(depthBuf, sizeof(float) * width * height);
-    
+/**
+ * @brief This function visits all pixels of framebuffer tile by tile.
+ *
+ * Pixels of one tile are close in both layouts, so copies between layouts stay in cache.
+ *
+ * @tparam F type of function
+ * @param gpu graphic card
+ * @param f function that receives row by row index of pixel and index of pixel in framebuffer
+ */
+template<typename F>
+static void forEachPixel(GPU const& gpu, F const& f) {
+    for (uint32_t tileY = 0; tileY < gpu.Height; tileY += hizTileSize)
+        for (uint32_t tileX = 0; tileX < gpu.Width; tileX += hizTileSize)
+            for (uint32_t y = tileY; y < std::min(tileY + hizTileSize, gpu.Height); y++) {
+                size_t const row = (size_t)y * gpu.Width;
+                uint32_t const rowOffset = gpu.pixelRowOffsets[y];
+                for (uint32_t x = tileX; x < std::min(tileX + hizTileSize, gpu.Width); x++)
+                    f(row + x, rowOffset + gpu.pixelColumnOffsets[x]);
+            }
 }
 
 /**
  * @brief This function returns pointer to color buffer.
  *
+ * Pixels are always returned row by row in RGBA8. Color buffer that is tiled, has other format
+ * or is stored in memory of the caller (see setColorBufferMemory) is converted into row by row view, the view is valid until the next command and changes made through it are copied back.
+ *
  * @return pointer to color buffer
  */
 uint8_t* GPU::getFramebufferColor  (){
   /// \todo Tato funkce by měla vrátit ukazatel na začátek barevného bufferu.<br>
-    if (colorBuf != nullptr)
-        return colorBuf;
+    waitForSubmitted();
+    if (colorBuf != nullptr) {
+        resolveClears(pendingClearColor);
+        if (rowByRow() && colorFormat == ColorFormat::RGBA8)
+            return colorBuf;
+        acquireFramebuffer();
+        colorView.resize((size_t)Width * Height * 4);
+        uint32_t const size = colorFormatSize(colorFormat);
+        forEachPixel(*this, [&](size_t i, uint32_t pixel) { decodeColor(&colorView[i * 4], colorBuf + (size_t)pixel * size, colorFormat); });
+        colorViewOut = true;
+        return colorView.data();
+    }
 
   return nullptr;
 }
@@ -692,15 +751,233 @@ uint8_t* GPU::getFramebufferColor  (){
 /**
  * @brief This function returns pointer to depth buffer.
  *
+ * Pixels are always returned row by row as floats, see getFramebufferColor.
+ *
  * @return pointer to dept buffer.
  */
 float* GPU::getFramebufferDepth    (){
   /// \todo tato funkce by mla vrátit ukazatel na začátek hloubkového bufferu.<br>
-    if (depthBuf != NULL)
-        return depthBuf;
+    waitForSubmitted();
+    if (depthBuf != NULL) {
+        resolveClears(pendingClearDepth);
+        if (rowByRow() && depthFormat == DepthFormat::D32F) {
+            // depth buffer can be written through the pointer, tiles are checked when the rasterizer touches them
+            if (hizValid)
+                for (uint32_t tile = 0; tile < hizTilesX * hizTilesY; tile++)
+                    invalidateHiZTile(tile);
+            return (float*)depthBuf;
+        }
+        // writes into the view are found when it is copied back
+        acquireFramebuffer();
+        depthView.resize((size_t)Width * Height);
+        forEachPixel(*this, [&](size_t i, uint32_t pixel) { depthView[i] = loadDepth(depthBuf, pixel, depthFormat); });
+        depthViewOut = true;
+        return depthView.data();
+    }
   return nullptr;
 }
 
+/**
+ * @brief This function selects memory layout of color and depth buffer.
+ *
+ * Tiled layout stores every tile of hierarchical z-buffer in one block of memory,
+ * so rasterization of a tile touches few cache lines and pages even for wide framebuffers.
+ * Content of the framebuffer is preserved, pending visibility buffer is resolved.
+ *
+ * @param layout memory layout
+ */
+void GPU::setFramebufferLayout(FramebufferLayout layout) {
+    waitForSubmitted();
+    if (layout == framebufferLayout)
+        return;
+    if (colorBuf == nullptr || depthBuf == nullptr) {
+        framebufferLayout = layout;
+        return;
+    }
+    relocateFramebuffer(layout, nullptr, 0, false);
+}
+
+/**
+ * @brief This function binds memory of the caller as color buffer, GPU renders directly into it.
+ *
+ * Memory is linear, it contains rows of color format pixels (see createFramebuffer) that are pitch bytes apart.
+ * If flipY is set, the first row in memory is the top row of the framebuffer (like in window surfaces).
+ * The flip is absorbed by addresses of rows, so gl_FragCoord and winding of triangles are not affected.
+ * Pixels of the memory are complete after finish, clears and visibility buffer are resolved lazily.
+ * The memory has to stay valid until it is unbound, resizeFramebuffer and setFramebufferLayout(TILED) unbind it.
+ * Content of the framebuffer is preserved, bytes between rows are not written.
+ * Without preserveContent, the color content is whatever the memory contains. If rows of the memory
+ * are addressed like the current ones, the memory is just swapped in (rotation of swap chain images).
+ *
+ * @param pixels memory of at least pitch * height bytes, nullptr returns color buffer to memory of the GPU
+ * @param pitch number of bytes between starts of rows, multiple of pixel size that is not smaller than row
+ * @param flipY rows are stored from the top row to the bottom row
+ * @param preserveContent color content of the framebuffer is copied into the memory
+ */
+void GPU::setColorBufferMemory(uint8_t* pixels, uint32_t pitch, bool flipY, bool preserveContent) {
+    waitForSubmitted();
+    if (colorBuf == nullptr || depthBuf == nullptr)
+        return;
+    uint32_t const size = colorFormatSize(colorFormat);
+    if (pixels == nullptr) {
+        if (externalColor)
+            relocateFramebuffer(FramebufferLayout::LINEAR, nullptr, 0, false);
+        return;
+    }
+    if (pitch % size != 0 || pitch / size < Width)
+        return;
+    bool const sameRows = framebufferLayout == FramebufferLayout::LINEAR && pitch / size == rowPitch && flipY == flipRows;
+    if (preserveContent || !sameRows) {
+        relocateFramebuffer(FramebufferLayout::LINEAR, pixels, pitch / size, flipY);
+        return;
+    }
+    // pending work belongs to the old memory, depth buffer keeps its addresses
+    finish();
+    if (!externalColor)
+        free(colorBuf);
+    colorBuf = pixels;
+    externalColor = true;
+}
+
+/**
+ * @brief This function writes all pending work into framebuffer memory.
+ *
+ * Pending visibility buffer, views returned by getters and lazy clears are resolved,
+ * so memory bound by setColorBufferMemory can be read by the caller.
+ */
+void GPU::finish() {
+    waitForSubmitted();
+    resolveVisibilityBuffer();
+    acquireFramebuffer();
+    resolveClears(pendingClearColor | pendingClearDepth);
+}
+
+/**
+ * @brief This function moves content of framebuffer into new layout and memory.
+ *
+ * Pending visibility buffer and clears are resolved first.
+ *
+ * @param layout new memory layout
+ * @param memory memory of the caller for color buffer, nullptr for memory of the GPU
+ * @param pitch number of pixels between rows of memory of the caller
+ * @param flipY rows of memory of the caller are stored from the top row
+ */
+void GPU::relocateFramebuffer(FramebufferLayout layout, uint8_t* memory, uint32_t pitch, bool flipY) {
+    finish();
+    size_t const colorSize = colorFormatSize(colorFormat);
+    size_t const depthSize = depthFormatSize(depthFormat);
+    std::vector<uint8_t> color((size_t)Width * Height * colorSize);
+    std::vector<uint8_t> depth((size_t)Width * Height * depthSize);
+    forEachPixel(*this, [&](size_t i, uint32_t pixel) {
+        std::memcpy(&color[i * colorSize], colorBuf + pixel * colorSize, colorSize);
+        std::memcpy(&depth[i * depthSize], depthBuf + pixel * depthSize, depthSize);
+    });
+
+    if (!externalColor)
+        free(colorBuf);
+    framebufferLayout = layout;
+    externalColor = memory != nullptr;
+    flipRows = externalColor && flipY;
+    rowPitch = externalColor ? pitch : Width;
+    updatePixelOffsets();
+    // padding of memory of the caller is not touched
+    if (externalColor)
+        colorBuf = memory;
+    else {
+        colorBuf = (uint8_t*)malloc(colorSize * framebufferPixels());
+        std::fill(colorBuf, colorBuf + colorSize * framebufferPixels(), 0);
+    }
+    depthBuf = (uint8_t*)realloc(depthBuf, depthSize * framebufferPixels());
+    std::fill(depthBuf, depthBuf + depthSize * framebufferPixels(), 0);
+    forEachPixel(*this, [&](size_t i, uint32_t pixel) {
+        std::memcpy(colorBuf + pixel * colorSize, &color[i * colorSize], colorSize);
+        std::memcpy(depthBuf + pixel * depthSize, &depth[i * depthSize], depthSize);
+    });
+    visibilityBuf.assign(framebufferPixels(), emptyVisibility);
+}
+
+/**
+ * @brief This function returns true if pixels are stored row by row without gaps from the bottom row.
+ *
+ * @return true if framebuffer can be returned without conversion of addresses
+ */
+bool GPU::rowByRow() const {
+    return framebufferLayout == FramebufferLayout::LINEAR && rowPitch == Width && !flipRows;
+}
+
+/**
+ * @brief This function returns number of pixels stored in color and depth buffer.
+ *
+ * Tiled framebuffer is padded to whole tiles.
+ *
+ * @return number of stored pixels
+ */
+size_t GPU::framebufferPixels() const {
+    if (framebufferLayout == FramebufferLayout::LINEAR)
+        return (size_t)rowPitch * Height;
+    size_t const tilesX = (Width + hizTileSize - 1) / hizTileSize;
+    size_t const tilesY = (Height + hizTileSize - 1) / hizTileSize;
+    return tilesX * tilesY * hizTileSize * hizTileSize;
+}
+
+/**
+ * @brief This function computes offsets of rows and columns of framebuffer for its layout.
+ *
+ * Offsets of both layouts are separable, so pixel (x, y) is stored at pixelRowOffsets[y] + pixelColumnOffsets[x]
+ * and the rasterizer addresses pixels the same way in both layouts.
+ * Rows of linear layout are rowPitch pixels apart and they are stored in reverse order if flipRows is set.
+ * In tiled layout, bits of x and y inside the tile are interleaved (Morton order).
+ */
+void GPU::updatePixelOffsets() {
+    hizTilesX = (Width + hizTileSize - 1) / hizTileSize;
+    hizTilesY = (Height + hizTileSize - 1) / hizTileSize;
+    pixelRowOffsets.resize(Height);
+    pixelColumnOffsets.resize(Width);
+    if (framebufferLayout == FramebufferLayout::LINEAR) {
+        if (!externalColor)
+            rowPitch = Width;
+        for (uint32_t y = 0; y < Height; y++)
+            pixelRowOffsets[y] = (flipRows ? Height - 1 - y : y) * rowPitch;
+        for (uint32_t x = 0; x < Width; x++)
+            pixelColumnOffsets[x] = x;
+        return;
+    }
+
+    auto const morton = [](uint32_t v) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; (1u << b) < hizTileSize; b++)
+            r |= ((v >> b) & 1u) << (2 * b);
+        return r;
+    };
+    uint32_t const tilePixels = hizTileSize * hizTileSize;
+    uint32_t const tilesX = (Width + hizTileSize - 1) / hizTileSize;
+    for (uint32_t y = 0; y < Height; y++)
+        pixelRowOffsets[y] = (y / hizTileSize) * tilesX * tilePixels + (morton(y % hizTileSize) << 1);
+    for (uint32_t x = 0; x < Width; x++)
+        pixelColumnOffsets[x] = (x / hizTileSize) * tilePixels + morton(x % hizTileSize);
+}
+
+/**
+ * @brief This function copies row by row views of framebuffer back before the framebuffer is used.
+ */
+void GPU::acquireFramebuffer() {
+    if (colorViewOut && colorView.size() == (size_t)Width * Height * 4) {
+        uint32_t const size = colorFormatSize(colorFormat);
+        forEachPixel(*this, [&](size_t i, uint32_t pixel) { encodeColor(colorBuf + (size_t)pixel * size, colorFormat, &colorView[i * 4]); });
+    }
+    if (depthViewOut && depthView.size() == (size_t)Width * Height)
+        forEachPixel(*this, [&](size_t i, uint32_t pixel) {
+            // only tiles with pixels written through the view are checked by hierarchical z-buffer
+            if (loadDepth(depthBuf, pixel, depthFormat) == depthView[i])
+                return;
+            storeDepth(depthBuf, pixel, depthFormat, depthView[i]);
+            if (hizValid)
+                invalidateHiZTile((uint32_t)(i / Width / hizTileSize) * hizTilesX + (uint32_t)(i % Width / hizTileSize));
+        });
+    colorViewOut = false;
+    depthViewOut = false;
+}
+
 /**
  * @brief This function returns width of framebuffer
  *
@@ -708,6 +985,7 @@ float* GPU::getFramebufferDepth    (){
  */
 uint32_t GPU::getFramebufferWidth (){
   /// \todo Tato funkce by měla vrátit šířku framebufferu.
+  waitForSubmitted();
   return Width;
 }
 
@@ -718,6 +996,7 @@ uint32_t GPU::getFramebufferWidth (){
  */
 uint32_t GPU::getFramebufferHeight(){
   /// \todo Tato funkce by měla vrátit výšku framebufferu.
+  waitForSubmitted();
   return Height;
 }
 
@@ -742,521 +1021,1658 @@ void            GPU::clear                 (float r,float g,float b,float a){
   /// (0,0,0) - černá barva, (1,1,1) - bílá barva.<br>
   /// Hloubkový buffer nastaví na takovou hodnotu, která umožní rasterizaci trojúhelníka, který leží v rámci pohledového tělesa.<br>
   /// Hloubka by měla být tedy větší než maximální hloubka v NDC (normalized device coordinates).<br>
-    if (r > 1)
-        r = 1;
-    if (g > 1)
-        g = 1;
-    if (b > 1)
-        b = 1;
-    if (a > 1)
-        a = 1;
-    
-
-    for (unsigned i = 0; i < (Height * Width) * 4; i++) {
-
-        colorBuf[i] = (uint8_t)(r * 255);
-        colorBuf[++i] = g * 255;
-        colorBuf[++i] = b * 255;
-        colorBuf[++i] = a * 255;
-        depthBuf[i / 4] = 1.1f;
+    waitForSubmitted();
+    clearColor(r, g, b, a);
+    clearDepth(defaultClearDepth);
+}
 
+/**
+ * @brief This function clears color buffer.
+ *
+ * Pixels are not written here, clear color is written into tile when the rasterizer touches it first
+ * or when the color buffer is read (see resolveClears). Pending visibility buffer is dropped,
+ * its colors would be overwritten by the clear anyway.
+ *
+ * @param r red channel
+ * @param g green channel
+ * @param b blue channel
+ * @param a alpha channel
+ */
+void            GPU::clearColor            (float r,float g,float b,float a){
+    waitForSubmitted();
+    glm::vec4 const color = glm::clamp(glm::vec4(r, g, b, a), 0.f, 1.f);
+    encodeColor(clearColorValue, colorFormat, color);
+
+    // view of tiled framebuffer is overwritten anyway
+    colorViewOut = false;
+    for (uint8_t& clears : pendingClears)
+        clears |= pendingClearColor;
+    clearsPending = true;
+
+    if (!visibilityDraws.empty()) {
+        std::fill(visibilityBuf.begin(), visibilityBuf.end(), emptyVisibility);
+        visibilityDraws.clear();
+        visibilityTriangles.clear();
+        visibilityPlanes.clear();
     }
-    
-    
 }
 
+/**
+ * @brief This function clears depth buffer.
+ *
+ * Pixels are written lazily like in clearColor, hierarchical z-buffer is reset immediately.
+ * Pending visibility buffer is resolved first, its fragments need their depth.
+ *
+ * @param depth depth written into every pixel
+ */
+void            GPU::clearDepth            (float depth){
+    waitForSubmitted();
+    resolveVisibilityBuffer();
+    clearDepthValue = depth;
+
+    depthViewOut = false;
+    for (uint8_t& clears : pendingClears)
+        clears = (uint8_t)((clears | pendingClearDepth) & ~pendingHiZ);
+    clearsPending = true;
+
+    hizBuf.assign((size_t)hizTilesX * hizTilesY, depth);
+    hizLayers.assign((size_t)hizTilesX * hizTilesY, HiZLayer());
+    hizValid = true;
+}
 
+/**
+ * @brief This function writes pending clears into all pixels of one tile.
+ *
+ * It is called by the rasterizer before the tile is touched first, so it runs on the thread that owns the tile.
+ *
+ * @param tile tile of hierarchical z-buffer
+ */
+void GPU::initializeTile(uint32_t tile) {
+    uint32_t const tileX = tile % hizTilesX;
+    fillTiles(tile / hizTilesX, tileX, tileX + 1, pendingClears[tile], false);
+    pendingClears[tile] = 0;
+}
 
-void            GPU::drawTriangles(uint32_t  nofVertices) {
-    /// \todo Tato funkce vykreslí trojúhelníky podle daného nastavení.<br>
-    /// Vrcholy se budou vybírat podle nastavení z aktivního vertex pulleru (pomocí bindVertexPuller).<br>
-    /// Vertex shader a fragment shader se zvolí podle aktivního shader programu (pomocí useProgram).<br>
-    /// Parametr "nofVertices" obsahuje počet vrcholů, který by se měl vykreslit (3 pro jeden trojúhelník).<br>
-
-
-      // Getting binded puller
-    std::list<VertexPullerSettings>::iterator VP;
-    for (VP = VertexPullerList.begin(); VP != VertexPullerList.end(); VP++) {
-        if (VP->id == bindedVPid) {
-            break;
-        }
-    }
-
-
-    // Getting active program
-    std::list<Program>::iterator P;
-    for (P = ProgramList.begin(); P != ProgramList.end(); P++) {
-        if (P->id == ActiveProgramID) {
-            break;
-        }
+/**
+ * @brief This function fills pixels with value.
+ *
+ * Streaming stores bypass cache, they are used for large fills that are not read soon.
+ *
+ * @tparam T type of pixel (2, 4 or 8 bytes)
+ * @param dst first pixel
+ * @param count number of pixels
+ * @param value value of pixels
+ * @param streaming use non-temporal stores
+ */
+template<typename T>
+static void fillPixels(T* dst, size_t count, T value, bool streaming) {
+#if defined(__SSE2__)
+    if (streaming) {
+        size_t const perStore = 16 / sizeof(T);
+        for (; count && ((uintptr_t)dst & 15); count--)
+            *dst++ = value;
+        T pattern[perStore];
+        std::fill_n(pattern, perStore, value);
+        __m128i const v = _mm_loadu_si128((__m128i const*)pattern);
+        for (; count >= perStore; count -= perStore, dst += perStore)
+            _mm_stream_si128((__m128i*)dst, v);
     }
+#endif
+    std::fill_n(dst, count, value);
+}
 
-    std::vector<OutVertex> outVertexes{ size_t(nofVertices) };
-
-
-    for (uint32_t inVertexID = 0; inVertexID < nofVertices; inVertexID++) {
-        InVertex inVertex;
-
-        if (VP->indexing.enabled)
-        {
-            for (std::list<Buffer>::iterator buf = BufferList.begin(); buf != BufferList.end(); buf++) {
-                if (buf->id == VP->indexing.buf) {
-                    switch (VP->indexing.type)
-                    {
-                        uint8_t* data;
-                        uint16_t* data2;
-                        uint32_t* data3;
-                        case IndexType::UINT8:
-                            data = (uint8_t*)buf->data;
-                            inVertex.gl_VertexID = (uint32_t)(data[inVertexID]);
-                            break;
-                        case IndexType::UINT16:
-                            data2 = (uint16_t*)buf->data;
-                            inVertex.gl_VertexID = (uint32_t)(data2[inVertexID]);
-                            break;
-                        case IndexType::UINT32:
-                            data3 = (uint32_t*)buf->data;
-                            inVertex.gl_VertexID = (uint32_t)(data3[inVertexID]);
-                            break;
-                    }
-                    
-                    break;
-                }
+/**
+ * @brief This function writes pending clears into row of tiles.
+ *
+ * Tiles of tiled framebuffer are stored one after another, so the whole row of tiles is one fill.
+ * Linear framebuffer is filled by rows of pixels.
+ *
+ * @param tileY row of tiles
+ * @param firstTileX first tile of the row
+ * @param endTileX tile after the last tile
+ * @param clears clears that are written (pendingClearColor, pendingClearDepth)
+ * @param streaming use non-temporal stores
+ */
+void GPU::fillTiles(uint32_t tileY, uint32_t firstTileX, uint32_t endTileX, uint8_t clears, bool streaming) {
+    auto const fillColor = [&](auto* color, size_t first, size_t count) {
+        std::decay_t<decltype(*color)> value;
+        std::memcpy(&value, clearColorValue, sizeof(value));
+        fillPixels(color + first, count, value, streaming);
+    };
+    auto const fill = [&](size_t first, size_t count) {
+        if (clears & pendingClearColor) {
+            switch (colorFormatSize(colorFormat)) {
+            case 2: fillColor((uint16_t*)colorBuf, first, count); break;
+            case 4: fillColor((uint32_t*)colorBuf, first, count); break;
+            case 8: fillColor((uint64_t*)colorBuf, first, count); break;
             }
         }
-        else
-            inVertex.gl_VertexID = inVertexID;
-
-
-        for (int i = 0; i < maxAttributes; i++) {
-            if (VP->heads[i].enabled)
-                for (std::list<Buffer>::iterator buf = BufferList.begin(); buf != BufferList.end(); buf++) {
-                    if (buf->id == VP->heads[i].buf) {
-                        switch (VP->heads[i].type)
-                        {
-                            float* data;
-                            glm::vec2* data2;
-                            glm::vec3* data3;
-                            glm::vec4* data4;
-
-                        case AttributeType::FLOAT:
-                            data = (float*)malloc(sizeof(float));
-                            if (data != nullptr) {
-                                memcpy(data, (uint8_t*)buf->data + (inVertex.gl_VertexID * VP->heads[i].stride + VP->heads[i].offset), sizeof(data));
-                                inVertex.attributes[i].v1 = *data;
-                            }
-                            break;
-
-                        case AttributeType::VEC2:
-                            data2 = (glm::vec2*)malloc(sizeof(glm::vec2));
-                            if (data2 != nullptr) {
-                                memcpy(data2, (uint8_t*)buf->data + (inVertex.gl_VertexID * VP->heads[i].stride + VP->heads[i].offset), sizeof(float) * 2);
-                                inVertex.attributes[i].v2 = *data2;
-                            }
-                            break;
-
-                        case AttributeType::VEC3:
-                            data3 = (glm::vec3*)malloc(sizeof(glm::vec3));
-                            if (data3 != nullptr) {
-                                memcpy(data3, (uint8_t*)buf->data + (inVertex.gl_VertexID * VP->heads[i].stride + VP->heads[i].offset), sizeof(float) * 3);
-                                inVertex.attributes[i].v3 = *data3;
-                            }
-                            break;
-
-                        case AttributeType::VEC4:
-                            data4 = (glm::vec4*)malloc(sizeof(glm::vec4));
-                            if (data4 != nullptr) {
-                                memcpy(data4, (uint8_t*)buf->data + (inVertex.gl_VertexID * VP->heads[i].stride + VP->heads[i].offset), sizeof(float) * 4);
-                                inVertex.attributes[i].v4 = *data4;
-                            }
-                            break;
-
-                        default: break;
-                        }
-                        break;
-                    }
-                }
+        if (clears & pendingClearDepth) {
+            switch (depthFormat) {
+            case DepthFormat::D32F: fillPixels((float*)depthBuf + first, count, clearDepthValue, streaming); break;
+            case DepthFormat::D24: fillPixels((uint32_t*)depthBuf + first, count, DepthTraits<DepthFormat::D24>::quantize(clearDepthValue), streaming); break;
+            case DepthFormat::D16: fillPixels((uint16_t*)depthBuf + first, count, DepthTraits<DepthFormat::D16>::quantize(clearDepthValue), streaming); break;
+            }
         }
+    };
 
-        OutVertex outVertex;
-        Uniforms const& uniforms = P->un;
-        P->VS(outVertex, inVertex, uniforms);
-        outVertexes.push_back(outVertex);
-    }
-
-   for (size_t i = 0; i < outVertexes.size(); i++) {
-        auto& a = outVertexes[i];
-        auto& b = outVertexes[++i];
-        auto& c = outVertexes[++i];
-        trianglesClipping(a, b, c);
+    uint32_t const tilePixels = hizTileSize * hizTileSize;
+    if (framebufferLayout == FramebufferLayout::TILED) {
+        fill(((size_t)tileY * hizTilesX + firstTileX) * tilePixels, (size_t)(endTileX - firstTileX) * tilePixels);
+        return;
     }
-
-    return;
+    uint32_t const minX = firstTileX * hizTileSize;
+    uint32_t const maxX = std::min(endTileX * hizTileSize, Width);
+    uint32_t const maxY = std::min((tileY + 1) * hizTileSize, Height);
+    for (uint32_t y = tileY * hizTileSize; y < maxY; y++)
+        fill(pixelRowOffsets[y] + minX, maxX - minX);
 }
 
-
 /**
- * @brief Triangle clipping
+ * @brief This function writes pending clears into all tiles that were not touched since the clear.
  *
- * @param a - first vertex of the triangle
- * @param b - second vertex of the triangle
- * @param c - third vertex of the triangle
+ * Neighbouring tiles with the same pending clears are filled together with non-temporal stores.
+ *
+ * @param clears clears that are written (pendingClearColor, pendingClearDepth)
  */
-void GPU::trianglesClipping(OutVertex& a, OutVertex& b, OutVertex& c) {
-
-   if (a.gl_Position[0] > a.gl_Position[3] &&
-        b.gl_Position[0] > b.gl_Position[3] &&
-        c.gl_Position[0] > c.gl_Position[3])
-        return;
-    if (a.gl_Position[0] < -a.gl_Position[3] &&
-        b.gl_Position[0] < -b.gl_Position[3] &&
-        c.gl_Position[0] < -c.gl_Position[3])
-        return;
-    if (a.gl_Position[1] > a.gl_Position[3] &&
-        b.gl_Position[1] > b.gl_Position[3] &&
-        c.gl_Position[1] > c.gl_Position[3])
+void GPU::resolveClears(uint8_t clears) {
+    if (!clearsPending)
         return;
-    if (a.gl_Position[1] < -a.gl_Position[3] &&
-        b.gl_Position[1] < -b.gl_Position[3] &&
-        c.gl_Position[1] < -c.gl_Position[3])
-        return;
-    if (a.gl_Position[2] > a.gl_Position[3] &&
-        b.gl_Position[2] > b.gl_Position[3] &&
-        c.gl_Position[2] > c.gl_Position[3])
-        return;
-    if (a.gl_Position[2] < -a.gl_Position[3] &&
-        b.gl_Position[2] < -b.gl_Position[3] &&
-        c.gl_Position[2] < -c.gl_Position[3])
-        return;
-    
-    auto Clipping1 = [this](OutVertex& a, OutVertex& b, OutVertex& c) {
-        float A = (-a.gl_Position[3] - a.gl_Position[2]) / (b.gl_Position[3] - a.gl_Position[3] + b.gl_Position[2] - a.gl_Position[2]);
-        float B = (-a.gl_Position[3] - a.gl_Position[2]) / (c.gl_Position[3] - a.gl_Position[3] + c.gl_Position[2] - a.gl_Position[2]);
-
-        auto a1 = Interpolation(a, b, A);
-        auto a2 = Interpolation(a, c, B);
+    bool remaining = false;
+    for (uint32_t tileY = 0; tileY < hizTilesY; tileY++) {
+        uint8_t* row = &pendingClears[(size_t)tileY * hizTilesX];
+        for (uint32_t tileX = 0; tileX < hizTilesX;) {
+            uint8_t const run = row[tileX] & clears;
+            uint32_t end = tileX + 1;
+            while (end < hizTilesX && (row[end] & clears) == run)
+                end++;
+            if (run)
+                fillTiles(tileY, tileX, end, run, true);
+            for (; tileX < end; tileX++) {
+                row[tileX] &= ~clears;
+                remaining |= row[tileX] != 0;
+            }
+        }
+    }
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+    clearsPending = remaining;
+}
 
-        auto a1clone = a1;
-        auto cclone = c;
 
-        Drawing(a1, b, c);
-        Drawing(a2, a1clone, cclone);
-    };
 
-    auto Clipping2 = [this](OutVertex& a, OutVertex& b, OutVertex& c) {
-        float A = (-a.gl_Position[3] - a.gl_Position[2]) / (c.gl_Position[3] - a.gl_Position[3] + c.gl_Position[2] - a.gl_Position[2]);
-        float B = (-b.gl_Position[3] - b.gl_Position[2]) / (c.gl_Position[3] - b.gl_Position[3] + c.gl_Position[2] - b.gl_Position[2]);
+/**
+ * @brief This function executes recorded commands on the calling thread.
+ *
+ * @param commandBuffer recorded commands
+ */
+void GPU::execute(CommandBuffer const& commandBuffer) {
+    waitForSubmitted();
+    for (Command const& command : commandBuffer.getCommands()) {
+        switch (command.type) {
+        case CommandType::BIND_VERTEX_PULLER: bindVertexPuller(command.object); break;
+        case CommandType::UNBIND_VERTEX_PULLER: unbindVertexPuller(); break;
+        case CommandType::USE_PROGRAM: useProgram(command.object); break;
+        case CommandType::PROGRAM_UNIFORM_1F: programUniform1f(command.object, command.value, command.data.v1); break;
+        case CommandType::PROGRAM_UNIFORM_2F: programUniform2f(command.object, command.value, command.data.v2); break;
+        case CommandType::PROGRAM_UNIFORM_3F: programUniform3f(command.object, command.value, command.data.v3); break;
+        case CommandType::PROGRAM_UNIFORM_4F: programUniform4f(command.object, command.value, command.data.v4); break;
+        case CommandType::PROGRAM_UNIFORM_MATRIX4F: programUniformMatrix4f(command.object, command.value, command.data.m4); break;
+        case CommandType::CLEAR: clear(command.data.v4[0], command.data.v4[1], command.data.v4[2], command.data.v4[3]); break;
+        case CommandType::DRAW_TRIANGLES: drawTriangles(command.value); break;
+        case CommandType::DRAW_TRIANGLES_INSTANCED: drawTrianglesInstanced(command.value, command.instances); break;
+        case CommandType::MULTI_DRAW_TRIANGLES: multiDrawTriangles(commandBuffer.getDraws().data() + command.offset, command.value); break;
+        case CommandType::DRAW_TRIANGLES_INDIRECT: drawTrianglesIndirect(command.object, command.offset, command.value); break;
+        }
+    }
+}
 
-        a = Interpolation(a, c, A);
-        b = Interpolation(b, c, B);
+/**
+ * @brief This function queues copy of command buffer for execution on the render thread.
+ *
+ * Command buffers are executed in order of submission. Other functions of the GPU
+ * wait until all submitted command buffers are executed, the caller can prepare
+ * the next frame in the meantime.
+ *
+ * @param commandBuffer recorded commands, it can be reused right after the call
+ *
+ * @return fence that is signaled when the command buffer is executed
+ */
+Fence GPU::submit(CommandBuffer const& commandBuffer) {
+    Fence fence;
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        submittedBuffers.push_back(commandBuffer);
+        fence.value = ++submittedFences;
+        if (!renderThread.joinable())
+            renderThread = std::thread(&GPU::renderThreadLoop, this);
+    }
+    buffersSubmitted.notify_one();
+    return fence;
+}
 
-        Drawing(a, b, c);
-    };
-    
-    if (a.gl_Position[2] < -a.gl_Position[3]) {
+/**
+ * @brief This function waits until fence is signaled.
+ *
+ * @param fence fence returned by submit
+ */
+void GPU::waitFence(Fence const& fence) {
+    std::unique_lock<std::mutex> lock(submitMutex);
+    buffersCompleted.wait(lock, [&] { return completedFences >= fence.value; });
+}
 
-        if (b.gl_Position[2] < -b.gl_Position[3])
-            Clipping2(a, b, c);
+/**
+ * @brief This function returns true if fence is signaled.
+ *
+ * @param fence fence returned by submit
+ *
+ * @return true if the command buffer of the fence is executed
+ */
+bool GPU::isFenceSignaled(Fence const& fence) {
+    std::lock_guard<std::mutex> lock(submitMutex);
+    return completedFences >= fence.value;
+}
 
-        else if (c.gl_Position[2] < -c.gl_Position[3])
-            Clipping2(a, c, b);
+/**
+ * @brief This function waits until all submitted command buffers are executed.
+ */
+void GPU::waitIdle() {
+    std::unique_lock<std::mutex> lock(submitMutex);
+    buffersCompleted.wait(lock, [&] { return completedFences == submittedFences; });
+}
 
-        else
-            Clipping1(a, b, c);
+/**
+ * @brief This function waits for submitted command buffers before pipeline state is used by the calling thread.
+ *
+ * Commands executed by the render thread itself do not wait.
+ */
+void GPU::waitForSubmitted() {
+    if (!renderThread.joinable() || std::this_thread::get_id() == renderThread.get_id())
+        return;
+    waitIdle();
+}
 
-    }
-    else if (b.gl_Position[2] < -b.gl_Position[3]) {
-        if (c.gl_Position[2] < -c.gl_Position[3])
-            Clipping2(b, c, a);
-
-        else
-            Clipping1(b, a, c);
+/**
+ * @brief This function is run by the render thread, it executes submitted command buffers in order.
+ */
+void GPU::renderThreadLoop() {
+    std::unique_lock<std::mutex> lock(submitMutex);
+    for (;;) {
+        buffersSubmitted.wait(lock, [&] { return stopRenderThread || !submittedBuffers.empty(); });
+        if (submittedBuffers.empty())
+            return;
+        // references to elements of deque stay valid while other buffers are submitted
+        CommandBuffer const& commandBuffer = submittedBuffers.front();
+        lock.unlock();
+        execute(commandBuffer);
+        lock.lock();
+        submittedBuffers.pop_front();
+        completedFences++;
+        buffersCompleted.notify_all();
     }
-    else if (c.gl_Position[2] < -c.gl_Position[3])
-        Clipping1(c, a, b);
-    else
-        Drawing(a, b, c);
-
 }
 
+void            GPU::drawTriangles(uint32_t  nofVertices) {
+    /// \todo Tato funkce vykreslí trojúhelníky podle daného nastavení.<br>
+    /// Vrcholy se budou vybírat podle nastavení z aktivního vertex pulleru (pomocí bindVertexPuller).<br>
+    /// Vertex shader a fragment shader se zvolí podle aktivního shader programu (pomocí useProgram).<br>
+    /// Parametr "nofVertices" obsahuje počet vrcholů, který by se měl vykreslit (3 pro jeden trojúhelník).<br>
+    waitForSubmitted();
+
+    drawTrianglesInstanced(nofVertices, 1);
+}
 
 /**
- * @brief helping interpolation
+ * @brief This function draws triangles from part of index buffer.
  *
- * @param a - first vertex of the triangle
- * @param b - second vertex of the triangle
- * @param f - actually, I don't know what is it
+ * Several meshes can share one vertex buffer and one index buffer,
+ * every mesh selects its indices by firstIndex and its vertices by baseVertex.
+ *
+ * @param nofVertices number of vertices (3 for one triangle)
+ * @param firstIndex number of the first index (the first vertex without indexing)
+ * @param baseVertex value that is added to vertex numbers (indices or vertex numbers of non indexed draw)
  */
-OutVertex GPU::Interpolation(OutVertex& a, OutVertex& b, float f) {
-    OutVertex res = a;
-    res.gl_Position = a.gl_Position + f * (b.gl_Position - a.gl_Position);
-
-    return res;
+void            GPU::drawTriangles(uint32_t nofVertices, uint32_t firstIndex, int32_t baseVertex) {
+    waitForSubmitted();
+    DrawIndirectCommand draw;
+    draw.count = nofVertices;
+    draw.firstIndex = firstIndex;
+    draw.baseVertex = baseVertex;
+    multiDrawTriangles(&draw, 1);
 }
 
+/**
+ * @brief This function draws triangles nofInstances times.
+ *
+ * Instances are drawn in order, vertices get number of the instance in gl_InstanceID
+ * and per-instance heads (see setVertexPullerHeadDivisor) read element of the instance.
+ *
+ * @param nofVertices number of vertices of one instance (3 for one triangle)
+ * @param nofInstances number of instances
+ */
+void            GPU::drawTrianglesInstanced(uint32_t nofVertices, uint32_t nofInstances) {
+    waitForSubmitted();
+    DrawIndirectCommand draw;
+    draw.count = nofVertices;
+    draw.instanceCount = nofInstances;
+    multiDrawTriangles(&draw, 1);
+}
 
-void GPU::Drawing(OutVertex& a, OutVertex& b, OutVertex& c) {
-    
-    // Do post processes
-    postProcesses(a, b, c);
+/**
+ * @brief This function executes several draws with the same vertex puller and program in one pass of the pipeline.
+ *
+ * Draw state is resolved, framebuffer is prepared and triangles are binned once for all draws.
+ * Draws and their instances are executed in order, every draw reads indices from its firstIndex
+ * and adds its baseVertex to them.
+ * Draws that fit into one chunk map invocations to transformed vertices once,
+ * so indices are read and post-transform cache is searched once for all instances.
+ *
+ * @param draws array of draws
+ * @param nofDraws number of draws
+ */
+void            GPU::multiDrawTriangles(DrawIndirectCommand const* draws, uint32_t nofDraws) {
+    waitForSubmitted();
+    DrawContext ctx;
+    if (!draws || !resolveDrawContext(ctx))
+        return;
 
-    // Find triangle's top, bottom and height
-    float triangleTop = getTraingleTop(a, b, c);
-    float triangleBottom = getTraingleBottom(a, b, c);
+    acquireFramebuffer();
+    if (!hizValid)
+        rebuildHiZ();
+
+    if (renderMode == RenderMode::VISIBILITY) {
+        // fragment shader state is captured now, fragments are shaded by resolveVisibilityBuffer
+        ctx.visibility = true;
+        if (visibilityBuf.size() != framebufferPixels())
+            visibilityBuf.assign(framebufferPixels(), emptyVisibility);
+        VisibilityDraw draw;
+        draw.FS = ctx.FS;
+        draw.batchFS = ctx.batchFS;
+        draw.uniforms = *ctx.uniforms;
+        draw.varyings = *ctx.varyings;
+        draw.firstTriangle = visibilityTriangles.size();
+        draw.firstPlane = visibilityPlanes.size();
+        visibilityDraws.push_back(draw);
+    }
 
-    float triangleHeight = triangleTop - triangleBottom;
-    
-    // Make array borders with sructure:
-    // Borders[y] = x1
-    // Borders[y] = x2
-    // x1 and x2 - start and end of lines, which will be drawn
-    glm::vec2* Lines = (glm::vec2*)malloc(sizeof(glm::vec2) * (size_t)ceil(triangleHeight));
-    glm::vec2 emptyVec2; emptyVec2[0] = -1; emptyVec2[1] = -1;
-    for (int i = 0; i < triangleHeight; i++) Lines[i] = emptyVec2;
-
-
-    // Getting lines
-    Line(a, b, Lines, a, b, c);
-    Line(b, c, Lines, a, b, c);
-    Line(c, a, Lines, a, b, c);
-
-    // Getting active program
-    std::list<Program>::iterator P;
-    for (P = ProgramList.begin(); P != ProgramList.end(); P++) {
-        if (P->id == ActiveProgramID) {
-            break;
+    if (threadPool)
+        prepareBins(ctx);
+
+    bool const cached = ctx.indices && vertexCacheMode != VertexCacheMode::DISABLED;
+    for (uint32_t d = 0; d < nofDraws; d++) {
+        DrawIndirectCommand const draw = draws[d];
+        beginDraw(ctx, draw.baseVertex);
+
+        // vertices are streamed through the whole pipeline in chunks of whole triangles,
+        // so memory usage does not depend on the number of vertices
+        uint32_t chunkSize = threadPool ? parallelPrimitiveChunkSize : primitiveChunkSize;
+        bool const reuseSlots = draw.instanceCount > 1 && draw.count <= parallelPrimitiveChunkSize;
+        if (reuseSlots)
+            chunkSize = std::max(draw.count, 1u);
+        for (uint32_t instance = 0; instance < draw.instanceCount; instance++) {
+            beginInstance(ctx, instance);
+            for (uint32_t first = 0; first < draw.count; first += chunkSize) {
+                uint32_t count = draw.count - first < chunkSize ? draw.count - first : chunkSize;
+
+                if (!reuseSlots || instance == 0)
+                    assignVertexSlots(ctx, draw.firstIndex + first, count, first == 0);
+                else if (cached) {
+                    stats.vertexCacheMisses += vertexMisses.size();
+                    stats.vertexCacheHits += count - vertexMisses.size();
+                }
+                shadeVertices(ctx, draw.firstIndex + first, count);
+                assembleTriangles(ctx, count);
+            }
         }
     }
 
-    float y = triangleBottom + 0.5;
-    
-    for (y; y < triangleTop; y++) {
-        if (y < 0 || y > Height)
-            continue;
+    if (threadPool)
+        flushBins(ctx);
+}
 
-        float x = -1;
-        float x2 = -1;
+/**
+ * @brief This function executes draws whose records are read from buffer.
+ *
+ * Records are read when the draw call is executed, so they can be written by
+ * setBufferData after the draw call was recorded into command buffer.
+ *
+ * @param buffer buffer with tightly packed DrawIndirectCommand records
+ * @param offset offset of the first record in bytes (multiple of 4)
+ * @param nofDraws number of records
+ */
+void            GPU::drawTrianglesIndirect(BufferID buffer, uint64_t offset, uint32_t nofDraws) {
+    waitForSubmitted();
+    Buffer* buf = BufferTable.get(buffer);
+    if (!buf || offset + (uint64_t)nofDraws * sizeof(DrawIndirectCommand) > buf->size)
+        return;
+    multiDrawTriangles((DrawIndirectCommand const*)((uint8_t const*)buf->data + offset), nofDraws);
+}
 
-        x = Lines[int(y - 0.5 - triangleBottom)][0];
-      
-        if (x > Width || x < 0)
+/**
+ * @brief This function culls, clips and rasterizes triangles of one chunk transformed by shadeVertices.
+ *
+ * @param ctx resolved draw state
+ * @param nofVertices number of vertex shader invocations in the chunk
+ */
+void            GPU::assembleTriangles(DrawContext const& ctx, uint32_t nofVertices) {
+    ClipVertex a, b, c;
+    for (uint32_t i = 0; i + 2 < nofVertices; i += 3) {
+        float const* pa = &vertexScratch[vertexSlots[i] * ctx.vertexSize];
+        float const* pb = &vertexScratch[vertexSlots[i + 1] * ctx.vertexSize];
+        float const* pc = &vertexScratch[vertexSlots[i + 2] * ctx.vertexSize];
+        if (cullMode != CullMode::NONE && isCulled(pa, pb, pc)) {
+            stats.culledPrimitives++;
             continue;
+        }
+        unpackVertex(a, pa, *ctx.varyings);
+        unpackVertex(b, pb, *ctx.varyings);
+        unpackVertex(c, pc, *ctx.varyings);
+        trianglesClipping(ctx, a, b, c);
+    }
+}
 
-        x2 = Lines[int(y - 0.5 - triangleBottom)][1];
+/**
+ * @brief This function selects draw of multi draw call whose vertices are transformed next.
+ *
+ * Per-vertex heads are moved by base vertex, so fetch functions read index + baseVertex.
+ *
+ * @param ctx resolved draw state
+ * @param baseVertex value added to vertex numbers
+ */
+void            GPU::beginDraw(DrawContext& ctx, int32_t baseVertex) {
+    ctx.baseVertex = baseVertex;
+    for (uint32_t h = 0; h < ctx.nofHeads; h++) {
+        ResolvedHead& head = ctx.heads[h];
+        if (!head.divisor)
+            head.data = head.base + (int64_t)baseVertex * (int64_t)head.stride;
+    }
+}
 
-        if (x2 > Width || x2 < 0)
-            continue;
+/**
+ * @brief This function selects instance whose vertices are transformed next.
+ *
+ * Per-instance heads are moved to the element of the instance.
+ *
+ * @param ctx resolved draw state
+ * @param instance number of instance
+ */
+void            GPU::beginInstance(DrawContext& ctx, uint32_t instance) {
+    ctx.instanceID = instance;
+    for (uint32_t h = 0; h < ctx.nofHeads; h++) {
+        ResolvedHead& head = ctx.heads[h];
+        if (head.divisor)
+            head.data = head.base + (uint64_t)(instance / head.divisor) * head.stride;
+    }
+}
 
-        if (x > x2) 
-            swapFloat(x, x2);
-        
-        
-        x += 0.5;
-       
-        
-        for (x; x <= x2; x++) {
-            
-            float h2 = (x - a.gl_Position[0]) * (b.gl_Position[1] - a.gl_Position[1]) - (y - a.gl_Position[1]) * (b.gl_Position[0] - a.gl_Position[0]);
-            float h0 = (x - b.gl_Position[0]) * (c.gl_Position[1] - b.gl_Position[1]) - (y - b.gl_Position[1]) * (c.gl_Position[0] - b.gl_Position[0]);
-            float h1 = (x - c.gl_Position[0]) * (a.gl_Position[1] - c.gl_Position[1]) - (y - c.gl_Position[1]) * (a.gl_Position[0] - c.gl_Position[0]);
-
-
-            h0 = h0 / (Width * Height);
-            h1 = h1 / (Width * Height);
-            h2 = h2 / (Width * Height);
-
-            float z = ((a.gl_Position[2] * h0) / a.gl_Position[3] + (b.gl_Position[2] * h1) / b.gl_Position[3] + (c.gl_Position[2] * h2) / c.gl_Position[3]) / (h0 / a.gl_Position[3] + h1 / b.gl_Position[3] + h2 / c.gl_Position[3]);           
-            
-            // Depth test
-            float depth = depthBuf[((int)y * Width + (int)x)];
-            if (!(depth > z))
-                continue;
+/**
+ * @brief This function shades pixels of visibility buffer.
+ *
+ * Every pixel covered by draw calls recorded since the last clear or resolve
+ * runs fragment shader of its nearest triangle exactly once, so shading cost does not depend on overdraw.
+ * Attributes are interpolated from stored plane equations of the triangle,
+ * so the result is identical to forward rendering.
+ */
+void            GPU::resolveVisibilityBuffer() {
+    waitForSubmitted();
+    if (visibilityDraws.empty())
+        return;
+    acquireFramebuffer();
+
+    // plane pointers of recorded triangles are set once all planes are stored
+    for (size_t d = 0; d < visibilityDraws.size(); d++) {
+        VisibilityDraw const& draw = visibilityDraws[d];
+        size_t const end = d + 1 < visibilityDraws.size() ? visibilityDraws[d + 1].firstTriangle : visibilityTriangles.size();
+        size_t const planeSize = 3 * (size_t)draw.varyings.nofFloats;
+        for (size_t i = draw.firstTriangle; i < end; i++)
+            visibilityTriangles[i].planes = visibilityPlanes.data() + draw.firstPlane + (i - draw.firstTriangle) * planeSize;
+    }
 
-            InFragment inFragment;
-            inFragment.gl_FragCoord[0] = x;
-            inFragment.gl_FragCoord[1] = y;
-            inFragment.gl_FragCoord[2] = z;
-            for (int i = 0; i < maxAttributes; i++) {
-
-                switch (P->attributes[i])
-                {
-                case AttributeType::FLOAT:
-                    inFragment.attributes[i].v1 = ((a.attributes[i].v1 * h0) / a.gl_Position[3] + (b.attributes[i].v1 * h1) / b.gl_Position[3] + (c.attributes[i].v1 * h2) / c.gl_Position[3]) / (h0 / a.gl_Position[3] + h1 / b.gl_Position[3] + h2 / c.gl_Position[3]);
-                    break;
-                case AttributeType::VEC2:
-                    inFragment.attributes[i].v2 = ((a.attributes[i].v2 * h0) / a.gl_Position[3] + (b.attributes[i].v2 * h1) / b.gl_Position[3] + (c.attributes[i].v2 * h2) / c.gl_Position[3]) / (h0 / a.gl_Position[3] + h1 / b.gl_Position[3] + h2 / c.gl_Position[3]);
-                    break;
-                case AttributeType::VEC3:
-                    inFragment.attributes[i].v3 = ((a.attributes[i].v3 * h0) / a.gl_Position[3] + (b.attributes[i].v3 * h1) / b.gl_Position[3] + (c.attributes[i].v3 * h2) / c.gl_Position[3]) / (h0 / a.gl_Position[3] + h1 / b.gl_Position[3] + h2 / c.gl_Position[3]);
-                    break;
-                case AttributeType::VEC4:
-                    inFragment.attributes[i].v4 = ((a.attributes[i].v4 * h0) / a.gl_Position[3] + (b.attributes[i].v4 * h1) / b.gl_Position[3] + (c.attributes[i].v4 * h2) / c.gl_Position[3]) / (h0 / a.gl_Position[3] + h1 / b.gl_Position[3] + h2 / c.gl_Position[3]);
-                    break;
-                }
+    // indexed by depth format and color format
+    using ResolveFunction = uint64_t (GPU::*)(uint32_t, uint32_t);
+    static ResolveFunction const resolveFunctions[3][4] = {
+        {&GPU::resolveRows<DepthFormat::D32F, ColorFormat::RGBA8>, &GPU::resolveRows<DepthFormat::D32F, ColorFormat::RGB565>, &GPU::resolveRows<DepthFormat::D32F, ColorFormat::RGBA16F>, &GPU::resolveRows<DepthFormat::D32F, ColorFormat::BGRA8>},
+        {&GPU::resolveRows<DepthFormat::D24 , ColorFormat::RGBA8>, &GPU::resolveRows<DepthFormat::D24 , ColorFormat::RGB565>, &GPU::resolveRows<DepthFormat::D24 , ColorFormat::RGBA16F>, &GPU::resolveRows<DepthFormat::D24 , ColorFormat::BGRA8>},
+        {&GPU::resolveRows<DepthFormat::D16 , ColorFormat::RGBA8>, &GPU::resolveRows<DepthFormat::D16 , ColorFormat::RGB565>, &GPU::resolveRows<DepthFormat::D16 , ColorFormat::RGBA16F>, &GPU::resolveRows<DepthFormat::D16 , ColorFormat::BGRA8>},
+    };
+    ResolveFunction const resolve = resolveFunctions[(int)depthFormat][(int)colorFormat];
+
+    // rows are independent, so bands of rows are resolved by worker threads
+    uint32_t const nofBands = threadPool ? (Height + tileSize - 1) / tileSize : 1;
+    if (nofBands <= 1)
+        stats.fragmentShaderInvocations += (this->*resolve)(0, Height);
+    else {
+        std::atomic<uint64_t> shadedFragments{ 0 };
+        threadPool->parallelFor(nofBands, [&](uint32_t band, uint32_t) {
+            shadedFragments += (this->*resolve)(band * tileSize, std::min(Height, (band + 1) * tileSize));
+        });
+        stats.fragmentShaderInvocations += shadedFragments;
+    }
+
+    std::fill(visibilityBuf.begin(), visibilityBuf.end(), emptyVisibility);
+    visibilityDraws.clear();
+    visibilityTriangles.clear();
+    visibilityPlanes.clear();
+}
+
+/**
+ * @brief This function maps invocations of one chunk to slots of transformed vertices.
+ *
+ * vertexSlots gets slot of every invocation, vertexMisses gets gl_VertexID of vertices
+ * that have to be transformed and vertexScratch is resized for them.
+ * For indexed draws, post-transform vertex cache skips vertices that were already transformed.
+ * FIFO cache and transformed vertices live for one chunk, FULL cache keeps them for the whole draw.
+ * The mapping does not depend on instance, so instanced draw calls compute it once for all instances.
+ *
+ * @param ctx resolved draw state
+ * @param firstVertex number of the first vertex shader invocation of the chunk
+ * @param nofVertices number of vertex shader invocations in the chunk
+ * @param firstChunk the chunk starts new draw
+ */
+void GPU::assignVertexSlots(DrawContext const& ctx, uint32_t firstVertex, uint32_t nofVertices, bool firstChunk) {
+    bool cached = ctx.indices && vertexCacheMode != VertexCacheMode::DISABLED;
+    bool wholeDraw = cached && vertexCacheMode == VertexCacheMode::FULL;
+    if (cached && vertexCacheMode == VertexCacheMode::FIFO) {
+        for (uint32_t i = 0; i < vertexCacheFifoSize; i++)
+            vertexCacheFifo[i] = VertexCacheEntry();
+        vertexCacheFifoNext = 0;
+    }
+    if (wholeDraw && firstChunk && ++vertexCacheStamp == 0) {
+        std::fill(vertexCacheStamps.begin(), vertexCacheStamps.end(), 0);
+        vertexCacheStamp = 1;
+    }
 
+    if (!wholeDraw || firstChunk)
+        vertexScratch.clear();
+    vertexSlots.clear();
+    vertexMisses.clear();
+
+    uint32_t const base = (uint32_t)(vertexScratch.size() / ctx.vertexSize);
+    uint32_t nofMisses = nofVertices;
+    if (cached) {
+        // vertices that are not cached get consecutive slots, repeated indices reuse pending slots
+        uint32_t ids[vertexFetchBatchSize];
+        for (uint32_t offset = 0; offset < nofVertices; offset += vertexFetchBatchSize) {
+            uint32_t count = std::min(nofVertices - offset, vertexFetchBatchSize);
+            ctx.fetchVertexIDArray(ids, count, ctx.indices, firstVertex + offset, ctx.baseVertex);
+            for (uint32_t v = 0; v < count; v++) {
+                uint32_t vertexID = ids[v];
+                uint32_t newSlot = base + (uint32_t)vertexMisses.size();
+                uint32_t slot = lookupVertexCache(vertexID, newSlot);
+                if (slot == newSlot) {
+                    vertexMisses.push_back(vertexID);
+                    stats.vertexCacheMisses++;
+                }
+                else
+                    stats.vertexCacheHits++;
+                vertexSlots.push_back(slot);
             }
-            putPixel(inFragment);
-            
         }
-    }   
+        nofMisses = (uint32_t)vertexMisses.size();
+    }
+    else {
+        for (uint32_t v = 0; v < nofVertices; v++)
+            vertexSlots.push_back(base + v);
+    }
+
+    vertexScratch.resize((size_t)(base + nofMisses) * ctx.vertexSize);
 }
 
+/**
+ * @brief This function fetches and transforms vertices of one chunk into slots assigned by assignVertexSlots.
+ *
+ * Large chunks are fetched and shaded by worker threads.
+ *
+ * @param ctx resolved draw state, its instanceID is written into gl_InstanceID
+ * @param firstVertex number of the first vertex shader invocation of the chunk
+ * @param nofVertices number of vertex shader invocations in the chunk
+ */
+void GPU::shadeVertices(DrawContext const& ctx, uint32_t firstVertex, uint32_t nofVertices) {
+    bool cached = ctx.indices && vertexCacheMode != VertexCacheMode::DISABLED;
+    uint32_t const nofMisses = cached ? (uint32_t)vertexMisses.size() : nofVertices;
+    uint32_t const base = (uint32_t)(vertexScratch.size() / ctx.vertexSize) - nofMisses;
+
+    // fetches and shades vertices [begin, end) of misses into their slots
+    auto shade = [&](uint32_t begin, uint32_t end) {
+        InVertex inVertices[vertexFetchBatchSize];
+        InVertexBatch inBatch;
+        OutVertexBatch outBatch;
+        if (ctx.batchVS)
+            std::fill_n(&inBatch.attributes[0][0][0], maxAttributes * 4 * vertexShaderBatchSize, 1.f);
+        for (uint32_t offset = begin; offset < end; offset += vertexFetchBatchSize) {
+            uint32_t count = std::min(end - offset, vertexFetchBatchSize);
+            if (cached) {
+                for (uint32_t v = 0; v < count; v++)
+                    inVertices[v].gl_VertexID = vertexMisses[offset + v];
+                for (uint32_t h = 0; h < ctx.nofHeads; h++)
+                    ctx.heads[h].gather(inVertices, count, ctx.heads[h]);
+            }
+            else {
+                ctx.fetchVertexIDs(inVertices, count, ctx.indices, firstVertex + offset, ctx.baseVertex);
+                for (uint32_t h = 0; h < ctx.nofHeads; h++)
+                    ctx.heads[h].fetch(inVertices, count, ctx.heads[h], ctx.indices, firstVertex + offset);
+            }
+            for (uint32_t v = 0; v < count; v++)
+                inVertices[v].gl_InstanceID = ctx.instanceID;
+
+            float* packed = &vertexScratch[(size_t)(base + offset) * ctx.vertexSize];
+            if (ctx.batchVS) {
+                for (uint32_t b = 0; b < count; b += vertexShaderBatchSize) {
+                    uint32_t lanes = std::min(count - b, vertexShaderBatchSize);
+                    loadVertexBatch(inBatch, inVertices + b, lanes, ctx.heads, ctx.nofHeads);
+                    ctx.batchVS(outBatch, inBatch, *ctx.uniforms);
+                    for (uint32_t lane = 0; lane < lanes; lane++)
+                        packVertexBatch(packed + (size_t)(b + lane) * ctx.vertexSize, outBatch, lane, *ctx.varyings);
+                }
+                continue;
+            }
+            for (uint32_t v = 0; v < count; v++) {
+                OutVertex outVertex;
+                ctx.VS(outVertex, inVertices[v], *ctx.uniforms);
+                packVertex(packed + (size_t)v * ctx.vertexSize, outVertex, *ctx.varyings);
+            }
+        }
+    };
 
+    // contiguous ranges of vertices are shaded by worker threads, small chunks stay serial
+    uint32_t nofJobs = threadPool ? std::min(threadPool->getNofThreads(), nofMisses / minParallelVertices) : 1;
+    if (nofJobs <= 1) {
+        shade(0, nofMisses);
+        return;
+    }
+    threadPool->parallelFor(nofJobs, [&](uint32_t job, uint32_t) {
+        shade((uint32_t)((uint64_t)nofMisses * job / nofJobs), (uint32_t)((uint64_t)nofMisses * (job + 1) / nofJobs));
+    });
+}
 
 /**
- * @brief getting lines coordinates for drawing 
+ * @brief This function looks vertex up in post-transform vertex cache.
  *
- * @param a - start vertex of the line
- * @param b - end vertex of the line
- * @param Lines - array which be written by coordinates of borders
- * @param v0 - first vertex of the triangle
- * @param v1 - first vertex of the triangle
- * @param v2 - first vertex of the triangle
+ * If the vertex is not cached, it is inserted with newSlot.
+ *
+ * @param vertexID gl_VertexID of vertex
+ * @param newSlot slot that the vertex gets when it is not cached
+ *
+ * @return slot of transformed vertex (newSlot on cache miss)
  */
-void GPU::Line(OutVertex a, OutVertex b, glm::vec2 *Lines, OutVertex& v0, OutVertex& v1, OutVertex& v2) {
-    
-    // Getting active program
-    std::list<Program>::iterator P;
-    for (P = ProgramList.begin(); P != ProgramList.end(); P++) {
-        if (P->id == ActiveProgramID) {
-            break;
+uint32_t GPU::lookupVertexCache(uint32_t vertexID, uint32_t newSlot) {
+    if (vertexCacheMode == VertexCacheMode::FULL) {
+        if (vertexID >= vertexCacheStamps.size()) {
+            vertexCacheStamps.resize((size_t)vertexID + 1, 0);
+            vertexCacheSlots.resize((size_t)vertexID + 1, 0);
         }
+        if (vertexCacheStamps[vertexID] == vertexCacheStamp)
+            return vertexCacheSlots[vertexID];
+        vertexCacheStamps[vertexID] = vertexCacheStamp;
+        vertexCacheSlots[vertexID] = newSlot;
+        return newSlot;
     }
 
-    bool steep = (abs(b.gl_Position[1] - a.gl_Position[1]) > abs(b.gl_Position[0] - a.gl_Position[0]));
+    for (uint32_t i = 0; i < vertexCacheFifoSize; i++)
+        if (vertexCacheFifo[i].vertexID == vertexID)
+            return vertexCacheFifo[i].slot;
 
-    if (steep) {
-        swapFloat(a.gl_Position[0], a.gl_Position[1]);
-        swapFloat(b.gl_Position[0], b.gl_Position[1]);
-    }
+    vertexCacheFifo[vertexCacheFifoNext].vertexID = vertexID;
+    vertexCacheFifo[vertexCacheFifoNext].slot = newSlot;
+    vertexCacheFifoNext = (vertexCacheFifoNext + 1) % vertexCacheFifoSize;
+    return newSlot;
+}
+
+/**
+ * @brief This function selects mode of post-transform vertex cache.
+ *
+ * The cache is used only for indexed draw calls.
+ * With the cache enabled, vertex shader is not executed for every index.
+ *
+ * @param mode cache mode
+ * @param fifoSize number of entries of FIFO cache (1 - maxVertexCacheSize)
+ */
+void GPU::setVertexCacheMode(VertexCacheMode mode, uint32_t fifoSize) {
+    waitForSubmitted();
+    vertexCacheMode = mode;
+    if (fifoSize < 1)
+        fifoSize = 1;
+    if (fifoSize > maxVertexCacheSize)
+        fifoSize = maxVertexCacheSize;
+    vertexCacheFifoSize = fifoSize;
+}
+
+/**
+ * @brief This function selects how draw calls produce colors.
+ *
+ * In visibility mode, draw calls write only depth and ids of triangles,
+ * fragment shader runs once per covered pixel in resolveVisibilityBuffer.
+ * Pending draw calls are resolved when the visibility mode is switched off.
+ *
+ * @param mode render mode
+ */
+void GPU::setRenderMode(RenderMode mode) {
+    waitForSubmitted();
+    if (renderMode == RenderMode::VISIBILITY && mode != RenderMode::VISIBILITY)
+        resolveVisibilityBuffer();
+    renderMode = mode;
+}
 
-    if (a.gl_Position[0] > b.gl_Position[0])
-        swapVertex(a, b);
+/**
+ * @brief This function selects which triangles are discarded by face culling.
+ *
+ * @param mode cull mode
+ */
+void GPU::setCullMode(CullMode mode) {
+    waitForSubmitted();
+    cullMode = mode;
+}
 
+/**
+ * @brief This function selects winding of front facing triangles.
+ *
+ * @param face winding of front facing triangles in normalized device coordinates
+ */
+void GPU::setFrontFace(FrontFace face) {
+    waitForSubmitted();
+    frontFace = face;
+}
 
-    float dx = b.gl_Position[0] - a.gl_Position[0];
-    float dy = abs(b.gl_Position[1] - a.gl_Position[1]);
+/**
+ * @brief This function decides if triangle is discarded by face culling.
+ *
+ * Facing is given by the sign of screen space area after perspective division.
+ * Area of x/w, y/w is the determinant of rows (x, y, w) divided by w0*w1*w2,
+ * so the determinant itself is used. It needs no division and it gives correct facing
+ * even for triangles that cross the w = 0 plane and are clipped later.
+ * Degenerate triangles are not culled, they do not produce fragments anyway.
+ *
+ * @param a - clip space position of the first vertex
+ * @param b - clip space position of the second vertex
+ * @param c - clip space position of the third vertex
+ *
+ * @return true if the triangle should be discarded
+ */
+bool GPU::isCulled(float const* a, float const* b, float const* c) const {
+    double const det =
+        (double)a[0] * ((double)b[1] * c[3] - (double)c[1] * b[3]) -
+        (double)a[1] * ((double)b[0] * c[3] - (double)c[0] * b[3]) +
+        (double)a[3] * ((double)b[0] * c[1] - (double)c[0] * b[1]);
+    if (det == 0.0)
+        return false;
+    bool const front = (det > 0.0) == (frontFace == FrontFace::CCW);
+    return cullMode == CullMode::BACK ? !front : front;
+}
 
-    float err = dx / 2;
+/**
+ * @brief This function returns GPU statistics counters.
+ *
+ * @return statistics accumulated since construction or last resetStats
+ */
+GPUStats const& GPU::getStats() {
+    waitForSubmitted();
+    return stats;
+}
 
-    float ystep = (a.gl_Position[1] < b.gl_Position[1]) ? 1 : -1;
-    float y = a.gl_Position[1]; 
-    
+/**
+ * @brief This function resets GPU statistics counters.
+ */
+void GPU::resetStats() {
+    waitForSubmitted();
+    stats = GPUStats();
+}
 
-    for (float x = a.gl_Position[0]; x < b.gl_Position[0]; x++) {
-        if (steep)
-            swapFloat(x, y);
+/**
+ * @brief This function resolves bound vertex puller and active program into raw draw state.
+ *
+ * @param ctx draw context that is filled
+ *
+ * @return false if the draw call cannot be executed
+ */
+bool GPU::resolveDrawContext(DrawContext& ctx) {
+    VertexPullerSettings* VP = VertexPullerTable.get(bindedVPid);
+    Program* P = ProgramTable.get(ActiveProgramID);
+    if (!VP || !P || (!P->VS && !P->batchVS) || (!P->FS && !P->batchFS))
+        return false;
+
+    bool indexed = VP->indexing.enabled;
+    if (indexed) {
+        Buffer* buf = BufferTable.get(VP->indexing.buf);
+        if (!buf)
+            return false;
+
+        ctx.indices = (uint8_t const*)buf->data;
+    }
+    ctx.fetchVertexIDs = selectVertexIDFetcher(indexed, VP->indexing.type);
+    ctx.fetchVertexIDArray = selectVertexIDArrayFetcher(indexed, VP->indexing.type);
 
-        if (y < 0 || y > Height)
+    for (uint32_t i = 0; i < maxAttributes; i++) {
+        HeadSettings const& head = VP->heads[i];
+        if (!head.enabled || head.type == AttributeType::EMPTY)
             continue;
-        if (x < 0 || x > Width)
+
+        Buffer* buf = BufferTable.get(head.buf);
+        if (!buf)
             continue;
 
-        float triangleBottom = getTraingleBottom(v0, v1, v2);
+        ResolvedHead& resolved = ctx.heads[ctx.nofHeads++];
+        resolved.base = (uint8_t const*)buf->data + head.offset;
+        resolved.data = resolved.base;
+        resolved.stride = head.stride;
+        resolved.divisor = head.divisor;
+        resolved.type = head.type;
+        resolved.attrib = i;
+        if (head.divisor) {
+            resolved.fetch = selectInstanceHeadFetcher(head.type);
+            resolved.gather = selectInstanceHeadGatherer(head.type);
+        }
+        else {
+            resolved.fetch = selectHeadFetcher(indexed, VP->indexing.type, head.type, head.stride);
+            resolved.gather = selectHeadGatherer(head.type, head.stride);
+        }
+    }
 
-            if (Lines[int(y - triangleBottom)][0] == -1)
-                Lines[int(y - triangleBottom)][0] = x;
+    ctx.VS = P->VS;
+    ctx.batchVS = P->batchVS;
+    ctx.FS = P->FS;
+    ctx.batchFS = P->batchFS;
+    ctx.uniforms = &P->un;
+    ctx.varyings = &P->varyings;
+    ctx.vertexSize = packedVertexSize(P->varyings);
+    ctx.guardBandX = 1.f + 2.f * (float)guardBand / (float)std::max(Width, 1u);
+    ctx.guardBandY = 1.f + 2.f * (float)guardBand / (float)std::max(Height, 1u);
+    // indexed by depth format and color format
+    static RasterFunction const rasterFunctions[3][4] = {
+        {&GPU::rasterizeTriangle<DepthFormat::D32F, ColorFormat::RGBA8>, &GPU::rasterizeTriangle<DepthFormat::D32F, ColorFormat::RGB565>, &GPU::rasterizeTriangle<DepthFormat::D32F, ColorFormat::RGBA16F>, &GPU::rasterizeTriangle<DepthFormat::D32F, ColorFormat::BGRA8>},
+        {&GPU::rasterizeTriangle<DepthFormat::D24 , ColorFormat::RGBA8>, &GPU::rasterizeTriangle<DepthFormat::D24 , ColorFormat::RGB565>, &GPU::rasterizeTriangle<DepthFormat::D24 , ColorFormat::RGBA16F>, &GPU::rasterizeTriangle<DepthFormat::D24 , ColorFormat::BGRA8>},
+        {&GPU::rasterizeTriangle<DepthFormat::D16 , ColorFormat::RGBA8>, &GPU::rasterizeTriangle<DepthFormat::D16 , ColorFormat::RGB565>, &GPU::rasterizeTriangle<DepthFormat::D16 , ColorFormat::RGBA16F>, &GPU::rasterizeTriangle<DepthFormat::D16 , ColorFormat::BGRA8>},
+    };
+    ctx.rasterize = rasterFunctions[(int)depthFormat][(int)colorFormat];
+    return true;
+}
 
-            else if (Lines[int(y - triangleBottom)][1] == -1)
-                Lines[int(y - triangleBottom)][1] = x;
 
-            else {
-                Lines[int(y - triangleBottom)][0] = Lines[int(y - triangleBottom)][0] < Lines[int(y - triangleBottom)][1] ? Lines[int(y - triangleBottom)][0] : Lines[int(y - triangleBottom)][1];
-                if (x < Lines[int(y - triangleBottom)][0])
-                    Lines[int(y - triangleBottom)][0] = x;
-                if (x > Lines[int(y - triangleBottom)][1])
-                    Lines[int(y - triangleBottom)][1] = x;
-        }
+/**
+ * @brief This function computes signed distance of clip space position to clip plane.
+ *
+ * Planes 0 - 5 are the view frustum (left, right, bottom, top, near, far),
+ * planes 6 - 9 are the guard band (left, right, bottom, top).
+ * Position is inside the plane when the distance is not negative.
+ *
+ * @param ctx - resolved draw state
+ * @param p - clip space position
+ * @param plane - id of plane
+ *
+ * @return signed distance
+ */
+static float clipDistance(DrawContext const& ctx, glm::vec4 const& p, uint32_t plane) {
+    switch (plane) {
+    case 0: return p[3] + p[0];
+    case 1: return p[3] - p[0];
+    case 2: return p[3] + p[1];
+    case 3: return p[3] - p[1];
+    case 4: return p[3] + p[2];
+    case 5: return p[3] - p[2];
+    case 6: return ctx.guardBandX * p[3] + p[0];
+    case 7: return ctx.guardBandX * p[3] - p[0];
+    case 8: return ctx.guardBandY * p[3] + p[1];
+    default: return ctx.guardBandY * p[3] - p[1];
+    }
+}
+
+/**
+ * @brief This function computes outcode of clip space position, bit i is set if position is outside of plane i.
+ *
+ * @param ctx - resolved draw state
+ * @param p - clip space position
+ *
+ * @return outcode
+ */
+static uint32_t clipCode(DrawContext const& ctx, glm::vec4 const& p) {
+    uint32_t code = 0;
+    for (uint32_t plane = 0; plane < 4 + nofClipPlanes; plane++)
+        if (clipDistance(ctx, p, plane) < 0.f)
+            code |= 1u << plane;
+    return code;
+}
 
-        err -= dy;
+/**
+ * @brief Triangle clipping
+ *
+ * Triangles completely outside of the view frustum are discarded.
+ * Triangles are clipped exactly against near and far plane. Sides of the frustum are handled by rasterizer,
+ * triangles are clipped against the guard band only, so that screen space coordinates fit into fixed point.
+ * Clipped polygon is stored in fixed size buffers on stack and it is drawn as triangle fan.
+ *
+ * Fragment depth is perspective correct interpolation of z/w of vertices, so z/w is clipped like other attributes,
+ * clipping then does not change depth of fragments. Vertices with w <= 0 have no valid z/w,
+ * new vertices on edges that end in such vertex get z/w of their own clip space position.
+ *
+ * @param ctx - resolved draw state
+ * @param a - first vertex of the triangle
+ * @param b - second vertex of the triangle
+ * @param c - third vertex of the triangle
+ */
+void GPU::trianglesClipping(DrawContext const& ctx, ClipVertex& a, ClipVertex& b, ClipVertex& c) {
+    uint32_t const frustumPlanes = 0x3f;
+    uint32_t const clipPlanes = 0x3f0;
+
+    uint32_t const codeA = clipCode(ctx, a.gl_Position);
+    uint32_t const codeB = clipCode(ctx, b.gl_Position);
+    uint32_t const codeC = clipCode(ctx, c.gl_Position);
+    if (codeA & codeB & codeC & frustumPlanes)
+        return;
+
+    uint32_t const planes = (codeA | codeB | codeC) & clipPlanes;
+    if (!planes) {
+        viewportTransform(a);
+        viewportTransform(b);
+        viewportTransform(c);
+        Drawing(ctx, a, b, c);
+        return;
+    }
 
-        if (err < 0)
-        {
-            y += ystep;
-            err += dx;
+    // Sutherland-Hodgman clipping, polygons contain pointers to input vertices or new vertices
+    ClipVertex newVertices[maxClipNewVertices];
+    uint32_t nofNewVertices = 0;
+    ClipVertex* polygons[2][maxClipPolygonVertices] = { { &a, &b, &c } };
+    float depths[2][maxClipPolygonVertices] = { { a.gl_Position[2] / a.gl_Position[3], b.gl_Position[2] / b.gl_Position[3], c.gl_Position[2] / c.gl_Position[3] } };
+    ClipVertex** polygon = polygons[0];
+    ClipVertex** clipped = polygons[1];
+    float* polygonDepth = depths[0];
+    float* clippedDepth = depths[1];
+    uint32_t n = 3;
+
+    for (uint32_t plane = 4; plane < 4 + nofClipPlanes; plane++) {
+        if (!(planes & (1u << plane)))
+            continue;
+        uint32_t m = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t const j = (i + 1) % n;
+            float const dc = clipDistance(ctx, polygon[i]->gl_Position, plane);
+            float const dn = clipDistance(ctx, polygon[j]->gl_Position, plane);
+            if (dc >= 0.f) {
+                clippedDepth[m] = polygonDepth[i];
+                clipped[m++] = polygon[i];
+            }
+            if ((dc >= 0.f) != (dn >= 0.f)) {
+                // new vertex is always interpolated from the inside vertex,
+                // so neighbouring triangles get exactly the same vertex on their shared edge
+                uint32_t const in = dc >= 0.f ? i : j;
+                uint32_t const out = dc >= 0.f ? j : i;
+                float const t = dc >= 0.f ? dc / (dc - dn) : dn / (dn - dc);
+                ClipVertex* v = &newVertices[nofNewVertices++];
+                lerpVertex(*v, *polygon[in], *polygon[out], t, *ctx.varyings);
+                if (polygon[out]->gl_Position[3] > 0.f)
+                    clippedDepth[m] = polygonDepth[in] + t * (polygonDepth[out] - polygonDepth[in]);
+                else
+                    clippedDepth[m] = v->gl_Position[2] / v->gl_Position[3];
+                clipped[m++] = v;
+            }
         }
+        std::swap(polygon, clipped);
+        std::swap(polygonDepth, clippedDepth);
+        n = m;
+        if (n < 3)
+            return;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        viewportTransform(*polygon[i]);
+        polygon[i]->gl_Position[2] = polygonDepth[i];
+    }
+    for (uint32_t i = 1; i + 1 < n; i++)
+        Drawing(ctx, *polygon[0], *polygon[i], *polygon[i + 1]);
+}
+
 
-        if (steep)
-            swapFloat(x, y);
+/**
+ * @brief Triangle rasterization
+ *
+ * Triangle is rasterized immediately, or it is binned into screen tiles
+ * when worker threads are enabled (see setThreadCount).
+ *
+ * @param ctx - resolved draw state
+ * @param a - first vertex of the triangle in screen space
+ * @param b - second vertex of the triangle in screen space
+ * @param c - third vertex of the triangle in screen space
+ */
+void GPU::Drawing(DrawContext const& ctx, ClipVertex& a, ClipVertex& b, ClipVertex& c) {
+    TriangleSetup t;
+    float planes[3 * maxVaryingFloats];
+    if (!setupTriangle(ctx, a, b, c, t, planes))
+        return;
 
+    // triangle is rejected when it lies behind all tiles of hierarchical z-buffer it touches
+    bool hidden = true;
+    for (int32_t y = t.minY / (int32_t)hizTileSize; hidden && y <= t.maxY / (int32_t)hizTileSize; y++)
+        for (int32_t x = t.minX / (int32_t)hizTileSize; hidden && x <= t.maxX / (int32_t)hizTileSize; x++)
+            hidden = t.minZ >= hizBuf[(uint32_t)y * hizTilesX + (uint32_t)x];
+    if (hidden) {
+        stats.hizRejectedTriangles++;
+        return;
     }
 
+    if (ctx.visibility)
+        recordTriangle(ctx, t);
+
+    if (threadPool)
+        binTriangle(ctx, t);
+    else {
+        RasterStats const raster = (this->*ctx.rasterize)(ctx, t, t.minX, t.minY, t.maxX, t.maxY);
+        stats.hizRejectedTiles += raster.hizRejectedTiles;
+        stats.fragmentShaderInvocations += raster.shadedFragments;
+    }
 }
 
- void GPU::swapVertex(OutVertex& a, OutVertex& b)
-{
-     OutVertex t;
-     t = a;
-     a = b;
-     b = t;
+/**
+ * @brief This function stores triangle of draw call recorded into visibility buffer.
+ *
+ * Setup and attribute plane equations are kept until resolveVisibilityBuffer,
+ * id of the triangle is written into visibility buffer by rasterization.
+ *
+ * @param ctx - resolved draw state
+ * @param t - triangle setup, its visibilityID is filled
+ */
+void GPU::recordTriangle(DrawContext const& ctx, TriangleSetup& t) {
+    VisibilityDraw const& draw = visibilityDraws.back();
+    uint64_t const drawID = visibilityDraws.size() - 1;
+    uint64_t const primitiveID = visibilityTriangles.size() - draw.firstTriangle;
+    t.visibilityID = (drawID << 32) | primitiveID;
+    visibilityTriangles.push_back(t);
+    visibilityPlanes.insert(visibilityPlanes.end(), t.planes, t.planes + 3 * ctx.varyings->nofFloats);
 }
 
+/**
+ * @brief Triangle setup
+ *
+ * Vertices are snapped to sub-pixel fixed point and edge functions are computed.
+ * Pixel is covered when its center is inside the triangle or lies on its top or left edge,
+ * so triangles that share an edge never produce the same fragment twice and leave no holes.
+ *
+ * 1/w, z/w and attr/w are linear in screen space, so their plane equations are computed once per triangle
+ * and perspective correct values cost one plane evaluation per value and one reciprocal per fragment.
+ *
+ * @param ctx - resolved draw state
+ * @param a - first vertex of the triangle in screen space
+ * @param b - second vertex of the triangle in screen space
+ * @param c - third vertex of the triangle in screen space
+ * @param t - setup that is filled
+ * @param planes - storage for attribute plane equations (3 * number of packed floats)
+ *
+ * @return false if the triangle does not cover any pixel center of the framebuffer
+ */
+bool GPU::setupTriangle(DrawContext const& ctx, ClipVertex const& a, ClipVertex const& b, ClipVertex const& c, TriangleSetup& t, float* planes) {
+    ClipVertex const* v[3] = { &a, &b, &c };
+
+    // Snap to sub-pixel grid, coordinates are clamped so that edge functions fit into 64 bits
+    int64_t const subPixels = (int64_t)1 << subPixelBits;
+    float const maxCoord = (float)((int64_t)1 << (maxRasterCoordBits - subPixelBits));
+    int64_t X[3], Y[3];
+    for (int i = 0; i < 3; i++) {
+        float x = v[i]->gl_Position[0];
+        float y = v[i]->gl_Position[1];
+        if (!(x > -maxCoord)) x = -maxCoord;
+        if (!(x < maxCoord)) x = maxCoord;
+        if (!(y > -maxCoord)) y = -maxCoord;
+        if (!(y < maxCoord)) y = maxCoord;
+        X[i] = (int64_t)std::llround(x * subPixels);
+        Y[i] = (int64_t)std::llround(y * subPixels);
+    }
+
+    int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+    if (area == 0)
+        return false;
 
- void GPU::swapFloat(float &a, float &b) {
-     float t = a;
-     a = b;
-     b = t;
+    // Both windings are rasterized, clockwise triangles are turned counter-clockwise
+    if (area < 0) {
+        std::swap(v[1], v[2]);
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+        area = -area;
+    }
+
+    // Bounding box in pixels clamped to the framebuffer
+    int64_t minX = std::min({ X[0], X[1], X[2] }) >> subPixelBits;
+    int64_t maxX = std::max({ X[0], X[1], X[2] }) >> subPixelBits;
+    int64_t minY = std::min({ Y[0], Y[1], Y[2] }) >> subPixelBits;
+    int64_t maxY = std::max({ Y[0], Y[1], Y[2] }) >> subPixelBits;
+    t.minX = (int32_t)std::max<int64_t>(minX, 0);
+    t.minY = (int32_t)std::max<int64_t>(minY, 0);
+    t.maxX = (int32_t)std::min<int64_t>(maxX, (int64_t)Width - 1);
+    t.maxY = (int32_t)std::min<int64_t>(maxY, (int64_t)Height - 1);
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return false;
+
+    // Edge i is opposite to vertex i, its value at pixel center is weight of vertex i
+    int64_t const center = subPixels / 2;
+    for (int i = 0; i < 3; i++) {
+        int s = (i + 1) % 3;
+        int e = (i + 2) % 3;
+        int64_t dx = X[e] - X[s];
+        int64_t dy = Y[e] - Y[s];
+        bool topLeft = dy < 0 || (dy == 0 && dx < 0);
+        t.bias[i] = topLeft ? 0 : 1;
+        t.stepX[i] = -dy * subPixels;
+        t.stepY[i] = dx * subPixels;
+        t.edge[i] = dx * (center - Y[s]) - dy * (center - X[s]) - t.bias[i];
+    }
+
+    // Barycentric coordinates divided by w as planes anchored in the corner of bounding box,
+    // they are computed in double, so large edge values do not cancel out
+    t.originX = t.minX;
+    t.originY = t.minY;
+    double l[3][3];
+    for (int i = 0; i < 3; i++) {
+        double const invW = 1.0 / (double)v[i]->gl_Position[3];
+        double const scale = invW / (double)area;
+        l[i][0] = (double)(t.edge[i] + t.bias[i] + t.originX * t.stepX[i] + t.originY * t.stepY[i]) * scale;
+        l[i][1] = (double)t.stepX[i] * scale;
+        l[i][2] = (double)t.stepY[i] * scale;
+    }
+    for (int k = 0; k < 3; k++) {
+        t.invW[k] = (float)(l[0][k] + l[1][k] + l[2][k]);
+        t.z[k] = (float)(l[0][k] * v[0]->gl_Position[2] + l[1][k] * v[1]->gl_Position[2] + l[2][k] * v[2]->gl_Position[2]);
+    }
+    // depth is perspective correct interpolation of vertex depths, so it never gets below the nearest one,
+    // bound is widened to cover rounding of interpolation
+    t.minZ = std::min({ v[0]->gl_Position[2], v[1]->gl_Position[2], v[2]->gl_Position[2] }) - hizDepthSlack;
+    uint32_t const nofFloats = ctx.varyings->nofFloats;
+    for (uint32_t f = 0; f < nofFloats; f++)
+        for (int k = 0; k < 3; k++)
+            planes[k * nofFloats + f] = (float)(l[0][k] * v[0]->varyings[f] + l[1][k] * v[1]->varyings[f] + l[2][k] * v[2]->varyings[f]);
+    t.planes = planes;
+    return true;
 }
 
+/**
+ * @brief This function rasterizes part of triangle and shades its fragments.
+ *
+ * @param ctx - resolved draw state
+ * @param t - triangle setup
+ * @param minX - rasterized rectangle (inclusive), it has to lie in bounding box of the triangle
+ * @param minY - rasterized rectangle (inclusive), it has to lie in bounding box of the triangle
+ * @param maxX - rasterized rectangle (inclusive), it has to lie in bounding box of the triangle
+ * @param maxY - rasterized rectangle (inclusive), it has to lie in bounding box of the triangle
+ *
+ * In visibility mode, fragments that pass depth test write depth and id of the triangle instead of being shaded.
+ * Depth test compares depths quantized to depth format of framebuffer.
+ *
+ * @tparam FORMAT depth format of framebuffer
+ * @tparam COLOR color format of framebuffer
+ * @return number of tiles rejected by hierarchical z-buffer and number of shaded fragments
+ */
+template<DepthFormat FORMAT, ColorFormat COLOR>
+RasterStats GPU::rasterizeTriangle(DrawContext const& ctx, TriangleSetup const& t, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY) {
+    VaryingLayout const& layout = *ctx.varyings;
+    uint32_t const nofFloats = layout.nofFloats;
+    float const* planeDX = t.planes + nofFloats;
+    float const* planeDY = t.planes + 2 * nofFloats;
+
+    // fragments that pass depth test are gathered along scanlines of tiles and shaded in batches
+    InFragmentBatch batch;
+    uint32_t pixels[fragmentShaderBatchSize];
+    uint32_t nofFragments = 0;
+
+    RasterStats result;
+    float rowPlanes[maxVaryingFloats];
+    using Depth = DepthTraits<FORMAT>;
+    typename Depth::Type* depthPixels = (typename Depth::Type*)depthBuf;
+
+    // rectangle is traversed in tiles of hierarchical z-buffer, tiles whose farthest depth is nearer than the triangle are skipped
+    for (int32_t tileY = minY / (int32_t)hizTileSize; tileY <= maxY / (int32_t)hizTileSize; tileY++) {
+        int32_t const tileMinY = std::max(minY, tileY * (int32_t)hizTileSize);
+        int32_t const tileMaxY = std::min(maxY, tileY * (int32_t)hizTileSize + (int32_t)hizTileSize - 1);
+        for (int32_t tileX = minX / (int32_t)hizTileSize; tileX <= maxX / (int32_t)hizTileSize; tileX++) {
+            uint32_t const tile = (uint32_t)tileY * hizTilesX + (uint32_t)tileX;
+            if (pendingClears[tile] & pendingHiZ)
+                rebuildHiZTile(tile);
+            if (t.minZ >= hizBuf[tile]) {
+                result.hizRejectedTiles++;
+                continue;
+            }
+            if (pendingClears[tile])
+                initializeTile(tile);
+            int32_t const tileMinX = std::max(minX, tileX * (int32_t)hizTileSize);
+            int32_t const tileMaxX = std::min(maxX, tileX * (int32_t)hizTileSize + (int32_t)hizTileSize - 1);
+
+            // covered pixels end with depth at most z of the triangle, whether they pass depth test or not
+            uint64_t coverage = 0;
+            float coverageMaxZ = -INFINITY;
+
+            for (int32_t y = tileMinY; y <= tileMaxY; y++) {
+                int64_t e0 = t.edge[0] + tileMinX * t.stepX[0] + y * t.stepY[0];
+                int64_t e1 = t.edge[1] + tileMinX * t.stepX[1] + y * t.stepY[1];
+                int64_t e2 = t.edge[2] + tileMinX * t.stepX[2] + y * t.stepY[2];
+
+                // planes are evaluated relative to the triangle origin, not to the rasterized rectangle,
+                // so binned rasterization produces the same values as rasterization of the whole triangle
+                float const fy = (float)(y - t.originY);
+                float const rowInvW = t.invW[0] + t.invW[2] * fy;
+                float const rowZ = t.z[0] + t.z[2] * fy;
+                uint32_t const rowOffset = pixelRowOffsets[y];
+                bool rowPlanesReady = false;
+
+                for (int32_t x = tileMinX; x <= tileMaxX; x++) {
+                    if ((e0 | e1 | e2) >= 0) {
+                        // perspective correct interpolation, w = 1 / (1/w)
+                        float const fx = (float)(x - t.originX);
+                        float const w = 1.f / (rowInvW + t.invW[1] * fx);
+                        float const z = (rowZ + t.z[1] * fx) * w;
+                        coverage |= (uint64_t)1 << ((y % hizTileSize) * hizTileSize + x % hizTileSize);
+                        coverageMaxZ = std::max(coverageMaxZ, z);
+
+                        // Depth test
+                        uint32_t pixel = rowOffset + pixelColumnOffsets[x];
+                        typename Depth::Type const depth = Depth::quantize(z);
+                        if (depthPixels[pixel] > depth) {
+                            if (ctx.visibility) {
+                                depthPixels[pixel] = depth;
+                                visibilityBuf[pixel] = t.visibilityID;
+                            }
+                            else {
+                                if (!rowPlanesReady) {
+                                    for (uint32_t f = 0; f < nofFloats; f++)
+                                        rowPlanes[f] = t.planes[f] + planeDY[f] * fy;
+                                    rowPlanesReady = true;
+                                }
+
+                                uint32_t lane = nofFragments++;
+                                pixels[lane] = pixel;
+                                batch.gl_FragCoord[0][lane] = x + 0.5f;
+                                batch.gl_FragCoord[1][lane] = y + 0.5f;
+                                batch.gl_FragCoord[2][lane] = z;
+                                batch.gl_FragCoord[3][lane] = 1.f;
+
+                                // only declared attributes are interpolated
+                                for (uint32_t i = 0; i < layout.nofVaryings; i++) {
+                                    uint32_t o = layout.offset[i];
+                                    for (uint32_t c = 0; c < layout.size[i]; c++)
+                                        batch.attributes[layout.attrib[i]][c][lane] = (rowPlanes[o + c] + planeDX[o + c] * fx) * w;
+                                }
+
+                                if (nofFragments == fragmentShaderBatchSize) {
+                                    shadeFragments<FORMAT, COLOR>(ctx, batch, pixels, nofFragments);
+                                    result.shadedFragments += nofFragments;
+                                    nofFragments = 0;
+                                }
+                            }
+                        }
+                    }
+                    e0 += t.stepX[0];
+                    e1 += t.stepX[1];
+                    e2 += t.stepX[2];
+                }
+            }
 
- void GPU::putPixel(InFragment inFragment) {
-     std::list<Program>::iterator P;
-     for (P = ProgramList.begin(); P != ProgramList.end(); P++) {
-         if (P->id == ActiveProgramID) {
-             break;
-         }
-     }
+            if (coverage)
+                updateHiZ(tile, coverage, coverageMaxZ);
+        }
+    }
 
-     int x = inFragment.gl_FragCoord[0];
-     int y = inFragment.gl_FragCoord[1];
-     int z = inFragment.gl_FragCoord[2];
-     OutFragment outFragment;
-     P->FS(outFragment, inFragment, P->un);
+    // triangle never covers a pixel twice, so depth test of gathered fragments stays valid until here
+    if (nofFragments)
+        shadeFragments<FORMAT, COLOR>(ctx, batch, pixels, nofFragments);
+    result.shadedFragments += nofFragments;
+    return result;
+}
 
-     colorBuf[((int)y * Width + (int)x) * 4] = outFragment.gl_FragColor[0] * 255;
-     colorBuf[((int)y * Width + (int)x) * 4 + 1] = outFragment.gl_FragColor[1] * 255;
-     colorBuf[((int)y * Width + (int)x) * 4 + 2] = outFragment.gl_FragColor[2] * 255;
-     colorBuf[((int)y * Width + (int)x) * 4 + 3] = outFragment.gl_FragColor[3] * 255;
-     depthBuf[((int)y * Width + (int)x)] = z;
- }
+/**
+ * @brief This function shades rows of visibility buffer.
+ *
+ * Fragments are interpolated exactly like in rasterizeTriangle
+ * and gathered into batches of fragments of the same draw call.
+ *
+ * @param minY - first row
+ * @param maxY - row after the last row
+ *
+ * @return number of shaded fragments
+ *
+ * @tparam FORMAT depth format of framebuffer
+ * @tparam COLOR color format of framebuffer
+ */
+template<DepthFormat FORMAT, ColorFormat COLOR>
+uint64_t GPU::resolveRows(uint32_t minY, uint32_t maxY) {
+    InFragmentBatch batch;
+    uint32_t pixels[fragmentShaderBatchSize];
+    uint32_t nofFragments = 0;
+    uint64_t shadedFragments = 0;
+
+    DrawContext ctx;
+    uint64_t currentDraw = emptyVisibility;
+
+    for (uint32_t y = minY; y < maxY; y++) {
+        for (uint32_t x = 0; x < Width; x++) {
+            uint32_t const pixel = pixelRowOffsets[y] + pixelColumnOffsets[x];
+            uint64_t const id = visibilityBuf[pixel];
+            if (id == emptyVisibility)
+                continue;
 
- float GPU::getTraingleTop(OutVertex& a, OutVertex& b, OutVertex& c) {
-     float triangleTop = a.gl_Position[1] > b.gl_Position[1] ? a.gl_Position[1] : b.gl_Position[1];
-     triangleTop = triangleTop > c.gl_Position[1] ? triangleTop : c.gl_Position[1];
+            uint64_t const drawID = id >> 32;
+            if (drawID != currentDraw) {
+                if (nofFragments) {
+                    shadeFragments<FORMAT, COLOR>(ctx, batch, pixels, nofFragments);
+                    shadedFragments += nofFragments;
+                    nofFragments = 0;
+                }
+                VisibilityDraw const& draw = visibilityDraws[drawID];
+                ctx.FS = draw.FS;
+                ctx.batchFS = draw.batchFS;
+                ctx.uniforms = &draw.uniforms;
+                ctx.varyings = &draw.varyings;
+                currentDraw = drawID;
+            }
 
-     return triangleTop;
- }
+            VaryingLayout const& layout = *ctx.varyings;
+            uint32_t const nofFloats = layout.nofFloats;
+            TriangleSetup const& t = visibilityTriangles[visibilityDraws[drawID].firstTriangle + (uint32_t)id];
+            float const* planeDX = t.planes + nofFloats;
+            float const* planeDY = t.planes + 2 * nofFloats;
+            float const fx = (float)((int32_t)x - t.originX);
+            float const fy = (float)((int32_t)y - t.originY);
+            float const rowInvW = t.invW[0] + t.invW[2] * fy;
+            float const rowZ = t.z[0] + t.z[2] * fy;
+            float const w = 1.f / (rowInvW + t.invW[1] * fx);
+
+            uint32_t lane = nofFragments++;
+            pixels[lane] = pixel;
+            batch.gl_FragCoord[0][lane] = x + 0.5f;
+            batch.gl_FragCoord[1][lane] = y + 0.5f;
+            batch.gl_FragCoord[2][lane] = (rowZ + t.z[1] * fx) * w;
+            batch.gl_FragCoord[3][lane] = 1.f;
+            for (uint32_t i = 0; i < layout.nofVaryings; i++) {
+                uint32_t o = layout.offset[i];
+                for (uint32_t c = 0; c < layout.size[i]; c++)
+                    batch.attributes[layout.attrib[i]][c][lane] = (t.planes[o + c] + planeDY[o + c] * fy + planeDX[o + c] * fx) * w;
+            }
 
+            if (nofFragments == fragmentShaderBatchSize) {
+                shadeFragments<FORMAT, COLOR>(ctx, batch, pixels, nofFragments);
+                shadedFragments += nofFragments;
+                nofFragments = 0;
+            }
+        }
+    }
 
- float GPU::getTraingleBottom(OutVertex& a, OutVertex& b, OutVertex& c) {
-     float triangleBottom = a.gl_Position[1] < b.gl_Position[1] ? a.gl_Position[1] : b.gl_Position[1];
-     triangleBottom = triangleBottom < c.gl_Position[1] ? triangleBottom : c.gl_Position[1];
+    if (nofFragments)
+        shadeFragments<FORMAT, COLOR>(ctx, batch, pixels, nofFragments);
+    return shadedFragments + nofFragments;
+}
 
-     return triangleBottom;
- }
+/**
+ * @brief This function updates tile of hierarchical z-buffer after rasterization of triangle.
+ *
+ * Covered pixels are accumulated into layer with maximal depth of covered fragments.
+ * When the layer covers the whole tile, maximum of the tile is lowered to maximum of the layer.
+ *
+ * @param tile - tile of hierarchical z-buffer
+ * @param coverage - pixels of the tile covered by triangle (bit y * hizTileSize + x)
+ * @param maxZ - maximal depth of covered fragments
+ */
+void GPU::updateHiZ(uint32_t tile, uint64_t coverage, float maxZ) {
+    HiZLayer& layer = hizLayers[tile];
+    layer.coverage |= coverage;
+    layer.maxZ = std::max(layer.maxZ, maxZ);
+
+    uint32_t const width = std::min(hizTileSize, Width - (tile % hizTilesX) * hizTileSize);
+    uint32_t const height = std::min(hizTileSize, Height - (tile / hizTilesX) * hizTileSize);
+    uint64_t const rowMask = ((uint64_t)1 << width) - 1;
+    uint64_t full = 0;
+    for (uint32_t y = 0; y < height; y++)
+        full |= rowMask << (y * hizTileSize);
+
+    if ((layer.coverage & full) == full) {
+        hizBuf[tile] = std::min(hizBuf[tile], layer.maxZ);
+        layer = HiZLayer();
+    }
+}
+
+/**
+ * @brief This function recomputes hierarchical z-buffer from depth buffer.
+ *
+ * It is used when depth buffer could be changed outside of the pipeline.
+ */
+void GPU::rebuildHiZ() {
+    resolveClears(pendingClearDepth);
+    hizBuf.assign((size_t)hizTilesX * hizTilesY, -INFINITY);
+    hizLayers.assign((size_t)hizTilesX * hizTilesY, HiZLayer());
+    for (uint32_t y = 0; y < Height; y++)
+        for (uint32_t x = 0; x < Width; x++) {
+            float& tileMax = hizBuf[(y / hizTileSize) * hizTilesX + x / hizTileSize];
+            tileMax = std::max(tileMax, loadDepth(depthBuf, pixelRowOffsets[y] + pixelColumnOffsets[x], depthFormat));
+        }
+    // depth read from fixed point format can be rounded below the stored value, tiles keep bound that is not lower
+    if (depthFormat != DepthFormat::D32F)
+        for (float& tileMax : hizBuf)
+            tileMax = std::nextafter(tileMax, INFINITY);
+    for (uint8_t& clears : pendingClears)
+        clears &= (uint8_t)~pendingHiZ;
+    hizValid = true;
+}
+
+/**
+ * @brief This function recomputes one tile of hierarchical z-buffer from depth buffer.
+ *
+ * It is called by the rasterizer before the tile is tested, so it runs on the thread that owns the tile.
+ *
+ * @param tile - tile of hierarchical z-buffer marked by pendingHiZ
+ */
+void GPU::rebuildHiZTile(uint32_t tile) {
+    uint32_t const minX = (tile % hizTilesX) * hizTileSize;
+    uint32_t const minY = (tile / hizTilesX) * hizTileSize;
+    float tileMax = -INFINITY;
+    for (uint32_t y = minY; y < std::min(minY + hizTileSize, Height); y++)
+        for (uint32_t x = minX; x < std::min(minX + hizTileSize, Width); x++)
+            tileMax = std::max(tileMax, loadDepth(depthBuf, pixelRowOffsets[y] + pixelColumnOffsets[x], depthFormat));
+    if (depthFormat != DepthFormat::D32F)
+        tileMax = std::nextafter(tileMax, INFINITY);
+    hizBuf[tile] = tileMax;
+    hizLayers[tile] = HiZLayer();
+    pendingClears[tile] &= (uint8_t)~pendingHiZ;
+}
+
+/**
+ * @brief This function marks tile of hierarchical z-buffer whose depth could be changed outside of the pipeline.
+ *
+ * The tile rejects nothing until the rasterizer recomputes it (see rebuildHiZTile).
+ *
+ * @param tile - tile of hierarchical z-buffer
+ */
+void GPU::invalidateHiZTile(uint32_t tile) {
+    pendingClears[tile] |= pendingHiZ;
+    clearsPending = true;
+    hizBuf[tile] = INFINITY;
+    hizLayers[tile] = HiZLayer();
+}
+
+/**
+ * @brief This function runs fragment shader for batch of fragments and writes results into framebuffer.
+ *
+ * Scalar fragment shaders are called for every fragment of the batch.
+ *
+ * @param ctx - resolved draw state
+ * @param batch - interpolated fragments, mask is filled here
+ * @param pixels - framebuffer pixel of every fragment
+ * @param count - number of fragments (1 - fragmentShaderBatchSize)
+ *
+ * @tparam FORMAT depth format of framebuffer
+ * @tparam COLOR color format of framebuffer
+ */
+template<DepthFormat FORMAT, ColorFormat COLOR>
+void GPU::shadeFragments(DrawContext const& ctx, InFragmentBatch& batch, uint32_t const* pixels, uint32_t count) {
+    if (ctx.batchFS) {
+        batch.mask = (uint32_t)((1ull << count) - 1);
+        // value initialised, so fragment shader that does not write color produces deterministic output
+        OutFragmentBatch out = OutFragmentBatch();
+        ctx.batchFS(out, batch, *ctx.uniforms);
+        for (uint32_t lane = 0; lane < count; lane++)
+            putPixel<FORMAT, COLOR>(pixels[lane], batch.gl_FragCoord[2][lane],
+                glm::vec4(out.gl_FragColor[0][lane], out.gl_FragColor[1][lane], out.gl_FragColor[2][lane], out.gl_FragColor[3][lane]));
+        return;
+    }
+
+    VaryingLayout const& layout = *ctx.varyings;
+    for (uint32_t lane = 0; lane < count; lane++) {
+        InFragment inFragment;
+        for (uint32_t c = 0; c < 4; c++)
+            inFragment.gl_FragCoord[c] = batch.gl_FragCoord[c][lane];
+        for (uint32_t i = 0; i < layout.nofVaryings; i++)
+            for (uint32_t c = 0; c < layout.size[i]; c++)
+                inFragment.attributes[layout.attrib[i]].v4[c] = batch.attributes[layout.attrib[i]][c][lane];
+
+        // value initialised, so fragment shader that does not write color produces deterministic output
+        OutFragment outFragment = OutFragment();
+        ctx.FS(outFragment, inFragment, *ctx.uniforms);
+        putPixel<FORMAT, COLOR>(pixels[lane], batch.gl_FragCoord[2][lane], outFragment.gl_FragColor);
+    }
+}
+
+/**
+ * @brief This function prepares tile bins for draw call.
+ *
+ * @param ctx - resolved draw state
+ */
+void GPU::prepareBins(DrawContext const& ctx) {
+    tilesX = (Width + tileSize - 1) / tileSize;
+    tilesY = (Height + tileSize - 1) / tileSize;
+    if (tileBins.size() < (size_t)tilesX * tilesY)
+        tileBins.resize((size_t)tilesX * tilesY);
+    binnedTriangles.clear();
+    binnedTriangles.reserve(maxBinnedTriangles);
+    activeTiles.reserve((size_t)tilesX * tilesY);
+    binnedPlanes.resize((size_t)maxBinnedTriangles * 3 * ctx.varyings->nofFloats);
+}
 
- void GPU::postProcesses(OutVertex& a, OutVertex& b, OutVertex& c) {
-     a.gl_Position[0] = a.gl_Position[0] / a.gl_Position[3];
-     a.gl_Position[1] = a.gl_Position[1] / a.gl_Position[3];
-     a.gl_Position[2] = a.gl_Position[2] / a.gl_Position[3];
+/**
+ * @brief This function stores triangle into bins of all tiles that its bounding box touches.
+ *
+ * Attribute plane equations are copied, because they live on stack of the caller.
+ *
+ * @param ctx - resolved draw state
+ * @param t - triangle setup
+ */
+void GPU::binTriangle(DrawContext const& ctx, TriangleSetup const& t) {
+    if (binnedTriangles.size() == maxBinnedTriangles)
+        flushBins(ctx);
+
+    uint32_t const id = (uint32_t)binnedTriangles.size();
+    uint32_t const nofFloats = ctx.varyings->nofFloats;
+    binnedTriangles.push_back(t);
+    float* dst = binnedPlanes.data() + (size_t)id * 3 * nofFloats;
+    std::copy(t.planes, t.planes + 3 * nofFloats, dst);
+    binnedTriangles.back().planes = dst;
+
+    for (uint32_t ty = t.minY / tileSize; ty <= t.maxY / tileSize; ty++)
+        for (uint32_t tx = t.minX / tileSize; tx <= t.maxX / tileSize; tx++) {
+            uint32_t tile = ty * tilesX + tx;
+            if (tileBins[tile].empty())
+                activeTiles.push_back(tile);
+            tileBins[tile].push_back(id);
+        }
+}
+
+/**
+ * @brief This function rasterizes all binned triangles, tiles are processed in parallel.
+ *
+ * Every tile owns its part of color and depth buffer and processes its triangles
+ * in primitive order, so the result is identical to single threaded rasterization.
+ *
+ * @param ctx - resolved draw state
+ */
+void GPU::flushBins(DrawContext const& ctx) {
+    std::atomic<uint64_t> rejectedTiles{ 0 };
+    std::atomic<uint64_t> shadedFragments{ 0 };
+    threadPool->parallelFor((uint32_t)activeTiles.size(), [&](uint32_t job, uint32_t) {
+        uint32_t const tile = activeTiles[job];
+        int32_t const tileMinX = (int32_t)((tile % tilesX) * tileSize);
+        int32_t const tileMinY = (int32_t)((tile / tilesX) * tileSize);
+        int32_t const tileMaxX = tileMinX + (int32_t)tileSize - 1;
+        int32_t const tileMaxY = tileMinY + (int32_t)tileSize - 1;
+        RasterStats tileStats;
+        for (uint32_t id : tileBins[tile]) {
+            TriangleSetup const& t = binnedTriangles[id];
+            RasterStats const raster = (this->*ctx.rasterize)(ctx, t,
+                std::max(t.minX, tileMinX), std::max(t.minY, tileMinY),
+                std::min(t.maxX, tileMaxX), std::min(t.maxY, tileMaxY));
+            tileStats.hizRejectedTiles += raster.hizRejectedTiles;
+            tileStats.shadedFragments += raster.shadedFragments;
+        }
+        tileBins[tile].clear();
+        rejectedTiles += tileStats.hizRejectedTiles;
+        shadedFragments += tileStats.shadedFragments;
+    });
+    stats.hizRejectedTiles += rejectedTiles;
+    stats.fragmentShaderInvocations += shadedFragments;
+    activeTiles.clear();
+    binnedTriangles.clear();
+}
 
-     b.gl_Position[0] = b.gl_Position[0] / b.gl_Position[3];
-     b.gl_Position[1] = b.gl_Position[1] / b.gl_Position[3];
-     b.gl_Position[2] = b.gl_Position[2] / b.gl_Position[3];
+/**
+ * @brief This function selects number of threads used for rendering.
+ *
+ * With more than one thread, vertex shader runs in parallel for large draw calls,
+ * triangles are binned into screen tiles and tiles are rasterized in parallel.
+ * Vertex and fragment shader have to be thread safe in that case.
+ *
+ * @param nofThreads number of threads (1 renders on calling thread only)
+ */
+void GPU::setThreadCount(uint32_t nofThreads) {
+    waitForSubmitted();
+    if (nofThreads <= 1)
+        threadPool = nullptr;
+    else if (!threadPool || threadPool->getNofThreads() != nofThreads)
+        threadPool = std::make_unique<ThreadPool>(nofThreads);
+}
 
-     c.gl_Position[0] = c.gl_Position[0] / c.gl_Position[3];
-     c.gl_Position[1] = c.gl_Position[1] / c.gl_Position[3];
-     c.gl_Position[2] = c.gl_Position[2] / c.gl_Position[3];
+/**
+ * @brief This function selects size of screen tiles for binned rasterization.
+ *
+ * Size is rounded up to multiple of hizTileSize, so every tile of hierarchical z-buffer is owned by one thread.
+ *
+ * @param size size of tile in pixels
+ */
+void GPU::setTileSize(uint32_t size) {
+    waitForSubmitted();
+    tileSize = std::max((size + hizTileSize - 1) / hizTileSize, 1u) * hizTileSize;
+}
 
+/**
+ * @brief This function selects size of guard band.
+ *
+ * Triangles that reach into the guard band are rasterized without clipping against sides of the view frustum,
+ * only triangles that reach outside of it are clipped.
+ *
+ * @param pixels number of pixels the guard band extends beyond every side of the framebuffer (at most maxGuardBand)
+ */
+void GPU::setGuardBand(uint32_t pixels) {
+    waitForSubmitted();
+    guardBand = std::min(pixels, maxGuardBand);
+}
 
-     a.gl_Position[0] = (a.gl_Position[0] + 1) * Width / 2;
-     a.gl_Position[1] = (a.gl_Position[1] + 1) * Height / 2;
+/**
+ * @brief This function writes shaded fragment into framebuffer.
+ *
+ * @param pixel - index of pixel
+ * @param z - depth of fragment
+ * @param color - color of fragment
+ *
+ * @tparam FORMAT depth format of framebuffer
+ * @tparam COLOR color format of framebuffer
+ */
+template<DepthFormat FORMAT, ColorFormat COLOR>
+void GPU::putPixel(uint32_t pixel, float z, glm::vec4 const& color) {
+    encodeColor(colorBuf + (size_t)pixel * colorFormatSize(COLOR), COLOR, color);
+    storeDepth(depthBuf, pixel, FORMAT, z);
+}
 
-     b.gl_Position[0] = (b.gl_Position[0] + 1) * Width / 2;
-     b.gl_Position[1] = (b.gl_Position[1] + 1) * Height / 2;
+/**
+ * @brief This function performs perspective division and viewport transformation of vertex.
+ *
+ * @param v - vertex, clip space position is replaced by screen space position
+ */
+ void GPU::viewportTransform(ClipVertex& v) {
+     v.gl_Position[0] = v.gl_Position[0] / v.gl_Position[3];
+     v.gl_Position[1] = v.gl_Position[1] / v.gl_Position[3];
+     v.gl_Position[2] = v.gl_Position[2] / v.gl_Position[3];
 
-     c.gl_Position[0] = (c.gl_Position[0] + 1) * Width / 2;
-     c.gl_Position[1] = (c.gl_Position[1] + 1) * Height / 2;
+     v.gl_Position[0] = (v.gl_Position[0] + 1) * Width / 2;
+     v.gl_Position[1] = (v.gl_Position[1] + 1) * Height / 2;
  }
 
 
@@ -6,8 +6,19 @@
  */
 #pragma once
 
+#include <student/commandBuffer.hpp>
+#include <student/framebufferFormat.hpp>
 #include <student/fwd.hpp>
-#include <list>
+#include <student/handleTable.hpp>
+#include <student/threadPool.hpp>
+#include <student/varyings.hpp>
+#include <student/vertexFetch.hpp>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 
@@ -15,28 +26,28 @@
   * @brief This struct represents GPUs buffer.
   */
 struct Buffer {
-    BufferID id;///< buffer id
-    void* data;///< buffer data
+    void* data = nullptr;///< buffer data
+    uint64_t size = 0;///< buffer size in bytes
 };
 
 struct Indexing {
-    BufferID buf;
-    IndexType type;
+    BufferID buf = emptyID;
+    IndexType type = IndexType::UINT32;
     bool enabled = false;
 };
 
 struct HeadSettings {
-    uint64_t offset;
-    uint64_t stride;
-    AttributeType type;
+    uint64_t offset = 0;
+    uint64_t stride = 0;
+    AttributeType type = AttributeType::EMPTY;
     bool enabled = false;
-    BufferID buf;
+    BufferID buf = emptyID;
+    uint32_t divisor = 0;///< number of instances that read the same element, 0 means one element per vertex
 };
 
 struct VertexPullerSettings {
     Indexing indexing;
-    HeadSettings* heads;
-    VertexPullerID id;
+    HeadSettings heads[maxAttributes];
 };
 
 struct Attributes {
@@ -45,16 +56,214 @@ struct Attributes {
 };
 
 struct Program {
-    VertexShader VS;
-    FragmentShader FS;
+    VertexShader VS = nullptr;
+    BatchVertexShader batchVS = nullptr;///< batched vertex shader, used instead of VS when set
+    BatchFragmentShader batchFS = nullptr;///< batched fragment shader, used instead of FS when set
+    FragmentShader FS = nullptr;
     Uniforms un;
-    ProgramID id;
-    AttributeType attributes[maxAttributes];
+    AttributeType attributes[maxAttributes] = {};
+    VaryingLayout varyings;///< packed layout of attributes, rebuilt by setVS2FSType
+};
+
+uint32_t const subPixelBits = 8;///< number of fractional bits of fixed point screen space coordinates
+uint32_t const maxRasterCoordBits = 28;///< fixed point screen space coordinates are clamped to this number of bits
+uint32_t const primitiveChunkSize = 3 * 128;///< number of vertex shader invocations that pass through the pipeline together
+uint32_t const parallelPrimitiveChunkSize = 3 * 8192;///< primitiveChunkSize used with worker threads
+uint32_t const minParallelVertices = 1024;///< minimal number of vertices shaded by one worker thread
+uint32_t const maxVertexCacheSize = 64;///< maximal number of entries of FIFO post-transform vertex cache
+uint32_t const defaultTileSize = 64;///< default size of screen tile (in pixels) for binned rasterization
+uint32_t const maxBinnedTriangles = 4096;///< binned triangles are rasterized when this many are waiting
+uint32_t const hizTileSize = 8;///< size of tile of hierarchical z-buffer in pixels
+float const hizDepthSlack = 1e-4f;///< nearest depth of triangle tested against hierarchical z-buffer is lowered by this value
+uint32_t const maxGuardBand = 1u << (maxRasterCoordBits - subPixelBits - 1);///< maximal guard band in pixels, screen space coordinates inside it fit into fixed point
+uint32_t const nofClipPlanes = 6;///< near, far and four guard band planes
+uint32_t const maxClipPolygonVertices = 3 + nofClipPlanes;///< every clip plane adds at most one vertex to convex polygon
+uint32_t const maxClipNewVertices = 2 * nofClipPlanes;///< every clip plane creates at most two vertices
+uint64_t const emptyVisibility = ~(uint64_t)0;///< value of visibility buffer pixel that is not covered by any triangle
+float const defaultClearDepth = 1.1f;///< depth written by clear, it is farther than any depth inside the view frustum
+uint8_t const pendingClearColor = 1;///< color of tile was cleared, but its pixels were not written yet
+uint8_t const pendingClearDepth = 2;///< depth of tile was cleared, but its pixels were not written yet
+uint8_t const pendingHiZ = 4;///< depth of tile could be written through pointer, its maximum in hierarchical z-buffer is recomputed before use
+
+/**
+ * @brief This enum represents mode of post-transform vertex cache.
+ */
+enum class VertexCacheMode {
+    DISABLED = 0, ///< vertex shader is executed for every index
+    FIFO     = 1, ///< small FIFO of recently transformed vertices (mimics hardware)
+    FULL     = 2, ///< every unique index is transformed once per draw call
+};
+
+/**
+ * @brief This enum represents memory layout of color and depth buffer.
+ */
+enum class FramebufferLayout {
+    LINEAR = 0, ///< pixels are stored row by row, buffers are accessed directly
+    TILED  = 1, ///< tiles of hierarchical z-buffer are stored one after another, pixels inside tile in Morton order
 };
 
-
-
+/**
+ * @brief This enum represents how draw calls produce colors.
+ */
+enum class RenderMode {
+    FORWARD    = 0, ///< fragment shader runs for every fragment that passes depth test
+    VISIBILITY = 1, ///< draw calls write only depth and triangle ids, fragment shader runs once per pixel in resolveVisibilityBuffer
+};
+
+/**
+ * @brief This enum selects which triangles are discarded by face culling.
+ */
+enum class CullMode {
+    NONE  = 0, ///< all triangles are rasterized
+    BACK  = 1, ///< back facing triangles are discarded
+    FRONT = 2, ///< front facing triangles are discarded
+};
 
+/**
+ * @brief This enum selects winding of front facing triangles in normalized device coordinates.
+ */
+enum class FrontFace {
+    CCW = 0, ///< counter-clockwise triangles are front facing
+    CW  = 1, ///< clockwise triangles are front facing
+};
+
+/**
+ * @brief This struct contains GPU statistics counters.
+ */
+struct GPUStats {
+    uint64_t vertexCacheHits = 0;///< indices whose vertex was found in post-transform cache
+    uint64_t vertexCacheMisses = 0;///< indices whose vertex had to be transformed by vertex shader
+    uint64_t culledPrimitives = 0;///< triangles discarded by face culling
+    uint64_t hizRejectedTriangles = 0;///< triangles discarded by hierarchical z-buffer
+    uint64_t hizRejectedTiles = 0;///< tiles of rasterized triangles skipped by hierarchical z-buffer
+    uint64_t fragmentShaderInvocations = 0;///< fragments shaded by fragment shader
+
+    /**
+     * @brief This function returns hit rate of post-transform vertex cache.
+     *
+     * @return ratio of hits to all cache lookups (0 when the cache was not used)
+     */
+    float vertexCacheHitRate() const {
+        uint64_t lookups = vertexCacheHits + vertexCacheMisses;
+        return lookups ? (float)vertexCacheHits / (float)lookups : 0.f;
+    }
+};
+
+/**
+ * @brief This struct represents one entry of FIFO post-transform vertex cache.
+ */
+struct VertexCacheEntry {
+    uint32_t vertexID = emptyID;///< gl_VertexID of cached vertex
+    uint32_t slot = 0;///< index of transformed vertex
+};
+
+/**
+ * @brief This struct contains triangle prepared for rasterization.
+ *
+ * Edge functions are stored for center of pixel (0,0),
+ * so any rectangle of the triangle can be rasterized independently.
+ */
+struct TriangleSetup {
+    int32_t minX = 0;///< bounding box in pixels clamped to the framebuffer
+    int32_t minY = 0;///< bounding box in pixels clamped to the framebuffer
+    int32_t maxX = 0;///< bounding box in pixels clamped to the framebuffer
+    int32_t maxY = 0;///< bounding box in pixels clamped to the framebuffer
+    int64_t edge[3] = {};///< edge functions at center of pixel (0,0) including fill rule bias, edge i is opposite to vertex i
+    int64_t stepX[3] = {};///< change of edge functions for one pixel in x
+    int64_t stepY[3] = {};///< change of edge functions for one pixel in y
+    int64_t bias[3] = {};///< fill rule bias of edge functions
+    int32_t originX = 0;///< pixel where plane equations are anchored
+    int32_t originY = 0;///< pixel where plane equations are anchored
+    float invW[3] = {};///< plane equation of 1/w (value at origin, change in x, change in y)
+    float z[3] = {};///< plane equation of z/w
+    float minZ = 0.f;///< nearest depth of the triangle
+    float const* planes = nullptr;///< plane equations of attr/w, value at origin, change in x and change in y of every packed float
+    uint64_t visibilityID = emptyVisibility;///< draw id (upper 32 bits) and primitive id (lower 32 bits) written into visibility buffer
+};
+
+/**
+ * @brief This struct contains counters of one rasterization job.
+ */
+struct RasterStats {
+    uint64_t hizRejectedTiles = 0;///< tiles skipped by hierarchical z-buffer
+    uint64_t shadedFragments = 0;///< fragments passed to fragment shader
+};
+
+/**
+ * @brief This struct contains state of draw call recorded into visibility buffer.
+ *
+ * Uniforms and attribute layout are copied, so the program can be changed before the resolve.
+ */
+struct VisibilityDraw {
+    FragmentShader FS = nullptr;///< fragment shader
+    BatchFragmentShader batchFS = nullptr;///< batched fragment shader, nullptr if FS is used
+    Uniforms uniforms;///< uniform variables at the time of the draw call
+    VaryingLayout varyings;///< packed layout of vertex to fragment attributes
+    size_t firstTriangle = 0;///< first triangle of the draw call in visibilityTriangles
+    size_t firstPlane = 0;///< first float of attribute plane equations of the draw call in visibilityPlanes
+};
+
+/**
+ * @brief This struct represents pixels of hierarchical z-buffer tile covered since the last update of its maximum.
+ */
+struct HiZLayer {
+    uint64_t coverage = 0;///< covered pixels, bit y * hizTileSize + x
+    float maxZ = -INFINITY;///< maximal depth of covered fragments, covered pixels have depth at most this value
+};
+
+class GPU;
+struct DrawContext;
+
+/**
+ * @brief Function type that rasterizes part of triangle, it is specialised for depth and color format
+ */
+using RasterFunction = RasterStats (GPU::*)(
+    DrawContext   const& ctx ,
+    TriangleSetup const& t   ,
+    int32_t              minX,
+    int32_t              minY,
+    int32_t              maxX,
+    int32_t              maxY);
+
+/**
+ * @brief This struct contains draw state resolved once per draw call.
+ *
+ * Pointers stay valid until the end of the draw call, so the pipeline
+ * does no object lookups per vertex or per fragment.
+ */
+struct DrawContext {
+    ResolvedHead heads[maxAttributes];///< enabled heads with valid buffers
+    uint32_t nofHeads = 0;///< number of resolved heads
+    uint8_t const* indices = nullptr;///< index buffer data, nullptr if indexing is disabled
+    VertexIDFetcher fetchVertexIDs = nullptr;///< gl_VertexID fetch function for index type
+    VertexIDArrayFetcher fetchVertexIDArray = nullptr;///< gl_VertexID fetch function for index type that writes plain array
+    VertexShader VS = nullptr;///< vertex shader
+    BatchVertexShader batchVS = nullptr;///< batched vertex shader, nullptr if VS is used
+    FragmentShader FS = nullptr;///< fragment shader
+    BatchFragmentShader batchFS = nullptr;///< batched fragment shader, nullptr if FS is used
+    Uniforms const* uniforms = nullptr;///< uniform variables of program
+    VaryingLayout const* varyings = nullptr;///< packed layout of vertex to fragment attributes
+    uint32_t vertexSize = 4;///< number of floats of one packed vertex
+    float guardBandX = 1.f;///< guard band in normalized device coordinates, x in <-guardBandX, guardBandX> is not clipped
+    float guardBandY = 1.f;///< guard band in normalized device coordinates, y in <-guardBandY, guardBandY> is not clipped
+    int32_t baseVertex = 0;///< base vertex of current draw
+    uint32_t instanceID = 0;///< gl_InstanceID of vertices that are transformed
+    bool visibility = false;///< rasterization writes visibility buffer instead of running fragment shader
+    RasterFunction rasterize = nullptr;///< rasterization function for depth and color format of framebuffer
+};
+
+
+
+
+
+/**
+ * @brief This struct represents point in the queue of submitted command buffers.
+ *
+ * Fence is signaled when the command buffer it was returned for and all previously submitted ones are executed.
+ */
+struct Fence {
+    uint64_t value = 0;///< number of command buffers that have to be executed
+};
 
 /**
  * @brief This class represent software GPU
@@ -78,6 +287,7 @@ class GPU{
     void      setVertexPullerIndexing(VertexPullerID vao,IndexType type,BufferID buffer);
     void      enableVertexPullerHead (VertexPullerID vao,uint32_t head);
     void      disableVertexPullerHead(VertexPullerID vao,uint32_t head);
+    void      setVertexPullerHeadDivisor(VertexPullerID vao,uint32_t head,uint32_t divisor);
     void      bindVertexPuller       (VertexPullerID vao);
     void      unbindVertexPuller     ();
     bool      isVertexPuller         (VertexPullerID vao);
@@ -86,6 +296,9 @@ class GPU{
     ProgramID createProgram          ();
     void      deleteProgram          (ProgramID prg);
     void      attachShaders          (ProgramID prg,VertexShader vs,FragmentShader fs);
+    void      attachShaders          (ProgramID prg,BatchVertexShader vs,FragmentShader fs);
+    void      attachShaders          (ProgramID prg,VertexShader vs,BatchFragmentShader fs);
+    void      attachShaders          (ProgramID prg,BatchVertexShader vs,BatchFragmentShader fs);
     void      setVS2FSType           (ProgramID prg,uint32_t attrib,AttributeType type);
     void      useProgram             (ProgramID prg);
     bool      isProgram              (ProgramID prg);
@@ -96,9 +309,10 @@ class GPU{
     void      programUniformMatrix4f (ProgramID prg,uint32_t uniformId,glm::mat4 const&d);
 
     //framebuffer functions
-    void      createFramebuffer      (uint32_t width,uint32_t height);
+    void      createFramebuffer      (uint32_t width,uint32_t height,ColorFormat colorFormat = ColorFormat::RGBA8,DepthFormat depthFormat = DepthFormat::D32F);
     void      deleteFramebuffer      ();
     void      resizeFramebuffer      (uint32_t width,uint32_t height);
+    void      setColorBufferMemory   (uint8_t*pixels,uint32_t pitch,bool flipY,bool preserveContent = true);
     uint8_t*  getFramebufferColor    ();
     float*    getFramebufferDepth    ();
     uint32_t  getFramebufferWidth    ();
@@ -106,34 +320,155 @@ class GPU{
 
     //execution commands
     void      clear                  (float r,float g,float b,float a);
+    void      clearColor             (float r,float g,float b,float a);
+    void      clearDepth             (float depth = defaultClearDepth);
     void      drawTriangles          (uint32_t  nofVertices);
+    void      drawTriangles          (uint32_t  nofVertices,uint32_t firstIndex,int32_t baseVertex);
+    void      drawTrianglesInstanced (uint32_t  nofVertices,uint32_t nofInstances);
+    void      multiDrawTriangles     (DrawIndirectCommand const* draws,uint32_t nofDraws);
+    void      drawTrianglesIndirect  (BufferID buffer,uint64_t offset,uint32_t nofDraws);
+    void      resolveVisibilityBuffer();
+    void      finish                 ();
+
+    //command buffer execution
+    void      execute                (CommandBuffer const& commandBuffer);
+    Fence     submit                 (CommandBuffer const& commandBuffer);
+    void      waitFence              (Fence const& fence);
+    bool      isFenceSignaled        (Fence const& fence);
+    void      waitIdle               ();
+
+    //pipeline settings and statistics
+    void      setVertexCacheMode     (VertexCacheMode mode,uint32_t fifoSize = 32);
+    void      setRenderMode          (RenderMode mode);
+    void      setFramebufferLayout   (FramebufferLayout layout);
+    void      setCullMode            (CullMode mode);
+    void      setFrontFace           (FrontFace face);
+    void      setThreadCount         (uint32_t nofThreads);
+    void      setTileSize            (uint32_t size);
+    void      setGuardBand           (uint32_t pixels);
+    GPUStats const& getStats         ();
+    void      resetStats             ();
 
     //user functions 
-    void      trianglesClipping      (OutVertex& a, OutVertex& b, OutVertex& c);
-    OutVertex Interpolation          (OutVertex& a, OutVertex& b, float f);
-    void      Drawing                (OutVertex& a, OutVertex& b, OutVertex& c);
-    void      putPixel               (InFragment inFragment);
-    void      swapVertex             (OutVertex& a, OutVertex& b);
-    void      swapFloat              (float& a, float& b);
-    void      postProcesses          (OutVertex& a, OutVertex& b, OutVertex& c);
-    void      Line                   (OutVertex a, OutVertex b, glm::vec2* Lines, OutVertex& v0, OutVertex& v1, OutVertex& v2);
-    float     getTraingleTop         (OutVertex& a, OutVertex& b, OutVertex& c);
-    float     getTraingleBottom      (OutVertex& a, OutVertex& b, OutVertex& c);
+    bool      resolveDrawContext     (DrawContext& ctx);
+    void      beginDraw              (DrawContext& ctx, int32_t baseVertex);
+    void      beginInstance          (DrawContext& ctx, uint32_t instance);
+    void      assignVertexSlots      (DrawContext const& ctx, uint32_t firstVertex, uint32_t nofVertices, bool firstChunk);
+    void      shadeVertices          (DrawContext const& ctx, uint32_t firstVertex, uint32_t nofVertices);
+    void      assembleTriangles      (DrawContext const& ctx, uint32_t nofVertices);
+    uint32_t  lookupVertexCache      (uint32_t vertexID, uint32_t newSlot);
+    bool      isCulled               (float const* a, float const* b, float const* c) const;
+    void      trianglesClipping      (DrawContext const& ctx, ClipVertex& a, ClipVertex& b, ClipVertex& c);
+    void      Drawing                (DrawContext const& ctx, ClipVertex& a, ClipVertex& b, ClipVertex& c);
+    bool      setupTriangle          (DrawContext const& ctx, ClipVertex const& a, ClipVertex const& b, ClipVertex const& c, TriangleSetup& t, float* planes);
+    template<DepthFormat FORMAT, ColorFormat COLOR>
+    RasterStats rasterizeTriangle    (DrawContext const& ctx, TriangleSetup const& t, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY);
+    void      recordTriangle         (DrawContext const& ctx, TriangleSetup& t);
+    template<DepthFormat FORMAT, ColorFormat COLOR>
+    uint64_t  resolveRows            (uint32_t minY, uint32_t maxY);
+    void      updateHiZ              (uint32_t tile, uint64_t coverage, float maxZ);
+    void      rebuildHiZ             ();
+    void      rebuildHiZTile         (uint32_t tile);
+    void      invalidateHiZTile      (uint32_t tile);
+    void      prepareBins            (DrawContext const& ctx);
+    void      binTriangle            (DrawContext const& ctx, TriangleSetup const& t);
+    void      flushBins              (DrawContext const& ctx);
+    template<DepthFormat FORMAT, ColorFormat COLOR>
+    void      shadeFragments         (DrawContext const& ctx, InFragmentBatch& batch, uint32_t const* pixels, uint32_t count);
+    template<DepthFormat FORMAT, ColorFormat COLOR>
+    void      putPixel               (uint32_t pixel, float z, glm::vec4 const& color);
+    void      viewportTransform      (ClipVertex& v);
+    size_t    framebufferPixels      () const;
+    bool      rowByRow               () const;
+    void      updatePixelOffsets     ();
+    void      relocateFramebuffer    (FramebufferLayout layout, uint8_t* memory, uint32_t pitch, bool flipY);
+    void      acquireFramebuffer     ();
+    void      initializeTile         (uint32_t tile);
+    void      fillTiles              (uint32_t tileY, uint32_t firstTileX, uint32_t endTileX, uint8_t clears, bool streaming);
+    void      resolveClears          (uint8_t clears);
+    void      renderThreadLoop       ();
+    void      waitForSubmitted       ();
 
     /// \addtogroup gpu_init 00. proměnné, inicializace / deinicializace grafické karty
     /// @{
 
-    std::list<Buffer> BufferList;
-    std::list<VertexPullerSettings> VertexPullerList;
+    HandleTable<Buffer> BufferTable;
+    HandleTable<VertexPullerSettings> VertexPullerTable;
     VertexPullerID bindedVPid = emptyID;
     ProgramID ActiveProgramID = emptyID;
-    std::list<Program> ProgramList;
+    HandleTable<Program> ProgramTable;
     
     uint32_t Width = 0;
     uint32_t Height = 0;
 
     uint8_t* colorBuf = nullptr;
-    float* depthBuf = nullptr;
+    uint8_t* depthBuf = nullptr;
+    ColorFormat colorFormat = ColorFormat::RGBA8;///< format of colorBuf pixels
+    DepthFormat depthFormat = DepthFormat::D32F;///< format of depthBuf pixels
+
+    FramebufferLayout framebufferLayout = FramebufferLayout::LINEAR;///< memory layout of colorBuf and depthBuf
+    bool externalColor = false;///< colorBuf is memory of the caller bound by setColorBufferMemory
+    uint32_t rowPitch = 0;///< number of pixels between starts of rows of linear framebuffer
+    bool flipRows = false;///< rows of linear framebuffer are stored from the top row to the bottom row
+    std::vector<uint32_t> pixelRowOffsets;///< offset of row y in framebuffer, pixel (x, y) is at pixelRowOffsets[y] + pixelColumnOffsets[x]
+    std::vector<uint32_t> pixelColumnOffsets;///< offset of column x in framebuffer
+    std::vector<uint8_t> colorView;///< row by row RGBA8 copy of color buffer returned by getFramebufferColor, used for tiled layout or other format
+    std::vector<float> depthView;///< row by row float copy of depth buffer returned by getFramebufferDepth, used for tiled layout or other format
+    bool colorViewOut = false;///< colorView could be written, it is copied back before the framebuffer is used
+    bool depthViewOut = false;///< depthView could be written, it is copied back before the framebuffer is used
+
+    uint8_t clearColorValue[8] = {};///< color of the last color clear in color format
+    float clearDepthValue = defaultClearDepth;///< depth of the last depth clear
+    std::vector<uint8_t> pendingClears;///< clears (pendingClearColor, pendingClearDepth) not yet written into pixels and pendingHiZ of every tile of hierarchical z-buffer
+    bool clearsPending = false;///< some tile has pending clear or pendingHiZ
+
+    std::vector<float> vertexScratch;///< packed transformed vertices of current chunk (reused between chunks and draws)
+    std::vector<uint32_t> vertexSlots;///< index into vertexScratch for every vertex shader invocation of current chunk
+    std::vector<uint32_t> vertexMisses;///< gl_VertexID of vertices of current chunk that were not found in vertex cache
+
+    CullMode cullMode = CullMode::NONE;///< which triangles are discarded by face culling
+    FrontFace frontFace = FrontFace::CCW;///< winding of front facing triangles
+
+    VertexCacheMode vertexCacheMode = VertexCacheMode::DISABLED;///< mode of post-transform vertex cache
+    uint32_t vertexCacheFifoSize = 32;///< number of entries of FIFO cache
+    uint32_t vertexCacheFifoNext = 0;///< FIFO entry that is replaced next
+    VertexCacheEntry vertexCacheFifo[maxVertexCacheSize];///< FIFO cache entries
+    uint32_t vertexCacheStamp = 0;///< id of current draw call for FULL cache
+    std::vector<uint32_t> vertexCacheStamps;///< draw call id that filled vertexCacheSlots[gl_VertexID]
+    std::vector<uint32_t> vertexCacheSlots;///< transformed vertex for gl_VertexID (FULL cache)
+
+    std::unique_ptr<ThreadPool> threadPool;///< worker threads, nullptr for single threaded rendering
+    uint32_t tileSize = defaultTileSize;///< size of screen tile for binned rasterization
+    std::vector<float> hizBuf;///< hierarchical z-buffer, maximal depth of every tile
+    std::vector<HiZLayer> hizLayers;///< pixels of every tile covered since the last update of its maximum
+    bool hizValid = false;///< false if whole hierarchical z-buffer is rebuilt before the next draw, single tiles are marked by pendingHiZ
+    uint32_t hizTilesX = 0;///< number of tiles of hierarchical z-buffer in x
+    uint32_t hizTilesY = 0;///< number of tiles of hierarchical z-buffer in y
+
+    uint32_t guardBand = maxGuardBand;///< number of pixels around the framebuffer where triangles are rasterized without clipping
+    uint32_t tilesX = 0;///< number of tiles in x
+    uint32_t tilesY = 0;///< number of tiles in y
+    std::vector<TriangleSetup> binnedTriangles;///< triangles waiting for binned rasterization
+    std::vector<float> binnedPlanes;///< attribute plane equations of binned triangles
+    std::vector<std::vector<uint32_t>> tileBins;///< indices into binnedTriangles for every tile, in primitive order
+    std::vector<uint32_t> activeTiles;///< tiles with non empty bin
+
+    RenderMode renderMode = RenderMode::FORWARD;///< how draw calls produce colors
+    std::vector<uint64_t> visibilityBuf;///< draw and primitive id of the nearest triangle of every pixel, emptyVisibility if not covered
+    std::vector<VisibilityDraw> visibilityDraws;///< draw calls recorded since the last resolve
+    std::vector<TriangleSetup> visibilityTriangles;///< triangles of recorded draw calls
+    std::vector<float> visibilityPlanes;///< attribute plane equations of recorded triangles
+
+    std::thread renderThread;///< executes submitted command buffers, it is started by the first submit
+    std::mutex submitMutex;///< guards submittedBuffers, submittedFences, completedFences and stopRenderThread
+    std::condition_variable buffersSubmitted;///< render thread waits for submitted command buffers
+    std::condition_variable buffersCompleted;///< waitFence waits for executed command buffers
+    std::deque<CommandBuffer> submittedBuffers;///< command buffers that are not executed yet, in order of submission
+    uint64_t submittedFences = 0;///< number of submitted command buffers
+    uint64_t completedFences = 0;///< number of executed command buffers
+    bool stopRenderThread = false;///< render thread should exit
+
+    GPUStats stats;///< statistics counters
     /// \todo zde si můžete vytvořit proměnné grafické karty (buffery, programy, ...)
     /// @}
 };
@@ -0,0 +1,141 @@
+/*!
+ * @file
+ * @brief This file contains generational handle table (slot map) for GPU objects.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <student/fwd.hpp>
+
+/**
+ * @brief This class represents table of objects addressed by generational handles.
+ *
+ * Handle (ObjectID) is composed of slot index (lower 32 bits) and slot generation (upper 32 bits).
+ * Lookup is O(1), freed slots are reused and their generation is incremented,
+ * so handles of deleted objects are rejected even after the slot is occupied again.
+ * Generation 0 is never used, so \link emptyID \endlink and small integers are never valid handles.
+ *
+ * @tparam T type of stored object
+ */
+template<typename T>
+class HandleTable{
+  public:
+    /**
+     * @brief This function inserts new object into the table.
+     *
+     * @param value object
+     *
+     * @return handle of the new object
+     */
+    ObjectID insert(T const&value){
+      uint32_t index;
+      if(!freeSlots.empty()){
+        index = freeSlots.back();
+        freeSlots.pop_back();
+      }else{
+        index = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+      }
+      auto&slot = slots[index];
+      slot.value = value;
+      slot.alive = true;
+      return makeID(index,slot.generation);
+    }
+
+    /**
+     * @brief This function removes object from the table.
+     *
+     * @param id handle of the object
+     *
+     * @return true if the handle was valid
+     */
+    bool erase(ObjectID id){
+      auto slot = getSlot(id);
+      if(!slot)return false;
+      slot->value = T();
+      slot->alive = false;
+      if(++slot->generation == 0)slot->generation = 1;
+      freeSlots.push_back(getIndex(id));
+      return true;
+    }
+
+    /**
+     * @brief This function returns object for handle.
+     *
+     * @param id handle of the object
+     *
+     * @return pointer to object or nullptr, if the handle is not valid
+     */
+    T*get(ObjectID id){
+      auto slot = getSlot(id);
+      if(!slot)return nullptr;
+      return &slot->value;
+    }
+
+    /**
+     * @brief This function returns object for handle.
+     *
+     * @param id handle of the object
+     *
+     * @return pointer to object or nullptr, if the handle is not valid
+     */
+    T const*get(ObjectID id)const{
+      return const_cast<HandleTable*>(this)->get(id);
+    }
+
+    /**
+     * @brief This function tests if handle points to existing object.
+     *
+     * @param id handle
+     *
+     * @return true if the object exists
+     */
+    bool contains(ObjectID id)const{
+      return get(id) != nullptr;
+    }
+
+    /**
+     * @brief This function calls function for every live object.
+     *
+     * @tparam FCE type of function
+     * @param fce function that receives reference to the object
+     */
+    template<typename FCE>
+    void forEach(FCE const&fce){
+      for(auto&slot:slots)
+        if(slot.alive)fce(slot.value);
+    }
+
+  private:
+    /**
+     * @brief This struct represents one slot of the table.
+     */
+    struct Slot{
+      T        value          ;///< stored object
+      uint32_t generation = 1 ;///< generation of the slot
+      bool     alive      = false;///< is slot occupied
+    };
+
+    static ObjectID makeID(uint32_t index,uint32_t generation){
+      return (static_cast<ObjectID>(generation)<<32) | static_cast<ObjectID>(index);
+    }
+    static uint32_t getIndex     (ObjectID id){return static_cast<uint32_t>(id      );}
+    static uint32_t getGeneration(ObjectID id){return static_cast<uint32_t>(id >> 32);}
+
+    Slot*getSlot(ObjectID id){
+      auto const index = getIndex(id);
+      if(index >= slots.size())return nullptr;
+      auto&slot = slots[index];
+      if(!slot.alive || slot.generation != getGeneration(id))return nullptr;
+      return &slot;
+    }
+
+    std::vector<Slot    >slots    ;///< slots with objects
+    std::vector<uint32_t>freeSlots;///< indices of free slots
+};
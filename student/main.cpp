@@ -47,6 +47,8 @@ int main(int argc,char*argv[]){
     app.registerMethod<CZFlagMethod>        ("czech flag"                                       );
     app.registerMethod<PhongMethod         >("phong bunny"                                      );
     app.setMethod(args.method);
+    app.setThreadCount(args.nofThreads);
+    app.setSwapChainLength(args.swapChainLength);
     app.start();
 
   }catch(std::exception&e){
@@ -42,5 +42,6 @@ class Method{
      */
     virtual void onUpdate(float dt){}
     GPU gpu; ///< graphic card
+    Fence frame; ///< fence of command buffer submitted by the last onDraw, methods that draw by direct calls leave it signaled
 };
 
@@ -0,0 +1,134 @@
+/*!
+ * @file
+ * @brief This file contains implementation of swap chain.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <algorithm>
+
+#include <student/gpu.hpp>
+#include <student/swapChain.hpp>
+
+/**
+ * @brief Constructor of swap chain, it starts presenter thread
+ *
+ * @param nofImages number of images (at least 1)
+ * @param presentFunction function that is called by presenter thread for every presented image
+ */
+SwapChain::SwapChain(uint32_t nofImages,PresentFunction const&presentFunction):
+  images(std::max(nofImages,1u)),presentFunction(presentFunction){
+  for(uint32_t i=0;i<getNofImages();++i)
+    freeImages.push_back(i);
+  presenterThread = std::thread(&SwapChain::presenter,this);
+}
+
+/**
+ * @brief Destructor of swap chain, all queued images are presented before it returns
+ */
+SwapChain::~SwapChain(){
+  {
+    std::lock_guard<std::mutex>lock(mutex);
+    stop = true;
+  }
+  imageQueued.notify_all();
+  presenterThread.join();
+}
+
+/**
+ * @brief This function binds free image as color buffer of the GPU.
+ *
+ * It waits only if there is no free image. Image that is already acquired is bound again,
+ * so it is called again after the framebuffer of the GPU is created or resized.
+ * Color buffer of the GPU has to be RGBA8, content of the image is undefined until it is cleared.
+ *
+ * @param gpu gpu that renders into the image
+ */
+void SwapChain::acquire(GPU&gpu){
+  acquireImage(gpu,false);
+}
+
+/**
+ * @brief This function queues acquired image with finished frame for presentation and acquires next image.
+ *
+ * Frame is rendered into image acquired by acquire or previous present,
+ * otherwise it is copied into acquired image once.
+ *
+ * @param gpu gpu with rendered frame
+ */
+void SwapChain::present(GPU&gpu){
+  if(acquired == noImage)acquireImage(gpu,true);
+
+  // pixels of the image are complete, GPU does not write them until the image is acquired again
+  gpu.finish();
+  {
+    std::lock_guard<std::mutex>lock(mutex);
+    queued.push_back(acquired);
+  }
+  acquired = noImage;
+  imageQueued.notify_one();
+
+  acquireImage(gpu,false);
+}
+
+/**
+ * @brief This function binds acquired image or free image as color buffer of the GPU.
+ *
+ * @param gpu gpu that renders into the image
+ * @param preserveContent content of color buffer of the GPU is copied into the image
+ */
+void SwapChain::acquireImage(GPU&gpu,bool preserveContent){
+  if(acquired == noImage){
+    std::unique_lock<std::mutex>lock(mutex);
+    imagePresented.wait(lock,[&]{return !freeImages.empty();});
+    acquired = freeImages.front();
+    freeImages.pop_front();
+  }
+
+  // only this thread owns the image now
+  auto&image   = images[acquired];
+  image.width  = gpu.getFramebufferWidth ();
+  image.height = gpu.getFramebufferHeight();
+  image.color.resize((size_t)image.width*image.height*4);
+  gpu.setColorBufferMemory(image.color.data(),image.width*4,false,preserveContent);
+}
+
+/**
+ * @brief This function waits until all queued images are presented.
+ */
+void SwapChain::finish(){
+  std::unique_lock<std::mutex>lock(mutex);
+  imagePresented.wait(lock,[&]{return freeImages.size() + (acquired != noImage) == images.size();});
+}
+
+/**
+ * @brief This function returns number of frames that were presented.
+ *
+ * @return number of presented frames
+ */
+uint64_t SwapChain::getPresentedFrames(){
+  std::lock_guard<std::mutex>lock(mutex);
+  return presentedFrames;
+}
+
+/**
+ * @brief This function is run by presenter thread, it presents queued images in order.
+ */
+void SwapChain::presenter(){
+  std::unique_lock<std::mutex>lock(mutex);
+  for(;;){
+    imageQueued.wait(lock,[&]{return stop || !queued.empty();});
+    if(queued.empty())return;
+    uint32_t const id = queued.front();
+    queued.pop_front();
+
+    lock.unlock();
+    auto const&image = images[id];
+    if(presentFunction)presentFunction(image.color.data(),image.width,image.height);
+    lock.lock();
+
+    freeImages.push_back(id);
+    presentedFrames++;
+    imagePresented.notify_all();
+  }
+}
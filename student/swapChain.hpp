@@ -0,0 +1,79 @@
+/*!
+ * @file
+ * @brief This file contains swap chain that presents rendered frames asynchronously.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class GPU;
+
+/**
+ * @brief This class represents chain of images that are presented by presenter thread.
+ *
+ * Images are color buffers of the GPU: acquire binds free image as color buffer,
+ * present queues the image with finished frame and binds the next free one,
+ * so next frame is rendered while previous frames are presented, without copies.
+ * It blocks only when all images wait for presentation.
+ * Presentation is done by user function, so swap chain can be used without window.
+ */
+class SwapChain{
+  public:
+    /**
+     * @brief Type of function that presents one image (RGBA8, rows from bottom to top)
+     */
+    using PresentFunction = std::function<void(uint8_t const*color,uint32_t width,uint32_t height)>;
+
+    SwapChain(uint32_t nofImages,PresentFunction const&presentFunction);
+    ~SwapChain();
+    SwapChain(SwapChain const&)            = delete;
+    SwapChain&operator=(SwapChain const&) = delete;
+
+    void     acquire           (GPU&gpu);
+    void     present           (GPU&gpu);
+    void     finish            ();
+    uint64_t getPresentedFrames();
+
+    /**
+     * @brief This function returns number of images of swap chain.
+     *
+     * @return number of images
+     */
+    uint32_t getNofImages()const{return static_cast<uint32_t>(images.size());}
+
+  private:
+    /**
+     * @brief This struct represents one image of swap chain.
+     */
+    struct Image{
+      std::vector<uint8_t>color ;///< RGBA8 pixels
+      uint32_t            width  = 0;///< width of image
+      uint32_t            height = 0;///< height of image
+    };
+
+    static uint32_t const noImage = ~0u;///< no image is acquired
+
+    void acquireImage(GPU&gpu,bool preserveContent);
+    void presenter   ();
+
+    std::vector<Image>      images                 ;///< images of swap chain
+    PresentFunction         presentFunction        ;///< function that presents image
+    std::mutex              mutex                  ;///< guards queued, freeImages, presentedFrames and stop
+    std::condition_variable imageQueued            ;///< presenter waits for queued image
+    std::condition_variable imagePresented         ;///< acquire and finish wait for presented image
+    std::deque<uint32_t>    queued                 ;///< images waiting for presentation in order of present
+    std::deque<uint32_t>    freeImages             ;///< images that can be acquired, the longest free one first
+    uint32_t                acquired        = noImage;///< image that is color buffer of the GPU
+    uint64_t                presentedFrames = 0    ;///< number of presented frames
+    bool                    stop            = false;///< presenter should exit
+    std::thread             presenterThread        ;///< thread that calls presentFunction
+};
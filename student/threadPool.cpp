@@ -0,0 +1,93 @@
+/*!
+ * @file
+ * @brief This file contains implementation of pool of worker threads.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <student/threadPool.hpp>
+
+/**
+ * @brief Constructor of thread pool
+ *
+ * @param nofThreads number of threads including calling thread (at least 1)
+ */
+ThreadPool::ThreadPool(uint32_t nofThreads){
+  for(uint32_t t=1;t<nofThreads;++t)
+    workers.emplace_back(&ThreadPool::work,this,t);
+}
+
+/**
+ * @brief Destructor of thread pool, it joins all workers
+ */
+ThreadPool::~ThreadPool(){
+  {
+    std::lock_guard<std::mutex>lock(mutex);
+    stop = true;
+  }
+  wakeUp.notify_all();
+  for(auto&worker:workers)worker.join();
+}
+
+/**
+ * @brief This function executes all jobs and waits for them.
+ *
+ * @param n number of jobs
+ * @param fce job function
+ * @param data data of job function
+ */
+void ThreadPool::run(uint32_t n,JobFunction fce,void const*data){
+  if(n == 0)return;
+  if(workers.empty() || n == 1){
+    for(uint32_t j=0;j<n;++j)fce(data,j,0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex>lock(mutex);
+    jobFunction = fce;
+    jobData     = data;
+    nofJobs     = n;
+    nextJob     = 0;
+    busy        = static_cast<uint32_t>(workers.size());
+    generation++;
+  }
+  wakeUp.notify_all();
+  runJobs(0);
+  std::unique_lock<std::mutex>lock(mutex);
+  finished.wait(lock,[&]{return busy == 0;});
+}
+
+/**
+ * @brief This function takes jobs until there are none left.
+ *
+ * @param thread id of thread
+ */
+void ThreadPool::runJobs(uint32_t thread){
+  for(;;){
+    uint32_t const job = nextJob.fetch_add(1,std::memory_order_relaxed);
+    if(job >= nofJobs)return;
+    jobFunction(jobData,job,thread);
+  }
+}
+
+/**
+ * @brief Main loop of worker thread
+ *
+ * @param thread id of thread
+ */
+void ThreadPool::work(uint32_t thread){
+  uint64_t done = 0;
+  for(;;){
+    {
+      std::unique_lock<std::mutex>lock(mutex);
+      wakeUp.wait(lock,[&]{return stop || generation != done;});
+      if(stop)return;
+      done = generation;
+    }
+    runJobs(thread);
+    {
+      std::lock_guard<std::mutex>lock(mutex);
+      if(--busy == 0)finished.notify_one();
+    }
+  }
+}
@@ -0,0 +1,72 @@
+/*!
+ * @file
+ * @brief This file contains pool of worker threads used by GPU pipeline.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief This class represents fixed pool of worker threads.
+ *
+ * Calling thread takes part in every parallelFor, so pool with n threads
+ * creates only n-1 workers and pool with one thread runs everything serially.
+ * Jobs are not allocated, parallelFor only references the function for its duration.
+ */
+class ThreadPool{
+  public:
+    explicit ThreadPool(uint32_t nofThreads);
+    ~ThreadPool();
+    ThreadPool(ThreadPool const&)            = delete;
+    ThreadPool&operator=(ThreadPool const&) = delete;
+
+    /**
+     * @brief This function returns number of threads including calling thread.
+     *
+     * @return number of threads
+     */
+    uint32_t getNofThreads()const{return static_cast<uint32_t>(workers.size())+1;}
+
+    /**
+     * @brief This function calls function for every job, jobs are distributed among threads.
+     *
+     * Function returns after all jobs are finished.
+     *
+     * @tparam FCE type of function
+     * @param nofJobs number of jobs
+     * @param fce function that receives job id and thread id (0 - getNofThreads()-1)
+     */
+    template<typename FCE>
+    void parallelFor(uint32_t nofJobs,FCE const&fce){
+      run(nofJobs,[](void const*data,uint32_t job,uint32_t thread){
+        (*static_cast<FCE const*>(data))(job,thread);
+      },&fce);
+    }
+
+  private:
+    using JobFunction = void(*)(void const*data,uint32_t job,uint32_t thread);
+
+    void run    (uint32_t nofJobs,JobFunction fce,void const*data);
+    void work   (uint32_t thread);
+    void runJobs(uint32_t thread);
+
+    std::vector<std::thread> workers                ;///< worker threads
+    std::mutex               mutex                  ;///< guards generation, stop and busy
+    std::condition_variable  wakeUp                 ;///< workers wait for new generation
+    std::condition_variable  finished               ;///< calling thread waits for workers
+    uint64_t                 generation  = 0        ;///< incremented for every parallelFor
+    uint32_t                 busy        = 0        ;///< number of workers working on current generation
+    bool                     stop        = false    ;///< workers should exit
+    JobFunction              jobFunction = nullptr  ;///< function of current generation
+    void const*              jobData     = nullptr  ;///< data of current generation
+    uint32_t                 nofJobs     = 0        ;///< number of jobs of current generation
+    std::atomic<uint32_t>    nextJob     {0}        ;///< next job that is not taken
+};
@@ -0,0 +1,88 @@
+/*!
+ * @file
+ * @brief This file contains implementation of compact vertex to fragment attributes.
+ *
+ * Vertices are packed right after vertex shader, so clipping, interpolation and
+ * fragment assembly touch only floats of attributes that the program declared.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <cstring>
+
+#include <student/varyings.hpp>
+
+/**
+ * @brief This function builds packed layout from attribute types of program.
+ *
+ * @param layout layout that is filled
+ * @param attributes types of vertex to fragment attributes (maxAttributes items)
+ */
+void buildVaryingLayout(VaryingLayout&layout,AttributeType const*attributes){
+  layout = VaryingLayout();
+  for(uint32_t i=0;i<maxAttributes;++i){
+    auto const size = static_cast<uint32_t>(attributes[i]);
+    if(!size)continue;
+    layout.attrib[layout.nofVaryings] = i;
+    layout.offset[layout.nofVaryings] = layout.nofFloats;
+    layout.size  [layout.nofVaryings] = size;
+    layout.nofVaryings++;
+    layout.nofFloats += size;
+  }
+}
+
+/**
+ * @brief This function packs output of vertex shader.
+ *
+ * @param dst packed vertex (packedVertexSize floats)
+ * @param vertex output vertex of vertex shader
+ * @param layout layout of attributes
+ */
+void packVertex(float*dst,OutVertex const&vertex,VaryingLayout const&layout){
+  std::memcpy(dst,&vertex.gl_Position,sizeof(float)*4);
+  for(uint32_t i=0;i<layout.nofVaryings;++i)
+    std::memcpy(dst+4+layout.offset[i],&vertex.attributes[layout.attrib[i]],sizeof(float)*layout.size[i]);
+}
+
+/**
+ * @brief This function packs one vertex of output of batched vertex shader.
+ *
+ * @param dst packed vertex (packedVertexSize floats)
+ * @param batch output vertices of batched vertex shader
+ * @param lane vertex of the batch
+ * @param layout layout of attributes
+ */
+void packVertexBatch(float*dst,OutVertexBatch const&batch,uint32_t lane,VaryingLayout const&layout){
+  for(uint32_t c=0;c<4;++c)
+    dst[c] = batch.gl_Position[c][lane];
+  for(uint32_t i=0;i<layout.nofVaryings;++i)
+    for(uint32_t c=0;c<layout.size[i];++c)
+      dst[4+layout.offset[i]+c] = batch.attributes[layout.attrib[i]][c][lane];
+}
+
+/**
+ * @brief This function loads packed vertex.
+ *
+ * @param vertex vertex that is filled
+ * @param src packed vertex (packedVertexSize floats)
+ * @param layout layout of attributes
+ */
+void unpackVertex(ClipVertex&vertex,float const*src,VaryingLayout const&layout){
+  std::memcpy(&vertex.gl_Position,src  ,sizeof(float)*4               );
+  std::memcpy(vertex.varyings     ,src+4,sizeof(float)*layout.nofFloats);
+}
+
+/**
+ * @brief This function linearly interpolates position and attributes of two vertices.
+ *
+ * @param out result vertex
+ * @param a first vertex
+ * @param b second vertex
+ * @param t interpolation parameter (0 gives a, 1 gives b)
+ * @param layout layout of attributes
+ */
+void lerpVertex(ClipVertex&out,ClipVertex const&a,ClipVertex const&b,float t,VaryingLayout const&layout){
+  out.gl_Position = a.gl_Position + t*(b.gl_Position-a.gl_Position);
+  for(uint32_t f=0;f<layout.nofFloats;++f)
+    out.varyings[f] = a.varyings[f] + t*(b.varyings[f]-a.varyings[f]);
+}
@@ -0,0 +1,52 @@
+/*!
+ * @file
+ * @brief This file contains compact layout of vertex to fragment attributes.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <student/fwd.hpp>
+
+uint32_t const maxVaryingFloats = maxAttributes*4;///< maximum number of floats of all vertex to fragment attributes
+
+/**
+ * @brief This struct represents packed layout of vertex to fragment attributes of one program.
+ *
+ * Only attributes declared by setVS2FSType are stored, their floats are packed one after another.
+ */
+struct VaryingLayout{
+  uint32_t nofVaryings            = 0 ;///< number of declared attributes
+  uint32_t nofFloats              = 0 ;///< number of floats of all declared attributes
+  uint32_t attrib[maxAttributes]  = {};///< id of attribute of varying
+  uint32_t offset[maxAttributes]  = {};///< offset of varying in packed floats
+  uint32_t size  [maxAttributes]  = {};///< number of floats of varying
+};
+
+/**
+ * @brief This struct represents vertex after vertex shader with packed attributes.
+ *
+ * Only first VaryingLayout::nofFloats floats of varyings are valid.
+ */
+struct ClipVertex{
+  glm::vec4 gl_Position                ;///< clip space position
+  float     varyings[maxVaryingFloats] ;///< packed vertex to fragment attributes
+};
+
+void buildVaryingLayout(VaryingLayout&layout,AttributeType const*attributes);
+void packVertex        (float*dst,OutVertex const&vertex,VaryingLayout const&layout);
+void packVertexBatch   (float*dst,OutVertexBatch const&batch,uint32_t lane,VaryingLayout const&layout);
+void unpackVertex      (ClipVertex&vertex,float const*src,VaryingLayout const&layout);
+void lerpVertex        (ClipVertex&out,ClipVertex const&a,ClipVertex const&b,float t,VaryingLayout const&layout);
+
+/**
+ * @brief This function returns number of floats of one packed vertex.
+ *
+ * @param layout layout of attributes
+ *
+ * @return number of floats (position + attributes)
+ */
+inline uint32_t packedVertexSize(VaryingLayout const&layout){
+  return 4 + layout.nofFloats;
+}
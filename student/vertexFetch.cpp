@@ -0,0 +1,239 @@
+/*!
+ * @file
+ * @brief This file contains implementation of vertex fetch stage.
+ *
+ * Fetch functions are specialised for index type, attribute type and for
+ * tightly packed heads (stride equals attribute size). The right function
+ * is selected once per draw call, so the per vertex work is a plain loop
+ * without switches and without heap allocations.
+ * Base vertex of draw is applied to data pointer of heads once per draw,
+ * gl_VertexID contains it, so gather functions read from unshifted data.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <cstring>
+
+#include <student/vertexFetch.hpp>
+
+namespace{
+
+/**
+ * @brief This struct reads vertex number from index buffer.
+ *
+ * @tparam INDEX type of index, void for non indexed draw
+ */
+template<typename INDEX>
+struct IndexReader{
+  static uint32_t read(uint8_t const*indices,uint32_t invocation){
+    return static_cast<uint32_t>(reinterpret_cast<INDEX const*>(indices)[invocation]);
+  }
+};
+
+template<>
+struct IndexReader<void>{
+  static uint32_t read(uint8_t const*,uint32_t invocation){
+    return invocation;
+  }
+};
+
+template<typename INDEX>
+void fetchVertexIDs(InVertex*vertices,uint32_t count,uint8_t const*indices,uint32_t first,int32_t baseVertex){
+  for(uint32_t v=0;v<count;++v)
+    vertices[v].gl_VertexID = IndexReader<INDEX>::read(indices,first+v) + static_cast<uint32_t>(baseVertex);
+}
+
+template<typename INDEX>
+void fetchVertexIDArray(uint32_t*ids,uint32_t count,uint8_t const*indices,uint32_t first,int32_t baseVertex){
+  for(uint32_t v=0;v<count;++v)
+    ids[v] = IndexReader<INDEX>::read(indices,first+v) + static_cast<uint32_t>(baseVertex);
+}
+
+template<typename INDEX,uint32_t COMPONENTS,bool PACKED>
+void fetchHead(InVertex*vertices,uint32_t count,ResolvedHead const&head,uint8_t const*indices,uint32_t first){
+  uint64_t const size   = sizeof(float)*COMPONENTS;
+  uint64_t const stride = PACKED?size:head.stride;
+  uint8_t  const*data   = head.data;
+  uint32_t const attrib = head.attrib;
+  for(uint32_t v=0;v<count;++v){
+    uint32_t const id = IndexReader<INDEX>::read(indices,first+v);
+    std::memcpy(&vertices[v].attributes[attrib].v4[0],data + id*stride,size);
+  }
+}
+
+template<uint32_t COMPONENTS,bool PACKED>
+void gatherHead(InVertex*vertices,uint32_t count,ResolvedHead const&head){
+  uint64_t const size   = sizeof(float)*COMPONENTS;
+  uint64_t const stride = PACKED?size:head.stride;
+  uint8_t  const*data   = head.base;
+  uint32_t const attrib = head.attrib;
+  for(uint32_t v=0;v<count;++v)
+    std::memcpy(&vertices[v].attributes[attrib].v4[0],data + vertices[v].gl_VertexID*stride,size);
+}
+
+template<uint32_t COMPONENTS>
+void gatherInstanceHead(InVertex*vertices,uint32_t count,ResolvedHead const&head){
+  uint64_t const size   = sizeof(float)*COMPONENTS;
+  uint8_t  const*data   = head.data;
+  uint32_t const attrib = head.attrib;
+  for(uint32_t v=0;v<count;++v)
+    std::memcpy(&vertices[v].attributes[attrib].v4[0],data,size);
+}
+
+template<uint32_t COMPONENTS>
+void fetchInstanceHead(InVertex*vertices,uint32_t count,ResolvedHead const&head,uint8_t const*,uint32_t){
+  gatherInstanceHead<COMPONENTS>(vertices,count,head);
+}
+
+template<typename INDEX>
+HeadFetcher selectHeadFetcher(AttributeType type,bool packed){
+  switch(type){
+    case AttributeType::FLOAT:return packed?fetchHead<INDEX,1,true>:fetchHead<INDEX,1,false>;
+    case AttributeType::VEC2 :return packed?fetchHead<INDEX,2,true>:fetchHead<INDEX,2,false>;
+    case AttributeType::VEC3 :return packed?fetchHead<INDEX,3,true>:fetchHead<INDEX,3,false>;
+    case AttributeType::VEC4 :return packed?fetchHead<INDEX,4,true>:fetchHead<INDEX,4,false>;
+    default                  :return nullptr;
+  }
+}
+
+}
+
+/**
+ * @brief This function selects function that computes gl_VertexID.
+ *
+ * @param indexed is indexing enabled
+ * @param indexType type of index
+ *
+ * @return vertex id fetch function
+ */
+VertexIDFetcher selectVertexIDFetcher(bool indexed,IndexType indexType){
+  if(!indexed)return fetchVertexIDs<void>;
+  switch(indexType){
+    case IndexType::UINT8 :return fetchVertexIDs<uint8_t >;
+    case IndexType::UINT16:return fetchVertexIDs<uint16_t>;
+    case IndexType::UINT32:return fetchVertexIDs<uint32_t>;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief This function selects function that writes gl_VertexID into plain array.
+ *
+ * It is used where only ids are needed, e.g. for lookups into post-transform vertex cache.
+ *
+ * @param indexed is indexing enabled
+ * @param indexType type of index
+ *
+ * @return vertex id array fetch function
+ */
+VertexIDArrayFetcher selectVertexIDArrayFetcher(bool indexed,IndexType indexType){
+  if(!indexed)return fetchVertexIDArray<void>;
+  switch(indexType){
+    case IndexType::UINT8 :return fetchVertexIDArray<uint8_t >;
+    case IndexType::UINT16:return fetchVertexIDArray<uint16_t>;
+    case IndexType::UINT32:return fetchVertexIDArray<uint32_t>;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief This function selects function that reads one vertex puller head.
+ *
+ * @param indexed is indexing enabled
+ * @param indexType type of index
+ * @param type type of attribute
+ * @param stride stride of head in bytes
+ *
+ * @return head fetch function or nullptr for empty attribute
+ */
+HeadFetcher selectHeadFetcher(bool indexed,IndexType indexType,AttributeType type,uint64_t stride){
+  bool const packed = stride == sizeof(float)*static_cast<uint64_t>(type);
+  if(!indexed)return selectHeadFetcher<void>(type,packed);
+  switch(indexType){
+    case IndexType::UINT8 :return selectHeadFetcher<uint8_t >(type,packed);
+    case IndexType::UINT16:return selectHeadFetcher<uint16_t>(type,packed);
+    case IndexType::UINT32:return selectHeadFetcher<uint32_t>(type,packed);
+  }
+  return nullptr;
+}
+
+/**
+ * @brief This function selects function that reads one vertex puller head for vertices with known gl_VertexID.
+ *
+ * @param type type of attribute
+ * @param stride stride of head in bytes
+ *
+ * @return head gather function or nullptr for empty attribute
+ */
+HeadGatherer selectHeadGatherer(AttributeType type,uint64_t stride){
+  bool const packed = stride == sizeof(float)*static_cast<uint64_t>(type);
+  switch(type){
+    case AttributeType::FLOAT:return packed?gatherHead<1,true>:gatherHead<1,false>;
+    case AttributeType::VEC2 :return packed?gatherHead<2,true>:gatherHead<2,false>;
+    case AttributeType::VEC3 :return packed?gatherHead<3,true>:gatherHead<3,false>;
+    case AttributeType::VEC4 :return packed?gatherHead<4,true>:gatherHead<4,false>;
+    default                  :return nullptr;
+  }
+}
+
+/**
+ * @brief This function selects function that reads per-instance head.
+ *
+ * All vertices of instance get the same element, so the index buffer is not read.
+ * Data of the head have to point to the element of the instance.
+ *
+ * @param type type of attribute
+ *
+ * @return head fetch function or nullptr for empty attribute
+ */
+HeadFetcher selectInstanceHeadFetcher(AttributeType type){
+  switch(type){
+    case AttributeType::FLOAT:return fetchInstanceHead<1>;
+    case AttributeType::VEC2 :return fetchInstanceHead<2>;
+    case AttributeType::VEC3 :return fetchInstanceHead<3>;
+    case AttributeType::VEC4 :return fetchInstanceHead<4>;
+    default                  :return nullptr;
+  }
+}
+
+/**
+ * @brief This function selects function that reads per-instance head for vertices selected by post-transform cache.
+ *
+ * @param type type of attribute
+ *
+ * @return head gather function or nullptr for empty attribute
+ */
+HeadGatherer selectInstanceHeadGatherer(AttributeType type){
+  switch(type){
+    case AttributeType::FLOAT:return gatherInstanceHead<1>;
+    case AttributeType::VEC2 :return gatherInstanceHead<2>;
+    case AttributeType::VEC3 :return gatherInstanceHead<3>;
+    case AttributeType::VEC4 :return gatherInstanceHead<4>;
+    default                  :return nullptr;
+  }
+}
+
+/**
+ * @brief This function transposes fetched vertices into batch for batched vertex shader.
+ *
+ * Only attributes read by heads are written, unused lanes repeat the last vertex.
+ *
+ * @param batch batch that is filled
+ * @param vertices fetched vertices
+ * @param count number of vertices (1 - vertexShaderBatchSize)
+ * @param heads resolved heads
+ * @param nofHeads number of resolved heads
+ */
+void loadVertexBatch(InVertexBatch&batch,InVertex const*vertices,uint32_t count,ResolvedHead const*heads,uint32_t nofHeads){
+  batch.count = count;
+  for(uint32_t v=0;v<vertexShaderBatchSize;++v){
+    auto const&vertex = vertices[v<count?v:count-1];
+    batch.gl_VertexID[v]   = vertex.gl_VertexID;
+    batch.gl_InstanceID[v] = vertex.gl_InstanceID;
+    for(uint32_t h=0;h<nofHeads;++h){
+      auto const a = heads[h].attrib;
+      for(uint32_t c=0;c<4;++c)
+        batch.attributes[a][c][v] = vertex.attributes[a].v4[c];
+    }
+  }
+}
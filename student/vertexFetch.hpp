@@ -0,0 +1,96 @@
+/*!
+ * @file
+ * @brief This file contains vertex fetch stage of vertex puller.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <student/fwd.hpp>
+
+uint32_t const vertexFetchBatchSize = 64;///< number of vertices that are fetched together
+
+struct ResolvedHead;
+
+/**
+ * @brief Function type that fills gl_VertexID of a batch of vertices
+ *
+ * @param vertices output vertices
+ * @param count number of vertices in batch
+ * @param indices index buffer data (nullptr for non indexed draw)
+ * @param first number of the first invocation in batch
+ * @param baseVertex value added to vertex numbers
+ */
+using VertexIDFetcher = void(*)(
+    InVertex      *vertices  ,
+    uint32_t       count     ,
+    uint8_t  const*indices   ,
+    uint32_t       first     ,
+    int32_t        baseVertex);
+
+/**
+ * @brief Function type that writes gl_VertexID of a batch of vertices into plain array
+ *
+ * @param ids output vertex ids
+ * @param count number of vertices in batch
+ * @param indices index buffer data (nullptr for non indexed draw)
+ * @param first number of the first invocation in batch
+ * @param baseVertex value added to vertex numbers
+ */
+using VertexIDArrayFetcher = void(*)(
+    uint32_t      *ids       ,
+    uint32_t       count     ,
+    uint8_t  const*indices   ,
+    uint32_t       first     ,
+    int32_t        baseVertex);
+
+/**
+ * @brief Function type that reads one vertex attribute of a batch of vertices
+ *
+ * @param vertices output vertices
+ * @param count number of vertices in batch
+ * @param head resolved head that is read
+ * @param indices index buffer data (nullptr for non indexed draw)
+ * @param first number of the first invocation in batch
+ */
+using HeadFetcher = void(*)(
+    InVertex          *vertices,
+    uint32_t           count   ,
+    ResolvedHead const&head    ,
+    uint8_t      const*indices ,
+    uint32_t           first   );
+
+/**
+ * @brief Function type that reads one vertex attribute of vertices with already known gl_VertexID
+ *
+ * @param vertices vertices with filled gl_VertexID, attributes are written
+ * @param count number of vertices
+ * @param head resolved head that is read
+ */
+using HeadGatherer = void(*)(
+    InVertex          *vertices,
+    uint32_t           count   ,
+    ResolvedHead const&head    );
+
+/**
+ * @brief This struct represents vertex puller head resolved to raw buffer memory.
+ */
+struct ResolvedHead{
+  uint8_t const* data    = nullptr             ;///< buffer data shifted by head offset and base vertex of draw, element of current instance for per-instance head
+  uint8_t const* base    = nullptr             ;///< buffer data shifted by head offset
+  uint64_t       stride  = 0                   ;///< stride in bytes
+  uint32_t       divisor = 0                   ;///< instances that share one element, 0 for per-vertex head
+  AttributeType  type    = AttributeType::EMPTY;///< type of attribute
+  uint32_t       attrib  = 0                   ;///< id of vertex attribute
+  HeadFetcher    fetch   = nullptr             ;///< fetch function specialised for type, index type and packing
+  HeadGatherer   gather  = nullptr             ;///< fetch function for vertices selected by post-transform cache
+};
+
+VertexIDFetcher      selectVertexIDFetcher     (bool indexed,IndexType indexType);
+VertexIDArrayFetcher selectVertexIDArrayFetcher(bool indexed,IndexType indexType);
+HeadFetcher          selectHeadFetcher         (bool indexed,IndexType indexType,AttributeType type,uint64_t stride);
+HeadGatherer         selectHeadGatherer        (AttributeType type,uint64_t stride);
+HeadFetcher          selectInstanceHeadFetcher (AttributeType type);
+HeadGatherer         selectInstanceHeadGatherer(AttributeType type);
+void                 loadVertexBatch           (InVertexBatch&batch,InVertex const*vertices,uint32_t count,ResolvedHead const*heads,uint32_t nofHeads);
@@ -203,15 +203,10 @@ void Window::mainLoop()
 {
   running = true;
   // main loop
+  // idle callback renders the frame and updates window surface
   while (running) {
     processEvents();
-
-    SDL_LockSurface(surface);
-
     callIdleCallback();
-
-    SDL_UnlockSurface(surface);
-    SDL_UpdateWindowSurface(window);
   }
 }
 
@@ -0,0 +1,31 @@
+#include <tests/allocationCounter.hpp>
+
+#include <atomic>
+
+namespace{
+std::atomic<bool  >hooksRegistered  = {false};
+std::atomic<bool  >countAllocations = {false};
+std::atomic<size_t>nofAllocations   = {0    };
+}
+
+void startAllocationCounting(){
+  nofAllocations   = 0;
+  countAllocations = true;
+}
+
+size_t stopAllocationCounting(){
+  countAllocations = false;
+  return nofAllocations;
+}
+
+bool isAllocationCountingAvailable(){
+  return hooksRegistered;
+}
+
+void registerAllocationHooks(){
+  hooksRegistered = true;
+}
+
+void countAllocation(){
+  if(countAllocations)nofAllocations++;
+}
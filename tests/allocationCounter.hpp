@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+void   startAllocationCounting();
+size_t stopAllocationCounting ();
+
+/**
+ * @brief Allocations are counted only in executable that links tests/allocationHooks.cpp (izgProjectTests)
+ *
+ * @return true if malloc, calloc, realloc and operator new are counted
+ */
+bool   isAllocationCountingAvailable();
+
+// called by tests/allocationHooks.cpp
+void   registerAllocationHooks();
+void   countAllocation        ();
@@ -0,0 +1,37 @@
+#include <tests/allocationCounter.hpp>
+
+#include <cstdlib>
+
+// Replaces allocation functions of C library, operator new of C++ library allocates through them.
+// This file is linked only into izgProjectTests, application does not pay for counting.
+
+#if defined(__GLIBC__)
+
+extern "C"{
+void*__libc_malloc (size_t size);
+void*__libc_calloc (size_t n,size_t size);
+void*__libc_realloc(void*ptr,size_t size);
+
+void*malloc(size_t size)noexcept{
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void*calloc(size_t n,size_t size)noexcept{
+  countAllocation();
+  return __libc_calloc(n,size);
+}
+
+void*realloc(void*ptr,size_t size)noexcept{
+  countAllocation();
+  return __libc_realloc(ptr,size);
+}
+}
+
+namespace{
+struct AllocationHooks{
+  AllocationHooks(){registerAllocationHooks();}
+}const allocationHooks;
+}
+
+#endif
@@ -104,3 +104,44 @@ SCENARIO("GPU buffer data tests"){
   gpu.deleteBuffer(b);
 }
 
+
+SCENARIO("GPU buffer ids of deleted buffers should stay invalid when slots are reused"){
+  std::cerr << "42 - GPU buffer stale id tests" << std::endl;
+  auto gpu = GPU();
+
+  auto b0 = gpu.createBuffer(8);
+  auto b1 = gpu.createBuffer(8);
+  auto b2 = gpu.createBuffer(8);
+
+  gpu.deleteBuffer(b1);
+  auto b3 = gpu.createBuffer(8);
+
+  REQUIRE(b3 != b0);
+  REQUIRE(b3 != b1);
+  REQUIRE(b3 != b2);
+  REQUIRE(gpu.isBuffer(b1) == false);
+  REQUIRE(gpu.isBuffer(b3) == true);
+
+  // write through stale id must not reach the buffer that reuses its slot
+  uint32_t const initial = 0xcafebabe;
+  gpu.setBufferData(b3,0,sizeof(initial),&initial);
+  uint32_t value = 0x12345678;
+  gpu.setBufferData(b1,0,sizeof(value),&value);
+  uint32_t readBack = 0;
+  gpu.getBufferData(b3,0,sizeof(readBack),&readBack);
+  REQUIRE(readBack == initial);
+
+  gpu.deleteBuffer(b1);
+  REQUIRE(gpu.isBuffer(b3) == true);
+
+  gpu.deleteBuffer(b2);
+  auto b4 = gpu.createBuffer(8);
+  REQUIRE(b4 != b2);
+  REQUIRE(gpu.isBuffer(b0) == true);
+  REQUIRE(gpu.isBuffer(b2) == false);
+  REQUIRE(gpu.isBuffer(b4) == true);
+
+  gpu.deleteBuffer(b0);
+  gpu.deleteBuffer(b3);
+  gpu.deleteBuffer(b4);
+}
@@ -0,0 +1,207 @@
+#include <tests/bunnyScene.hpp>
+
+#include <student/bunny.hpp>
+#include <BasicCamera/OrbitCamera.h>
+#include <BasicCamera/PerspectiveCamera.h>
+
+void bunnyScene_VS(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&uniforms){
+  outVertex.gl_Position = uniforms.uniform[0].m4*glm::vec4(inVertex.attributes[0].v3,1.f);
+  outVertex.attributes[0].v3 = inVertex.attributes[1].v3;
+}
+
+void bunnyScene_VSBatch(OutVertexBatch&outVertices,InVertexBatch const&inVertices,Uniforms const&uniforms){
+  auto const&mvp = uniforms.uniform[0].m4;
+  auto const&pos = inVertices.attributes[0];
+  for(uint32_t r=0;r<4;++r)
+    for(uint32_t v=0;v<vertexShaderBatchSize;++v)
+      outVertices.gl_Position[r][v] = (mvp[0][r]*pos[0][v] + mvp[1][r]*pos[1][v]) + (mvp[2][r]*pos[2][v] + mvp[3][r]);
+  for(uint32_t c=0;c<3;++c)
+    for(uint32_t v=0;v<vertexShaderBatchSize;++v)
+      outVertices.attributes[0][c][v] = inVertices.attributes[1][c][v];
+}
+
+void bunnyScene_VSInstanced(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&uniforms){
+  auto const&instance = inVertex.attributes[2].v4;
+  outVertex.gl_Position = uniforms.uniform[0].m4*glm::vec4(inVertex.attributes[0].v3*instance.w + glm::vec3(instance),1.f);
+  outVertex.attributes[0].v3 = inVertex.attributes[1].v3;
+}
+
+void bunnyScene_FS(OutFragment&outFragment,InFragment const&inFragment,Uniforms const&){
+  outFragment.gl_FragColor = glm::vec4(glm::abs(inFragment.attributes[0].v3),1.f);
+}
+
+void bunnyScene_FSBatch(OutFragmentBatch&outFragments,InFragmentBatch const&inFragments,Uniforms const&){
+  for(uint32_t c=0;c<3;++c)
+    for(uint32_t f=0;f<fragmentShaderBatchSize;++f)
+      outFragments.gl_FragColor[c][f] = glm::abs(inFragments.attributes[0][c][f]);
+  for(uint32_t f=0;f<fragmentShaderBatchSize;++f)
+    outFragments.gl_FragColor[3][f] = 1.f;
+}
+
+BunnyScene::BunnyScene(GPU&g):gpu(g){
+  vbo = gpu.createBuffer(sizeof(bunnyVertices));
+  gpu.setBufferData(vbo,0,sizeof(bunnyVertices),bunnyVertices);
+  ebo = gpu.createBuffer(sizeof(bunnyIndices));
+  gpu.setBufferData(ebo,0,sizeof(bunnyIndices),bunnyIndices);
+
+  vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,0,AttributeType::VEC3,sizeof(BunnyVertex),0                ,vbo);
+  gpu.setVertexPullerHead(vao,1,AttributeType::VEC3,sizeof(BunnyVertex),sizeof(float)*3,vbo);
+  gpu.enableVertexPullerHead(vao,0);
+  gpu.enableVertexPullerHead(vao,1);
+  gpu.setVertexPullerIndexing(vao,IndexType::UINT32,ebo);
+
+  prg = gpu.createProgram();
+  attachShaders();
+  gpu.setVS2FSType(prg,0,AttributeType::VEC3);
+}
+
+BunnyScene::~BunnyScene(){
+  if(instanceBuffer != emptyID){
+    gpu.deleteProgram(instancedPrg);
+    gpu.deleteVertexPuller(instancedVao);
+    gpu.deleteBuffer(instanceBuffer);
+  }
+  gpu.deleteProgram(prg);
+  gpu.deleteVertexPuller(vao);
+  gpu.deleteBuffer(ebo);
+  gpu.deleteBuffer(vbo);
+}
+
+void BunnyScene::multiDraw(glm::mat4 const&mvp,std::vector<DrawIndirectCommand>const&draws){
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+  gpu.programUniformMatrix4f(prg,0,mvp);
+  gpu.multiDrawTriangles(draws.data(),static_cast<uint32_t>(draws.size()));
+  gpu.unbindVertexPuller();
+}
+
+void BunnyScene::setInstances(std::vector<glm::vec4>const&instances){
+  if(instanceBuffer != emptyID){
+    gpu.deleteProgram(instancedPrg);
+    gpu.deleteVertexPuller(instancedVao);
+    gpu.deleteBuffer(instanceBuffer);
+  }
+  nofInstances   = static_cast<uint32_t>(instances.size());
+  instanceBuffer = gpu.createBuffer(sizeof(glm::vec4)*instances.size());
+  gpu.setBufferData(instanceBuffer,0,sizeof(glm::vec4)*instances.size(),instances.data());
+
+  instancedVao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(instancedVao,0,AttributeType::VEC3,sizeof(BunnyVertex),0                ,vbo);
+  gpu.setVertexPullerHead(instancedVao,1,AttributeType::VEC3,sizeof(BunnyVertex),sizeof(float)*3,vbo);
+  gpu.enableVertexPullerHead(instancedVao,0);
+  gpu.enableVertexPullerHead(instancedVao,1);
+  gpu.enableVertexPullerHead(instancedVao,2);
+  gpu.setVertexPullerIndexing(instancedVao,IndexType::UINT32,ebo);
+
+  instancedPrg = gpu.createProgram();
+  gpu.attachShaders(instancedPrg,bunnyScene_VSInstanced,bunnyScene_FS);
+  gpu.setVS2FSType(instancedPrg,0,AttributeType::VEC3);
+}
+
+void BunnyScene::drawInstanced(glm::mat4 const&mvp){
+  gpu.setVertexPullerHead(instancedVao,2,AttributeType::VEC4,sizeof(glm::vec4),0,instanceBuffer);
+  gpu.setVertexPullerHeadDivisor(instancedVao,2,1);
+  gpu.bindVertexPuller(instancedVao);
+  gpu.useProgram(instancedPrg);
+  gpu.programUniformMatrix4f(instancedPrg,0,mvp);
+  gpu.drawTrianglesInstanced(bunnyNofIndices,nofInstances);
+  gpu.unbindVertexPuller();
+}
+
+void BunnyScene::drawInstancesSeparately(glm::mat4 const&mvp){
+  gpu.setVertexPullerHeadDivisor(instancedVao,2,0);
+  gpu.bindVertexPuller(instancedVao);
+  gpu.useProgram(instancedPrg);
+  gpu.programUniformMatrix4f(instancedPrg,0,mvp);
+  // head with zero stride reads the same instance for every vertex
+  for(uint32_t i=0;i<nofInstances;++i){
+    gpu.setVertexPullerHead(instancedVao,2,AttributeType::VEC4,0,sizeof(glm::vec4)*i,instanceBuffer);
+    gpu.drawTriangles(bunnyNofIndices);
+  }
+  gpu.unbindVertexPuller();
+}
+
+void BunnyScene::useBatchedVertexShader(){
+  batchedVS = true;
+  attachShaders();
+}
+
+void BunnyScene::useBatchedFragmentShader(){
+  batchedFS = true;
+  attachShaders();
+}
+
+void BunnyScene::attachShaders(){
+  if(batchedVS){
+    if(batchedFS)gpu.attachShaders(prg,bunnyScene_VSBatch,bunnyScene_FSBatch);
+    else         gpu.attachShaders(prg,bunnyScene_VSBatch,bunnyScene_FS     );
+  }else{
+    if(batchedFS)gpu.attachShaders(prg,bunnyScene_VS     ,bunnyScene_FSBatch);
+    else         gpu.attachShaders(prg,bunnyScene_VS     ,bunnyScene_FS     );
+  }
+}
+
+void BunnyScene::draw(glm::mat4 const&mvp){
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+  gpu.programUniformMatrix4f(prg,0,mvp);
+  gpu.drawTriangles(bunnyNofIndices);
+  gpu.unbindVertexPuller();
+}
+
+void BunnyScene::record(CommandBuffer&commandBuffer,glm::mat4 const&mvp){
+  commandBuffer.bindVertexPuller(vao);
+  commandBuffer.useProgram(prg);
+  commandBuffer.programUniformMatrix4f(prg,0,mvp);
+  commandBuffer.drawTriangles(bunnyNofIndices);
+  commandBuffer.unbindVertexPuller();
+}
+
+glm::mat4 bunnyViewProjection(uint32_t width,uint32_t height){
+  auto orbitCamera       = basicCamera::OrbitCamera();
+  auto perspectiveCamera = basicCamera::PerspectiveCamera();
+  orbitCamera.addDistance(1.f);
+  perspectiveCamera.setNear(0.1f);
+  perspectiveCamera.setAspect(static_cast<float>(width) / static_cast<float>(height));
+  return perspectiveCamera.getProjection()*orbitCamera.getView();
+}
+
+std::vector<glm::vec4>bunnyInstances(uint32_t nofInstances){
+  uint32_t side = 1;
+  while(side*side < nofInstances)++side;
+  float const scale = 1.f/static_cast<float>(side);
+  std::vector<glm::vec4>instances;
+  for(uint32_t i=0;i<nofInstances;++i){
+    float const x = (static_cast<float>(i%side)+.5f)*scale - .5f;
+    float const y = (static_cast<float>(i/side)+.5f)*scale - .5f;
+    instances.emplace_back(x,y,-.01f*static_cast<float>(i%7),scale);
+  }
+  return instances;
+}
+
+std::vector<DrawIndirectCommand>bunnyPieces(uint32_t nofPieces){
+  uint32_t const nofTriangles = bunnyNofIndices/3;
+  std::vector<DrawIndirectCommand>draws;
+  for(uint32_t i=0;i<nofPieces;++i){
+    uint32_t const first = nofTriangles* i   /nofPieces;
+    uint32_t const last  = nofTriangles*(i+1)/nofPieces;
+    DrawIndirectCommand draw;
+    draw.count      = (last-first)*3;
+    draw.firstIndex = first*3;
+    draws.push_back(draw);
+  }
+  return draws;
+}
+
+FramebufferImage captureFramebuffer(GPU&gpu){
+  auto const pixels = (size_t)gpu.getFramebufferWidth()*gpu.getFramebufferHeight();
+  auto const depth  = gpu.getFramebufferDepth();
+  return std::make_pair(captureColor(gpu),std::vector<float>(depth,depth+pixels));
+}
+
+std::vector<uint8_t>captureColor(GPU&gpu){
+  auto const pixels = (size_t)gpu.getFramebufferWidth()*gpu.getFramebufferHeight();
+  auto const color  = gpu.getFramebufferColor();
+  return std::vector<uint8_t>(color,color+pixels*4);
+}
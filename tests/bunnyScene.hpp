@@ -0,0 +1,45 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include <student/gpu.hpp>
+
+/**
+ * @brief This struct uploads Stanford bunny to GPU and draws it with simple shaders.
+ */
+struct BunnyScene{
+  BunnyScene(GPU&gpu);
+  ~BunnyScene();
+  void draw(glm::mat4 const&mvp);
+  void record(CommandBuffer&commandBuffer,glm::mat4 const&mvp);
+  void multiDraw(glm::mat4 const&mvp,std::vector<DrawIndirectCommand>const&draws);
+  void setInstances(std::vector<glm::vec4>const&instances);
+  void drawInstanced(glm::mat4 const&mvp);
+  void drawInstancesSeparately(glm::mat4 const&mvp);
+  void useBatchedVertexShader();
+  void useBatchedFragmentShader();
+  void attachShaders();
+  GPU&           gpu;///< graphic card
+  BufferID       vbo;///< vertex buffer
+  BufferID       ebo;///< index buffer
+  VertexPullerID vao;///< vertex puller
+  ProgramID      prg;///< shader program
+  bool           batchedVS = false;///< use batched vertex shader
+  bool           batchedFS = false;///< use batched fragment shader
+  BufferID       instanceBuffer = emptyID;///< offset (xyz) and scale (w) of every instance
+  VertexPullerID instancedVao   = emptyID;///< vertex puller that reads instances from head 2
+  ProgramID      instancedPrg   = emptyID;///< shader program that places instances
+  uint32_t       nofInstances   = 0      ;///< number of instances
+};
+
+uint32_t const bunnyNofIndices = 2092*3;///< number of indices of bunny
+
+glm::mat4                       bunnyViewProjection(uint32_t width,uint32_t height);
+std::vector<glm::vec4>          bunnyInstances     (uint32_t nofInstances);
+std::vector<DrawIndirectCommand>bunnyPieces        (uint32_t nofPieces);
+
+using FramebufferImage = std::pair<std::vector<uint8_t>,std::vector<float>>;///< RGBA8 color and depth of framebuffer
+
+FramebufferImage                captureFramebuffer (GPU&gpu);
+std::vector<uint8_t>            captureColor       (GPU&gpu);
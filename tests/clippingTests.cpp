@@ -7,6 +7,8 @@
 #include <numeric>
 
 #include <student/gpu.hpp>
+#include <tests/allocationCounter.hpp>
+#include <tests/testCommon.hpp>
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -162,3 +164,132 @@ SCENARIO("triangles with 2 vertices behind near plane should be clipped"){
 
 }
 
+
+SCENARIO("triangles should be clipped exactly against far plane"){
+  std::cerr << "76 - clipping - far plane" << std::endl;
+  auto gpu = GPU();
+  uint32_t w=100;
+  uint32_t h=100;
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderDataInject,fragmentShaderDump);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  // depth is x+1, so only the left half of the screen lies in front of far plane
+  vsData.clear();
+  fsData.clear();
+  vsData.push_back({{},glm::vec4(-1.f,-1.f,0.f,1.f)});
+  vsData.push_back({{},glm::vec4(+3.f,-1.f,4.f,1.f)});
+  vsData.push_back({{},glm::vec4(-1.f,+3.f,0.f,1.f)});
+
+  gpu.clear(0,0,0,1);
+  gpu.drawTriangles(3);
+
+  REQUIRE(fsData.size() == w*h/2);
+  for(auto const&fragment:fsData){
+    REQUIRE(fragment.gl_FragCoord.x < w/2);
+    REQUIRE(fragment.gl_FragCoord.z <= 1.f);
+  }
+}
+
+void vertexShaderClipPosition(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&uniforms){
+  vertexShaderDataInject(outVertex,inVertex,uniforms);
+  outVertex.attributes[0].v4 = outVertex.gl_Position;
+}
+
+SCENARIO("clipped vertices should carry interpolated vertex attributes"){
+  std::cerr << "77 - clipping - attributes of clipped vertices" << std::endl;
+  auto gpu = GPU();
+  uint32_t w=100;
+  uint32_t h=80;
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderClipPosition,fragmentShaderDump);
+  gpu.setVS2FSType(prg,0,AttributeType::VEC4);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  // the triangle crosses near plane, far plane and sides of the frustum,
+  // attribute is clip space position, so after division it has to match the fragment position
+  auto const proj = glm::perspective(glm::radians(90.f),static_cast<float>(w)/static_cast<float>(h),1.f,10.f);
+  vsData.clear();
+  vsData.push_back({{},proj*glm::vec4(-3.f,-1.f, -.5f,1.f)});
+  vsData.push_back({{},proj*glm::vec4(+9.f,-2.f, -5.f,1.f)});
+  vsData.push_back({{},proj*glm::vec4(-1.f,+9.f,-12.f,1.f)});
+
+  gpu.drawTriangles(3);
+
+  auto draw = [&](uint32_t guardBand){
+    gpu.setGuardBand(guardBand);
+    fsData.clear();
+    fsData.reserve(w*h);
+    gpu.clear(0,0,0,1);
+    startAllocationCounting();
+    gpu.drawTriangles(3);
+    auto const nofAllocations = stopAllocationCounting();
+    if(isAllocationCountingAvailable())
+      REQUIRE(nofAllocations == 0);
+
+    REQUIRE(fsData.size() > w*h/10);
+    std::vector<float>depth(w*h,2.f);
+    for(auto const&fragment:fsData){
+      auto const p = fragment.attributes[0].v4;
+      REQUIRE(equalFloats(p.x/p.w,fragment.gl_FragCoord.x/w*2.f-1.f));
+      REQUIRE(equalFloats(p.y/p.w,fragment.gl_FragCoord.y/h*2.f-1.f));
+      REQUIRE(p.z >= -p.w);
+      REQUIRE(p.z <=  p.w);
+      depth.at(static_cast<uint32_t>(fragment.gl_FragCoord.y)*w+static_cast<uint32_t>(fragment.gl_FragCoord.x)) = fragment.gl_FragCoord.z;
+    }
+    return depth;
+  };
+
+  // clipping against the guard band must not change fragments
+  auto const reference = draw(maxGuardBand);
+  for(uint32_t guardBand:{0u,7u}){
+    auto const depth = draw(guardBand);
+    for(size_t i=0;i<depth.size();++i)
+      REQUIRE(equalFloats(depth[i],reference[i]));
+  }
+}
+
+SCENARIO("clipping against guard band should not create holes or overlaps"){
+  std::cerr << "78 - clipping - guard band" << std::endl;
+  auto gpu = GPU();
+  uint32_t w=53;
+  uint32_t h=41;
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderDataInject,fragmentShaderDump);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  // fan of triangles around point inside the screen that reaches far outside of it
+  vsData.clear();
+  auto const center = glm::vec4(.13f,-.21f,0.f,1.f);
+  uint32_t const n = 11;
+  for(uint32_t i=0;i<n;++i){
+    float const a0 = 6.2831853f*i/n;
+    float const a1 = 6.2831853f*(i+1)/n;
+    float const r  = 1e5f;
+    vsData.push_back({{},center});
+    vsData.push_back({{},glm::vec4(r*std::cos(a0),r*std::sin(a0),0.f,1.f+.3f*(i%3))});
+    vsData.push_back({{},glm::vec4(r*std::cos(a1),r*std::sin(a1),0.f,1.f+.3f*((i+1)%3))});
+  }
+
+  for(uint32_t guardBand:{0u,3u,maxGuardBand}){
+    gpu.setGuardBand(guardBand);
+    fsData.clear();
+    gpu.clear(0,0,0,1);
+    gpu.drawTriangles(static_cast<uint32_t>(vsData.size()));
+
+    std::vector<uint32_t>coverage(w*h,0);
+    for(auto const&fragment:fsData)
+      coverage.at(static_cast<uint32_t>(fragment.gl_FragCoord.y)*w+static_cast<uint32_t>(fragment.gl_FragCoord.x))++;
+    for(auto const&count:coverage)
+      REQUIRE(count == 1);
+  }
+}
@@ -0,0 +1,185 @@
+#include <tests/catch.hpp>
+
+#include <iostream>
+#include <string.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <student/gpu.hpp>
+#include <tests/bunnyScene.hpp>
+
+SCENARIO("command buffer should record commands with values at the time of recording"){
+  std::cerr << "79 - command buffer recording" << std::endl;
+  auto commandBuffer = CommandBuffer();
+  auto mvp = glm::mat4(2.f);
+  commandBuffer.bindVertexPuller(3);
+  commandBuffer.useProgram(7);
+  commandBuffer.programUniform1f      (7,0,1.f);
+  commandBuffer.programUniform2f      (7,1,glm::vec2(1.f,2.f));
+  commandBuffer.programUniform3f      (7,2,glm::vec3(1.f,2.f,3.f));
+  commandBuffer.programUniform4f      (7,3,glm::vec4(1.f,2.f,3.f,4.f));
+  commandBuffer.programUniformMatrix4f(7,4,mvp);
+  commandBuffer.clear(.1f,.2f,.3f,.4f);
+  commandBuffer.drawTriangles(36);
+  commandBuffer.unbindVertexPuller();
+  commandBuffer.drawTrianglesInstanced(36,1000);
+  commandBuffer.drawTriangles(36,6,-2);
+  mvp = glm::mat4(3.f);
+
+  auto const&commands = commandBuffer.getCommands();
+  REQUIRE(commands.size() == 12);
+  REQUIRE(commands[0].type   == CommandType::BIND_VERTEX_PULLER);
+  REQUIRE(commands[0].object == 3);
+  REQUIRE(commands[1].type   == CommandType::USE_PROGRAM);
+  REQUIRE(commands[1].object == 7);
+  REQUIRE(commands[2].data.v1 == 1.f);
+  REQUIRE(commands[3].data.v2 == glm::vec2(1.f,2.f));
+  REQUIRE(commands[4].data.v3 == glm::vec3(1.f,2.f,3.f));
+  REQUIRE(commands[5].data.v4 == glm::vec4(1.f,2.f,3.f,4.f));
+  REQUIRE(commands[6].type   == CommandType::PROGRAM_UNIFORM_MATRIX4F);
+  REQUIRE(commands[6].value  == 4);
+  REQUIRE(commands[6].data.m4 == glm::mat4(2.f));
+  REQUIRE(commands[7].data.v4 == glm::vec4(.1f,.2f,.3f,.4f));
+  REQUIRE(commands[8].type   == CommandType::DRAW_TRIANGLES);
+  REQUIRE(commands[8].value  == 36);
+  REQUIRE(commands[9].type   == CommandType::UNBIND_VERTEX_PULLER);
+  REQUIRE(commands[10].type      == CommandType::DRAW_TRIANGLES_INSTANCED);
+  REQUIRE(commands[10].value     == 36);
+  REQUIRE(commands[10].instances == 1000);
+  REQUIRE(commands[11].type      == CommandType::MULTI_DRAW_TRIANGLES);
+  REQUIRE(commands[11].value     == 1);
+  auto const&draw = commandBuffer.getDraws()[commands[11].offset];
+  REQUIRE(draw.count         == 36);
+  REQUIRE(draw.firstIndex    == 6);
+  REQUIRE(draw.baseVertex    == -2);
+  REQUIRE(draw.instanceCount == 1);
+
+  // null draws are not recorded
+  commandBuffer.multiDrawTriangles(nullptr,3);
+  REQUIRE(commands.size() == 12);
+
+  commandBuffer.reset();
+  REQUIRE(commandBuffer.getCommands().empty());
+}
+
+SCENARIO("submitted command buffers should render the same frames as immediate commands"){
+  std::cerr << "80 - command buffer submission" << std::endl;
+  uint32_t const w = 67;
+  uint32_t const h = 45;
+  auto const viewProjection = bunnyViewProjection(w,h);
+  auto const mvp = [&](uint32_t i){return viewProjection*glm::translate(glm::mat4(1.f),glm::vec3(.05f*i,0.f,-.1f*i));};
+  uint32_t const nofFrames = 4;
+
+  // reference frames are rendered by immediate commands
+  std::vector<std::vector<uint8_t>>reference;
+  {
+    auto gpu = GPU();
+    gpu.createFramebuffer(w,h);
+    auto bunny = BunnyScene(gpu);
+    for(uint32_t frame=0;frame<nofFrames;++frame){
+      gpu.clear(.1f*frame,.2f,.3f,1.f);
+      for(uint32_t i=0;i<=frame;++i)
+        bunny.draw(mvp(i));
+      reference.push_back(captureColor(gpu));
+    }
+  }
+
+  for(uint32_t nofThreads:{1u,4u}){
+    auto gpu = GPU();
+    gpu.createFramebuffer(w,h);
+    gpu.setThreadCount(nofThreads);
+    auto bunny = BunnyScene(gpu);
+
+    // one command buffer is reused for every frame, the next frame is recorded while the previous one renders
+    auto commandBuffer = CommandBuffer();
+    for(uint32_t frame=0;frame<nofFrames;++frame){
+      commandBuffer.reset();
+      commandBuffer.clear(.1f*frame,.2f,.3f,1.f);
+      for(uint32_t i=0;i<=frame;++i)
+        bunny.record(commandBuffer,mvp(i));
+      auto const fence = gpu.submit(commandBuffer);
+      commandBuffer.reset();
+      gpu.waitFence(fence);
+      REQUIRE(gpu.isFenceSignaled(fence));
+      auto const color = gpu.getFramebufferColor();
+      REQUIRE(memcmp(color,reference[frame].data(),w*h*4) == 0);
+    }
+
+    // fences are signaled in order of submission
+    std::vector<Fence>fences;
+    for(uint32_t frame=0;frame<nofFrames;++frame){
+      commandBuffer.reset();
+      commandBuffer.clear(.1f*frame,.2f,.3f,1.f);
+      for(uint32_t i=0;i<=frame;++i)
+        bunny.record(commandBuffer,mvp(i));
+      fences.push_back(gpu.submit(commandBuffer));
+    }
+    gpu.waitFence(fences[1]);
+    REQUIRE(gpu.isFenceSignaled(fences[0]));
+    gpu.waitIdle();
+    for(auto const&fence:fences)
+      REQUIRE(gpu.isFenceSignaled(fence));
+    REQUIRE(memcmp(gpu.getFramebufferColor(),reference.back().data(),w*h*4) == 0);
+
+    // empty command buffer signals its fence too
+    auto const fence = gpu.submit(CommandBuffer());
+    gpu.waitFence(fence);
+    REQUIRE(gpu.isFenceSignaled(fence));
+
+    // direct commands wait for submitted command buffers that use the same pipeline state
+    uint32_t const last = nofFrames-1;
+    commandBuffer.reset();
+    commandBuffer.clear(.1f*last,.2f,.3f,1.f);
+    for(uint32_t i=0;i<last;++i)
+      bunny.record(commandBuffer,mvp(i));
+    auto const inFlight = gpu.submit(commandBuffer);
+    bunny.draw(mvp(last));
+    REQUIRE(gpu.isFenceSignaled(inFlight));
+    REQUIRE(memcmp(gpu.getFramebufferColor(),reference.back().data(),w*h*4) == 0);
+  }
+}
+
+SCENARIO("command buffer should copy draws of multi draw and read indirect draws when executed"){
+  std::cerr << "81 - command buffer multi draw and indirect draw" << std::endl;
+  uint32_t const w = 67;
+  uint32_t const h = 45;
+  auto const mvp = bunnyViewProjection(w,h);
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+
+  gpu.clear(0,0,0,1);
+  bunny.draw(mvp);
+  auto const reference = captureColor(gpu);
+
+  auto pieces = bunnyPieces(10);
+  BufferID dbo = gpu.createBuffer(pieces.size()*sizeof(DrawIndirectCommand));
+  auto record = [&](CommandBuffer&commandBuffer,bool indirect){
+    commandBuffer.reset();
+    commandBuffer.clear(0,0,0,1);
+    commandBuffer.bindVertexPuller(bunny.vao);
+    commandBuffer.useProgram(bunny.prg);
+    commandBuffer.programUniformMatrix4f(bunny.prg,0,mvp);
+    if(indirect)commandBuffer.drawTrianglesIndirect(dbo,0,static_cast<uint32_t>(pieces.size()));
+    else        commandBuffer.multiDrawTriangles(pieces.data(),static_cast<uint32_t>(pieces.size()));
+    commandBuffer.unbindVertexPuller();
+  };
+
+  // recorded draws are copies
+  auto commandBuffer = CommandBuffer();
+  record(commandBuffer,false);
+  REQUIRE(commandBuffer.getCommands()[4].type == CommandType::MULTI_DRAW_TRIANGLES);
+  REQUIRE(commandBuffer.getDraws().size() == pieces.size());
+  auto const draws = pieces;
+  pieces.assign(pieces.size(),DrawIndirectCommand());
+  gpu.waitFence(gpu.submit(commandBuffer));
+  REQUIRE(memcmp(gpu.getFramebufferColor(),reference.data(),w*h*4) == 0);
+
+  // indirect records are read when the command is executed
+  record(commandBuffer,true);
+  REQUIRE(commandBuffer.getCommands()[4].type == CommandType::DRAW_TRIANGLES_INDIRECT);
+  REQUIRE(commandBuffer.getDraws().empty());
+  gpu.setBufferData(dbo,0,draws.size()*sizeof(DrawIndirectCommand),draws.data());
+  gpu.waitFence(gpu.submit(commandBuffer));
+  REQUIRE(memcmp(gpu.getFramebufferColor(),reference.data(),w*h*4) == 0);
+}
@@ -10,6 +10,7 @@
 
 #include <student/gpu.hpp>
 #include <tests/testCommon.hpp>
+#include <tests/bunnyScene.hpp>
 
 void vertexShaderTri(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
   if(inVertex.gl_VertexID == 0)outVertex.gl_Position = glm::vec4(-1.f,-1.f,-1.f,1.f);
@@ -317,6 +318,54 @@ SCENARIO("rasterization should interpolate vertex attributes using barycentric c
 }
 
 
+std::vector<InFragment>allFragments;
+void fragmentShaderAll(OutFragment&,InFragment const&inFragment,Uniforms const&){
+  allFragments.push_back(inFragment);
+}
+
+SCENARIO("perspective correct interpolation should stay precise for every fragment of triangle far from the origin"){
+  std::cerr << "64 - precision of perspective correct interpolation" << std::endl;
+  uint32_t const w = 1500;
+  uint32_t const h = 1100;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderInterp,fragmentShaderAll);
+  gpu.setVS2FSType(prg,0,AttributeType::VEC3);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  float     const hc [3] = {1.f,3.f,.7f};
+  float     const zz [3] = {.9f,-.4f,.3f};
+  glm::vec2 const ndc[3] = {{.6f,.5f},{.95f,.55f},{.7f,.98f}};
+  triVertices.clear();
+  for(int i=0;i<3;++i)
+    triVertices.push_back(glm::vec4(ndc[i]*hc[i],zz[i]*hc[i],hc[i]));
+
+  allFragments.clear();
+  gpu.clear(0,0,0,1);
+  gpu.drawTriangles(3);
+  REQUIRE(allFragments.size() > 10000);
+
+  glm::dvec2 s[3];
+  for(int i=0;i<3;++i)
+    s[i] = glm::dvec2((ndc[i].x+1.)*.5*w,(ndc[i].y+1.)*.5*h);
+  auto edge = [](glm::dvec2 const&a,glm::dvec2 const&b,glm::dvec2 const&p){
+    return (b.x-a.x)*(p.y-a.y) - (b.y-a.y)*(p.x-a.x);
+  };
+  double const area = edge(s[0],s[1],s[2]);
+  for(auto const&fragment:allFragments){
+    auto const p = glm::dvec2(fragment.gl_FragCoord.x,fragment.gl_FragCoord.y);
+    double l[3] = {edge(s[1],s[2],p)/area/hc[0],edge(s[2],s[0],p)/area/hc[1],edge(s[0],s[1],p)/area/hc[2]};
+    double const divisor = l[0]+l[1]+l[2];
+    for(int i=0;i<3;++i)
+      REQUIRE(equalFloats(fragment.attributes[0].v3[i],(float)(l[i]/divisor)));
+    REQUIRE(equalFloats(fragment.gl_FragCoord.z,(float)((zz[0]*l[0]+zz[1]*l[1]+zz[2]*l[2])/divisor)));
+  }
+}
+
+
 void fragmentShaderWhite(OutFragment&outFragment,InFragment const&,Uniforms const&){
   outFragment.gl_FragColor = glm::vec4(1.f);
 }
@@ -391,3 +440,527 @@ SCENARIO("per fragment operations should eliminate fragments that do not pass de
   REQUIRE(color[(10*w+10)*4+2]==0.f);
 
 }
+
+void vertexShaderSparse(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
+  vertexShaderTri(outVertex,inVertex,Uniforms());
+  outVertex.attributes[2].v1 = 3.f;
+  outVertex.attributes[5].v4 = glm::vec4(7.f);
+  outVertex.attributes[9].v4 = glm::vec4(1.f,2.f,3.f,4.f);
+}
+
+std::vector<InFragment>sparseFragments;
+void fragmentShaderSparse(OutFragment&,InFragment const&inFragment,Uniforms const&){
+  sparseFragments.push_back(inFragment);
+}
+
+SCENARIO("rasterization should pass only declared vertex attributes to fragment attributes"){
+  std::cerr << "65 - only declared vertex attributes are interpolated" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  gpu->createFramebuffer(10,10);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderSparse,fragmentShaderSparse);
+  gpu->setVS2FSType(prg,2,AttributeType::FLOAT);
+  gpu->setVS2FSType(prg,9,AttributeType::VEC4);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  sparseFragments.clear();
+  gpu->drawTriangles(3);
+
+  REQUIRE(sparseFragments.size() > 0);
+  for(auto const&fragment:sparseFragments){
+    REQUIRE(equalFloats(fragment.attributes[2].v1,3.f));
+    for(int i=0;i<4;++i){
+      REQUIRE(equalFloats(fragment.attributes[9].v4[i],static_cast<float>(i+1)));
+      REQUIRE(equalFloats(fragment.attributes[5].v4[i],1.f));
+    }
+  }
+}
+
+std::vector<glm::vec4>meshPositions;
+void vertexShaderMesh(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
+  outVertex.gl_Position = meshPositions.at(inVertex.gl_VertexID);
+}
+
+std::vector<uint32_t>pixelCoverage;
+uint32_t coverageWidth = 0;
+void fragmentShaderCoverage(OutFragment&,InFragment const&inFragment,Uniforms const&){
+  auto const x = static_cast<uint32_t>(inFragment.gl_FragCoord.x);
+  auto const y = static_cast<uint32_t>(inFragment.gl_FragCoord.y);
+  pixelCoverage.at(y*coverageWidth+x)++;
+}
+
+SCENARIO("rasterization should be watertight, triangles sharing an edge should cover every pixel exactly once"){
+  std::cerr << "66 - rasterization of shared edges" << std::endl;
+  uint32_t const w = 61;
+  uint32_t const h = 47;
+  auto gpu = std::make_shared<GPU>();
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderMesh,fragmentShaderCoverage);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  // grid of quads with jittered inner vertices, each quad split into two triangles with alternating winding
+  uint32_t const n = 7;
+  auto vertex = [&](uint32_t i,uint32_t j){
+    float x = -1.f + 2.f*i/n;
+    float y = -1.f + 2.f*j/n;
+    if(i>0 && i<n)x += 0.37f*std::sin(float(i*13+j*7))/n;
+    if(j>0 && j<n)y += 0.37f*std::cos(float(i*5+j*11))/n;
+    float const w = 1.f + 0.5f*((i+j)%3);
+    return glm::vec4(x*w,y*w,0.f,w);
+  };
+  meshPositions.clear();
+  for(uint32_t j=0;j<n;++j)
+    for(uint32_t i=0;i<n;++i){
+      auto const a = vertex(i,j),b = vertex(i+1,j),c = vertex(i+1,j+1),d = vertex(i,j+1);
+      meshPositions.insert(meshPositions.end(),{a,b,c});
+      meshPositions.insert(meshPositions.end(),{a,d,c});
+    }
+
+  coverageWidth = w;
+  pixelCoverage.assign(w*h,0);
+  gpu->clear(0,0,0,1);
+  gpu->drawTriangles(static_cast<uint32_t>(meshPositions.size()));
+
+  for(auto const&count:pixelCoverage)
+    REQUIRE(count == 1);
+}
+
+SCENARIO("rasterization should not produce fragments for degenerate triangles"){
+  std::cerr << "67 - rasterization of degenerate triangles" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  gpu->createFramebuffer(20,20);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderMesh,fragmentShaderCoverage);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  meshPositions = {
+    glm::vec4(-.5f,-.5f,0.f,1.f),glm::vec4(-.5f,-.5f,0.f,1.f),glm::vec4(-.5f,-.5f,0.f,1.f),
+    glm::vec4(-1.f,-1.f,0.f,1.f),glm::vec4( 0.f, 0.f,0.f,1.f),glm::vec4( 1.f, 1.f,0.f,1.f),
+    glm::vec4(-1.f,-1.f,0.f,1.f),glm::vec4( 1e30f,1.f,0.f,1.f),glm::vec4(-1e30f,1.f,0.f,1.f),
+  };
+  coverageWidth = 20;
+  pixelCoverage.assign(20*20,0);
+  gpu->drawTriangles(6);
+
+  REQUIRE(std::accumulate(pixelCoverage.begin(),pixelCoverage.end(),0u) == 0u);
+
+  gpu->drawTriangles(9);
+  REQUIRE(std::accumulate(pixelCoverage.begin(),pixelCoverage.end(),0u) > 0u);
+}
+
+SCENARIO("binned multi-threaded rasterization should produce the same image as single-threaded rasterization"){
+  std::cerr << "68 - binned multi-threaded rasterization" << std::endl;
+  uint32_t const w = 211;
+  uint32_t const h = 157;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto render = [&](uint32_t nofThreads,uint32_t tileSize){
+    gpu.setThreadCount(nofThreads);
+    gpu.setTileSize(tileSize);
+    gpu.clear(0,0,0,1);
+    bunny.draw(mvp);
+    return captureFramebuffer(gpu);
+  };
+
+  auto const reference = render(1,defaultTileSize);
+  REQUIRE(render(4,defaultTileSize) == reference);
+  REQUIRE(render(3,16) == reference);
+  REQUIRE(render(8,7) == reference);
+}
+
+std::vector<glm::vec4>batchFragCoords;
+std::vector<uint32_t >batchSizes;
+void fragmentShaderBatchCoords(OutFragmentBatch&,InFragmentBatch const&inFragments,Uniforms const&){
+  uint32_t size = 0;
+  for(uint32_t f=0;f<fragmentShaderBatchSize;++f){
+    if(!(inFragments.mask & (1u<<f)))continue;
+    size++;
+    batchFragCoords.emplace_back(inFragments.gl_FragCoord[0][f],inFragments.gl_FragCoord[1][f],inFragments.gl_FragCoord[2][f],inFragments.attributes[0][0][f]);
+  }
+  batchSizes.push_back(size);
+}
+
+void vertexShaderTriAttrib(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&uniforms){
+  vertexShaderTri(outVertex,inVertex,uniforms);
+  outVertex.attributes[0].v1 = 7.f;
+}
+
+SCENARIO("batched fragment shader should receive every fragment exactly once"){
+  std::cerr << "69 - batched fragment shader coverage" << std::endl;
+  uint32_t const w = 37;
+  uint32_t const h = 23;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderTriAttrib,fragmentShaderBatchCoords);
+  gpu.setVS2FSType(prg,0,AttributeType::FLOAT);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  batchFragCoords.clear();
+  batchSizes.clear();
+  gpu.clear(0,0,0,1);
+  gpu.drawTriangles(3);
+
+  std::vector<uint32_t>coverage(w*h,0);
+  for(auto const&c:batchFragCoords){
+    auto const x = static_cast<uint32_t>(c.x);
+    auto const y = static_cast<uint32_t>(c.y);
+    REQUIRE(equalFloats(c.x,x+0.5f));
+    REQUIRE(equalFloats(c.y,y+0.5f));
+    REQUIRE(equalFloats(c.z,-1.f));
+    REQUIRE(equalFloats(c.w,7.f));
+    coverage.at(y*w+x)++;
+  }
+
+  // reference coverage is produced by scalar fragment shader
+  coverageWidth = w;
+  pixelCoverage.assign(w*h,0);
+  gpu.attachShaders(prg,vertexShaderTriAttrib,fragmentShaderCoverage);
+  gpu.clear(0,0,0,1);
+  gpu.drawTriangles(3);
+  REQUIRE(coverage == pixelCoverage);
+
+  // only the last batch of the triangle can be partially filled
+  REQUIRE(batchSizes.size() > 1);
+  for(size_t i=0;i+1<batchSizes.size();++i)
+    REQUIRE(batchSizes[i] == fragmentShaderBatchSize);
+  REQUIRE(batchSizes.back() > 0u);
+}
+
+SCENARIO("batched fragment shader should render the same image as scalar fragment shader"){
+  std::cerr << "70 - batched fragment shader image" << std::endl;
+  uint32_t const w = 211;
+  uint32_t const h = 157;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto render = [&](uint32_t nofThreads){
+    gpu.setThreadCount(nofThreads);
+    gpu.clear(0,0,0,1);
+    bunny.draw(mvp);
+    return captureFramebuffer(gpu);
+  };
+
+  auto const reference = render(1);
+  bunny.useBatchedFragmentShader();
+  REQUIRE(render(1) == reference);
+  REQUIRE(render(4) == reference);
+  bunny.useBatchedVertexShader();
+  REQUIRE(render(3) == reference);
+}
+
+SCENARIO("face culling should discard triangles by their winding in screen space"){
+  std::cerr << "71 - face culling" << std::endl;
+  uint32_t const w = 40;
+  uint32_t const h = 30;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderMesh,fragmentShaderCoverage);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  // counter-clockwise triangle in the left half, clockwise triangle in the right half,
+  // the last one is counter-clockwise in screen space, but its vertices have negative w
+  meshPositions = {
+    glm::vec4(-1.f,-1.f,0.f,1.f),glm::vec4(-.1f,-1.f,0.f,1.f),glm::vec4(-1.f,1.f,0.f,1.f),
+    glm::vec4(+.1f,-1.f,0.f,2.f),glm::vec4(+1.f, 1.f,0.f,2.f),glm::vec4(+1.f,-1.f,0.f,2.f),
+    glm::vec4(+1.f, 1.f,0.f,-1.f),glm::vec4(-.1f,1.f,0.f,-1.f),glm::vec4(1.f,-1.f,0.f,-1.f),
+  };
+  coverageWidth = w;
+
+  auto draw = [&](CullMode mode,FrontFace face){
+    gpu.setCullMode(mode);
+    gpu.setFrontFace(face);
+    gpu.resetStats();
+    pixelCoverage.assign(w*h,0);
+    gpu.clear(0,0,0,1);
+    gpu.drawTriangles(6);
+    uint32_t left = 0,right = 0;
+    for(uint32_t y=0;y<h;++y)
+      for(uint32_t x=0;x<w;++x)
+        (x<w/2?left:right) += pixelCoverage[y*w+x];
+    return std::make_tuple(left>0,right>0,gpu.getStats().culledPrimitives);
+  };
+
+  REQUIRE(draw(CullMode::NONE ,FrontFace::CCW) == std::make_tuple(true ,true ,uint64_t(0)));
+  REQUIRE(draw(CullMode::BACK ,FrontFace::CCW) == std::make_tuple(true ,false,uint64_t(1)));
+  REQUIRE(draw(CullMode::FRONT,FrontFace::CCW) == std::make_tuple(false,true ,uint64_t(1)));
+  REQUIRE(draw(CullMode::BACK ,FrontFace::CW ) == std::make_tuple(false,true ,uint64_t(1)));
+  REQUIRE(draw(CullMode::FRONT,FrontFace::CW ) == std::make_tuple(true ,false,uint64_t(1)));
+
+  // the triangle behind the camera is back facing, it is culled before clipping would discard it
+  gpu.setCullMode(CullMode::BACK);
+  gpu.setFrontFace(FrontFace::CCW);
+  gpu.resetStats();
+  gpu.drawTriangles(9);
+  REQUIRE(gpu.getStats().culledPrimitives == 2);
+}
+
+SCENARIO("hierarchical z-buffer should reject triangles hidden behind nearer geometry"){
+  std::cerr << "72 - hierarchical z-buffer" << std::endl;
+  uint32_t const w = 211;
+  uint32_t const h = 157;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto wallVao = gpu.createVertexPuller();
+  auto wallPrg = gpu.createProgram();
+  gpu.attachShaders(wallPrg,vertexShaderMesh,fragmentShaderWhite);
+  auto drawWall = [&](float z){
+    meshPositions = {
+      glm::vec4(-1.f,-1.f,z,1.f),glm::vec4(+1.f,-1.f,z,1.f),glm::vec4(+1.f,+1.f,z,1.f),
+      glm::vec4(-1.f,-1.f,z,1.f),glm::vec4(+1.f,+1.f,z,1.f),glm::vec4(-1.f,+1.f,z,1.f),
+    };
+    gpu.bindVertexPuller(wallVao);
+    gpu.useProgram(wallPrg);
+    gpu.drawTriangles(6);
+  };
+
+  gpu.clear(0,0,0,1);
+  drawWall(-.9f);
+  auto const wall = captureFramebuffer(gpu);
+
+  // the bunny behind the wall is rejected without rasterization of its fragments, read back of depth does not change it,
+  // pointer into linear depth buffer disables only rejection of whole triangles until touched tiles are recomputed
+  for(auto const layout:{FramebufferLayout::LINEAR,FramebufferLayout::TILED})
+    for(uint32_t nofThreads:{1u,4u})
+      for(bool const readBack:{false,true}){
+        gpu.setFramebufferLayout(layout);
+        gpu.setThreadCount(nofThreads);
+        gpu.clear(0,0,0,1);
+        drawWall(-.9f);
+        if(readBack)
+          gpu.getFramebufferDepth();
+        gpu.resetStats();
+        bunny.draw(mvp);
+        if(!readBack || layout == FramebufferLayout::TILED)
+          REQUIRE(gpu.getStats().hizRejectedTriangles > 0);
+        REQUIRE(gpu.getStats().hizRejectedTriangles + gpu.getStats().hizRejectedTiles >= bunnyNofIndices/3 - gpu.getStats().culledPrimitives);
+        REQUIRE(captureFramebuffer(gpu) == wall);
+      }
+  gpu.setFramebufferLayout(FramebufferLayout::LINEAR);
+  gpu.setThreadCount(1);
+
+  // the bunny in front of the wall is not affected
+  gpu.clear(0,0,0,1);
+  bunny.draw(mvp);
+  auto const bunnyOnly = captureFramebuffer(gpu);
+  gpu.clear(0,0,0,1);
+  drawWall(.9999f);
+  bunny.draw(mvp);
+  auto const bunnyAndWall = captureFramebuffer(gpu);
+  for(size_t i=0;i<w*h;++i)
+    if(bunnyOnly.second[i] < 1.f)
+      REQUIRE(bunnyAndWall.second[i] == bunnyOnly.second[i]);
+}
+
+SCENARIO("hierarchical z-buffer should follow depth buffer written through its pointer"){
+  std::cerr << "73 - hierarchical z-buffer and external depth writes" << std::endl;
+  uint32_t const w = 64;
+  uint32_t const h = 48;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderMesh,fragmentShaderCoverage);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  meshPositions = {
+    glm::vec4(-1.f,-1.f,.5f,1.f),glm::vec4(+3.f,-1.f,.5f,1.f),glm::vec4(-1.f,+3.f,.5f,1.f),
+  };
+  coverageWidth = w;
+
+  // depth of tiled framebuffer is written through view that is copied back
+  for(auto const layout:{FramebufferLayout::LINEAR,FramebufferLayout::TILED}){
+    gpu.setFramebufferLayout(layout);
+    pixelCoverage.assign(w*h,0);
+    gpu.clear(0,0,0,1);
+    gpu.drawTriangles(3);
+
+    // left half is nearer than the triangle, right half is farther than any cleared depth
+    auto depth = gpu.getFramebufferDepth();
+    for(uint32_t y=0;y<h;++y)
+      for(uint32_t x=0;x<w;++x)
+        depth[y*w+x] = x < w/2 ? 0.f : 10.f;
+
+    pixelCoverage.assign(w*h,0);
+    gpu.drawTriangles(3);
+    for(uint32_t y=0;y<h;++y)
+      for(uint32_t x=0;x<w;++x)
+        REQUIRE(pixelCoverage[y*w+x] == (x < w/2 ? 0u : 1u));
+  }
+}
+
+SCENARIO("visibility buffer mode should shade every covered pixel once and render the same image as forward rendering"){
+  std::cerr << "74 - visibility buffer" << std::endl;
+  uint32_t const w = 211;
+  uint32_t const h = 157;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const viewProjection = bunnyViewProjection(w,h);
+
+  // overlapping bunnies, uniforms of every draw call differ
+  std::vector<glm::mat4>mvps;
+  for(int i=0;i<5;++i)
+    mvps.push_back(viewProjection*glm::translate(glm::mat4(1.f),glm::vec3(.03f*i,.01f*i,-.05f*i)));
+
+  auto render = [&](bool reversed){
+    gpu.clear(0,0,0,1);
+    gpu.resetStats();
+    for(size_t i=0;i<mvps.size();++i)
+      bunny.draw(mvps[reversed?mvps.size()-1-i:i]);
+    gpu.resolveVisibilityBuffer();
+    return captureFramebuffer(gpu);
+  };
+
+  gpu.setRenderMode(RenderMode::FORWARD);
+  auto const frontToBack = render(false);
+  auto const backToFront = render(true);
+  uint64_t const forwardInvocations = gpu.getStats().fragmentShaderInvocations;
+  uint64_t const covered = (uint64_t)std::count_if(backToFront.second.begin(),backToFront.second.end(),[](float d){return d < 1.1f;});
+  REQUIRE(forwardInvocations > covered);
+
+  gpu.setRenderMode(RenderMode::VISIBILITY);
+  for(uint32_t nofThreads:{1u,4u}){
+    gpu.setThreadCount(nofThreads);
+    for(bool reversed:{false,true}){
+      auto const image = render(reversed);
+      uint64_t const invocations = gpu.getStats().fragmentShaderInvocations;
+      REQUIRE(invocations == covered);
+      REQUIRE(image == (reversed?backToFront:frontToBack));
+    }
+  }
+  gpu.setThreadCount(1);
+
+  // nothing is drawn until the resolve, switching back to forward rendering resolves pending draw calls
+  gpu.clear(0,0,0,1);
+  auto const color = gpu.getFramebufferColor();
+  auto const cleared = std::vector<uint8_t>(color,color+w*h*4);
+  bunny.draw(mvps[0]);
+  REQUIRE(std::vector<uint8_t>(color,color+w*h*4) == cleared);
+  gpu.setRenderMode(RenderMode::FORWARD);
+  gpu.resetStats();
+  gpu.resolveVisibilityBuffer();
+  REQUIRE(gpu.getStats().fragmentShaderInvocations == 0);
+  gpu.clear(0,0,0,1);
+  gpu.setRenderMode(RenderMode::VISIBILITY);
+  bunny.draw(mvps[0]);
+  gpu.setRenderMode(RenderMode::FORWARD);
+  auto const resolved = std::vector<uint8_t>(gpu.getFramebufferColor(),gpu.getFramebufferColor()+w*h*4);
+  gpu.clear(0,0,0,1);
+  bunny.draw(mvps[0]);
+  REQUIRE(resolved == std::vector<uint8_t>(gpu.getFramebufferColor(),gpu.getFramebufferColor()+w*h*4));
+}
+
+SCENARIO("clearColor and clearDepth should clear only their buffer"){
+  std::cerr << "75 - fast clear" << std::endl;
+  uint32_t const w = 61;
+  uint32_t const h = 43;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderMesh,fragmentShaderWhite);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  // triangle covering the lower left half of the framebuffer
+  meshPositions = {
+    glm::vec4(-1.f,-1.f,0.f,1.f),glm::vec4(+1.f,-1.f,0.f,1.f),glm::vec4(-1.f,+1.f,0.f,1.f),
+  };
+  auto const covered = [&](uint32_t x,uint32_t y){
+    return (x+.5f)/w+(y+.5f)/h < 1.f;
+  };
+  auto const pixels = [&](){
+    auto const color = gpu.getFramebufferColor();
+    std::vector<uint32_t>result(w*h);
+    memcpy(result.data(),color,w*h*4);
+    return result;
+  };
+  uint32_t const white = 0xffffffffu;
+  uint32_t const blue = 0xffff0000u;
+
+  for(auto const layout:{FramebufferLayout::LINEAR,FramebufferLayout::TILED})
+    for(uint32_t nofThreads:{1u,4u}){
+      gpu.setFramebufferLayout(layout);
+      gpu.setThreadCount(nofThreads);
+
+      gpu.clear(0,0,1,1);
+      auto image = pixels();
+      REQUIRE(std::all_of(image.begin(),image.end(),[&](uint32_t c){return c == blue;}));
+      REQUIRE(std::all_of(gpu.getFramebufferDepth(),gpu.getFramebufferDepth()+w*h,[](float d){return d == defaultClearDepth;}));
+
+      // untouched tiles are written only when the color buffer is read
+      gpu.drawTriangles(3);
+      image = pixels();
+      for(uint32_t y=0;y<h;++y)
+        for(uint32_t x=0;x<w;++x)
+          REQUIRE(image[y*w+x] == (covered(x,y) ? white : blue));
+
+      // color clear keeps depth of the triangle, so the same triangle does not pass depth test
+      gpu.clearColor(0,0,1,1);
+      gpu.drawTriangles(3);
+      image = pixels();
+      REQUIRE(std::all_of(image.begin(),image.end(),[&](uint32_t c){return c == blue;}));
+
+      // depth clear keeps color
+      gpu.clear(0,0,1,1);
+      gpu.drawTriangles(3);
+      gpu.clearDepth();
+      auto const depth = gpu.getFramebufferDepth();
+      REQUIRE(std::all_of(depth,depth+w*h,[](float d){return d == defaultClearDepth;}));
+      image = pixels();
+      for(uint32_t y=0;y<h;++y)
+        for(uint32_t x=0;x<w;++x)
+          REQUIRE(image[y*w+x] == (covered(x,y) ? white : blue));
+
+      // depth clear value is used by depth test
+      gpu.clear(0,0,1,1);
+      gpu.clearDepth(-.5f);
+      gpu.drawTriangles(3);
+      image = pixels();
+      REQUIRE(std::all_of(image.begin(),image.end(),[&](uint32_t c){return c == blue;}));
+    }
+
+  // clear that is still pending is kept when the framebuffer is resized
+  for(auto const layout:{FramebufferLayout::LINEAR,FramebufferLayout::TILED})
+    for(auto const size:{glm::uvec2(97,71),glm::uvec2(23,19)}){
+      gpu.setFramebufferLayout(layout);
+      gpu.resizeFramebuffer(w,h);
+      gpu.clear(0,0,0,1);
+      gpu.drawTriangles(3);
+      gpu.clear(0,0,1,1);
+      gpu.resizeFramebuffer(size.x,size.y);
+      std::vector<uint32_t>resized(size.x*size.y);
+      memcpy(resized.data(),gpu.getFramebufferColor(),resized.size()*4);
+      REQUIRE(std::all_of(resized.begin(),resized.end(),[&](uint32_t c){return c == blue;}));
+      auto const depth = gpu.getFramebufferDepth();
+      REQUIRE(std::all_of(depth,depth+size.x*size.y,[](float d){return d == defaultClearDepth;}));
+
+      // triangle drawn after the resize passes depth test against the cleared depth
+      gpu.drawTriangles(3);
+      memcpy(resized.data(),gpu.getFramebufferColor(),resized.size()*4);
+      REQUIRE(resized.front() == white);
+      REQUIRE(resized.back() == blue);
+    }
+}
@@ -5,8 +5,17 @@
 
 #include <algorithm>
 #include <numeric>
+#include <cmath>
 
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <condition_variable>
+#include <mutex>
+
+#include <student/application.hpp>
 #include <student/gpu.hpp>
+#include <student/swapChain.hpp>
+#include <tests/bunnyScene.hpp>
 
 SCENARIO("Framebuffer tests"){
   std::cerr << "04 - framebuffer tests" << std::endl;
@@ -31,3 +40,355 @@ SCENARIO("Framebuffer tests"){
 
   gpu.deleteFramebuffer();
 }
+
+SCENARIO("deleted framebuffer should release its buffers and keep memory of the caller"){
+  std::cerr << "82 - framebuffer deletion" << std::endl;
+  uint32_t const w = 13;
+  uint32_t const h = 7;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h,ColorFormat::RGB565,DepthFormat::D16);
+  gpu.setFramebufferLayout(FramebufferLayout::TILED);
+  gpu.clear(1.f,1.f,1.f,1.f);
+  gpu.getFramebufferColor();
+  gpu.deleteFramebuffer();
+  REQUIRE(gpu.getFramebufferWidth() == 0);
+  REQUIRE(gpu.getFramebufferHeight() == 0);
+  REQUIRE(gpu.getFramebufferColor() == nullptr);
+  REQUIRE(gpu.getFramebufferDepth() == nullptr);
+  gpu.deleteFramebuffer();
+
+  // framebuffer created again is cleared like a new one
+  auto fresh = GPU();
+  fresh.createFramebuffer(w,h);
+  gpu.createFramebuffer(w,h);
+  REQUIRE(memcmp(gpu.getFramebufferColor(),fresh.getFramebufferColor(),w*h*4) == 0);
+  REQUIRE(memcmp(gpu.getFramebufferDepth(),fresh.getFramebufferDepth(),w*h*sizeof(float)) == 0);
+
+  // memory of the caller stays valid after deletion
+  std::vector<uint8_t>memory(w*h*4,0);
+  gpu.setColorBufferMemory(memory.data(),w*4,false);
+  gpu.clear(1.f,1.f,1.f,1.f);
+  gpu.finish();
+  gpu.deleteFramebuffer();
+  REQUIRE(memory[0] == 255);
+  gpu.createFramebuffer(w,h);
+  gpu.clear(0.f,0.f,0.f,0.f);
+  REQUIRE(gpu.getFramebufferColor()[0] == 0);
+  REQUIRE(memory[0] == 255);
+}
+
+SCENARIO("tiled framebuffer should render the same images as linear framebuffer"){
+  std::cerr << "43 - tiled framebuffer" << std::endl;
+  uint32_t const w = 211;
+  uint32_t const h = 157;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const viewProjection = bunnyViewProjection(w,h);
+
+  auto render = [&](){
+    gpu.clear(.2f,.4f,.6f,1.f);
+    for(int i=0;i<3;++i)
+      bunny.draw(viewProjection*glm::translate(glm::mat4(1.f),glm::vec3(.05f*i,0.f,-.1f*i)));
+    gpu.resolveVisibilityBuffer();
+    return captureFramebuffer(gpu);
+  };
+
+  auto const reference = render();
+  gpu.setFramebufferLayout(FramebufferLayout::TILED);
+  REQUIRE(captureFramebuffer(gpu) == reference);
+  for(uint32_t nofThreads:{1u,4u})
+    for(auto const mode:{RenderMode::FORWARD,RenderMode::VISIBILITY}){
+      gpu.setThreadCount(nofThreads);
+      gpu.setRenderMode(mode);
+      REQUIRE(render() == reference);
+    }
+  gpu.setThreadCount(1);
+  gpu.setRenderMode(RenderMode::FORWARD);
+
+  // writes through returned pointers reach the tiled framebuffer
+  gpu.clear(0,0,0,1);
+  auto color = gpu.getFramebufferColor();
+  color[(5*w+7)*4] = 77;
+  auto depth = gpu.getFramebufferDepth();
+  for(uint32_t i=0;i<w*h;++i)
+    depth[i] = -10.f;
+  bunny.draw(viewProjection);
+  auto const blocked = captureFramebuffer(gpu);
+  REQUIRE(blocked.first[(5*w+7)*4] == 77);
+  REQUIRE(std::count(blocked.first.begin(),blocked.first.end(),(uint8_t)0) == (std::ptrdiff_t)(w*h*3-1));
+
+  // content is kept when the layout changes back
+  auto const tiled = render();
+  gpu.setFramebufferLayout(FramebufferLayout::LINEAR);
+  REQUIRE(captureFramebuffer(gpu) == tiled);
+  gpu.resizeFramebuffer(97,61);
+  gpu.setFramebufferLayout(FramebufferLayout::TILED);
+  gpu.clear(0,0,0,1);
+  bunny.draw(viewProjection);
+  gpu.setFramebufferLayout(FramebufferLayout::LINEAR);
+  auto const tiledSmall = std::vector<uint8_t>(gpu.getFramebufferColor(),gpu.getFramebufferColor()+97*61*4);
+  gpu.clear(0,0,0,1);
+  bunny.draw(viewProjection);
+  REQUIRE(std::vector<uint8_t>(gpu.getFramebufferColor(),gpu.getFramebufferColor()+97*61*4) == tiledSmall);
+}
+
+float formatQuadDepth = 0.f;
+void vertexShaderFormatQuad(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
+  glm::vec2 const corners[] = {{-1.f,-1.f},{+1.f,-1.f},{+1.f,+1.f},{-1.f,-1.f},{+1.f,+1.f},{-1.f,+1.f}};
+  outVertex.gl_Position = glm::vec4(corners[inVertex.gl_VertexID],formatQuadDepth,1.f);
+}
+void fragmentShaderFormatQuad(OutFragment&outFragment,InFragment const&,Uniforms const&u){
+  outFragment.gl_FragColor = u.uniform[0].v4;
+}
+
+SCENARIO("framebuffer formats should convert colors and depths with their precision"){
+  std::cerr << "44 - framebuffer formats" << std::endl;
+  uint32_t const w = 67;
+  uint32_t const h = 45;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const viewProjection = bunnyViewProjection(w,h);
+
+  auto render = [&](){
+    gpu.clear(.3f,.5f,.7f,1.f);
+    bunny.draw(viewProjection);
+    return captureFramebuffer(gpu);
+  };
+  auto const reference = render();
+
+  // maximal difference of RGBA8 read back (in 1/255) and of depth for every format
+  struct ColorPrecision{ColorFormat format;int error;};
+  struct DepthPrecision{DepthFormat format;float error;};
+  ColorPrecision const colorFormats[] = {{ColorFormat::RGBA8,0},{ColorFormat::RGB565,5},{ColorFormat::RGBA16F,1}};
+  DepthPrecision const depthFormats[] = {{DepthFormat::D32F,0.f},{DepthFormat::D24,2.f/16777215.f},{DepthFormat::D16,2.f/65535.f}};
+
+  for(auto const&color:colorFormats)
+    for(auto const&depth:depthFormats)
+      for(auto const layout:{FramebufferLayout::LINEAR,FramebufferLayout::TILED}){
+        gpu.setFramebufferLayout(layout);
+        gpu.createFramebuffer(w,h,color.format,depth.format);
+        auto const result = render();
+        uint32_t differentPixels = 0;
+        for(uint32_t i=0;i<w*h;++i){
+          bool different = false;
+          for(uint32_t c=0;c<4;++c){
+            int const difference = std::abs((int)result.first[i*4+c]-(int)reference.first[i*4+c]);
+            different |= difference > color.error;
+          }
+          // depth quantization can change the winner of depth test in few pixels
+          if(reference.second[i] >= 1.f)
+            REQUIRE(result.second[i] == (depth.format == DepthFormat::D32F ? reference.second[i] : 1.f));
+          else
+            different |= std::abs(result.second[i]-reference.second[i]) > depth.error;
+          differentPixels += different;
+        }
+        REQUIRE(differentPixels <= (depth.format == DepthFormat::D32F ? 0u : w*h/100));
+      }
+  gpu.setFramebufferLayout(FramebufferLayout::LINEAR);
+
+  // two quads closer than one step of depth format are not separated by depth test,
+  // the nearer one is drawn second and fails the strict depth test against quantized depth of the first one
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderFormatQuad,fragmentShaderFormatQuad);
+  auto separated = [&](DepthFormat format,float farDepth,float distance){
+    gpu.createFramebuffer(w,h,ColorFormat::RGBA8,format);
+    gpu.bindVertexPuller(vao);
+    gpu.useProgram(prg);
+    gpu.clear(0,0,0,1);
+    formatQuadDepth = farDepth;
+    gpu.programUniform4f(prg,0,glm::vec4(1.f,0.f,0.f,1.f));
+    gpu.drawTriangles(6);
+    formatQuadDepth = farDepth - distance;
+    gpu.programUniform4f(prg,0,glm::vec4(0.f,1.f,0.f,1.f));
+    gpu.drawTriangles(6);
+    auto const color = gpu.getFramebufferColor();
+    return color[(h/2*w+w/2)*4+1] == 255;
+  };
+  // depth in the middle of D16 step, window depth is 30000/65535
+  float const d16Step = 2.f/65535.f;
+  float const farDepth = 30000.f/65535.f*2.f-1.f;
+  REQUIRE(separated(DepthFormat::D32F,farDepth,.25f*d16Step));
+  REQUIRE(separated(DepthFormat::D24 ,farDepth,.25f*d16Step));
+  REQUIRE(!separated(DepthFormat::D16,farDepth,.25f*d16Step));
+  REQUIRE(separated(DepthFormat::D16 ,farDepth,1.5f*d16Step));
+  float const d24FarDepth = 8000000.f/16777215.f*2.f-1.f;
+  REQUIRE(!separated(DepthFormat::D24,d24FarDepth,.25f*2.f/16777215.f));
+  REQUIRE(separated(DepthFormat::D24 ,d24FarDepth,1.5f*2.f/16777215.f));
+
+  // depth written through returned pointer is quantized
+  gpu.createFramebuffer(w,h,ColorFormat::RGB565,DepthFormat::D16);
+  auto depth = gpu.getFramebufferDepth();
+  depth[0] = farDepth + .25f*d16Step;
+  auto color = gpu.getFramebufferColor();
+  color[0] = 255;
+  color[1] = 0;
+  color[2] = 130;
+  gpu.drawTriangles(0);
+  REQUIRE(std::abs(gpu.getFramebufferDepth()[0]-farDepth) < 1e-6f);
+  REQUIRE(gpu.getFramebufferColor()[0] == 255);
+  REQUIRE(std::abs((int)gpu.getFramebufferColor()[2]-130) <= 4);
+  REQUIRE(gpu.getFramebufferColor()[3] == 255);
+}
+
+SCENARIO("swap chain should present frames in order while next frames are rendered"){
+  std::cerr << "45 - swap chain" << std::endl;
+  uint32_t const w = 13;
+  uint32_t const h = 7;
+
+  // presenter is blocked until frames are released, rendering continues until all other images are queued
+  std::mutex mutex;
+  std::condition_variable released;
+  uint32_t releasedFrames = 0;
+  std::vector<std::vector<uint8_t>>presented;
+  std::vector<uint8_t const*>presentedImages;
+  std::vector<glm::uvec2>presentedSizes;
+  uint32_t const nofImages = 3;
+  uint32_t const nofFrames = 10;
+  std::vector<uint8_t const*>renderedImages;
+  {
+    SwapChain swapChain(nofImages,[&](uint8_t const*color,uint32_t width,uint32_t height){
+      std::unique_lock<std::mutex>lock(mutex);
+      released.wait(lock,[&]{return releasedFrames > presented.size();});
+      presented.emplace_back(color,color+width*height*4);
+      presentedImages.push_back(color);
+      presentedSizes.emplace_back(width,height);
+    });
+    REQUIRE(swapChain.getNofImages() == nofImages);
+
+    auto gpu = GPU();
+    gpu.createFramebuffer(w,h);
+    swapChain.acquire(gpu);
+    auto render = [&](uint32_t frame){
+      gpu.clear(frame/255.f,0.f,0.f,1.f);
+      renderedImages.push_back(gpu.getFramebufferColor());
+      swapChain.present(gpu);
+    };
+    for(uint32_t frame=0;frame+1<nofImages;++frame)
+      render(frame);
+    REQUIRE(swapChain.getPresentedFrames() == 0);
+
+    {
+      std::lock_guard<std::mutex>lock(mutex);
+      releasedFrames = nofFrames;
+    }
+    released.notify_all();
+    for(uint32_t frame=nofImages-1;frame<nofFrames;++frame)
+      render(frame);
+    swapChain.finish();
+    REQUIRE(swapChain.getPresentedFrames() == nofFrames);
+  }
+
+  REQUIRE(presented.size() == nofFrames);
+  for(auto const&size:presentedSizes)
+    REQUIRE(size == glm::uvec2(w,h));
+  for(uint32_t frame=0;frame<nofFrames;++frame)
+    for(uint32_t i=0;i<w*h;++i){
+      REQUIRE((uint32_t)presented[frame][i*4+0] == frame);
+      REQUIRE((uint32_t)presented[frame][i*4+3] == 255);
+    }
+
+  // frames are rendered directly into images that are presented, images rotate
+  for(uint32_t frame=0;frame<nofFrames;++frame){
+    REQUIRE(presentedImages[frame] == renderedImages[frame]);
+    if(frame >= nofImages)
+      REQUIRE(presentedImages[frame] == presentedImages[frame-nofImages]);
+  }
+  for(uint32_t frame=0;frame<nofImages;++frame)
+    for(uint32_t other=0;other<frame;++other)
+      REQUIRE(presentedImages[frame] != presentedImages[other]);
+}
+
+SCENARIO("framebuffer should render into memory of the caller with pitch, channel order and flip"){
+  std::cerr << "46 - framebuffer in memory of the caller" << std::endl;
+  uint32_t const w = 67;
+  uint32_t const h = 45;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const viewProjection = bunnyViewProjection(w,h);
+  gpu.clear(.3f,.5f,.7f,1.f);
+  bunny.draw(viewProjection);
+  auto const referenceColor = gpu.getFramebufferColor();
+  std::vector<uint8_t>reference(referenceColor,referenceColor+w*h*4);
+
+  for(auto const format:{ColorFormat::RGBA8,ColorFormat::BGRA8})
+    for(bool const flip:{false,true}){
+      // padding between rows is not written
+      uint32_t const pitch = w*4+12;
+      std::vector<uint8_t>memory(pitch*h,0xcd);
+      gpu.createFramebuffer(w,h,format);
+      gpu.setColorBufferMemory(memory.data(),pitch,flip);
+      gpu.clear(.3f,.5f,.7f,1.f);
+      bunny.draw(viewProjection);
+      gpu.setThreadCount(4);
+      bunny.draw(viewProjection);
+      gpu.setThreadCount(1);
+      gpu.finish();
+
+      for(uint32_t y=0;y<h;++y){
+        uint8_t const*row = memory.data() + (flip ? h-1-y : y) * pitch;
+        for(uint32_t x=0;x<w;++x){
+          uint8_t const*expected = &reference[(y*w+x)*4];
+          uint8_t const*pixel    = row + x*4;
+          bool const bgra = format == ColorFormat::BGRA8;
+          REQUIRE(pixel[0] == expected[bgra ? 2 : 0]);
+          REQUIRE(pixel[1] == expected[1]);
+          REQUIRE(pixel[2] == expected[bgra ? 0 : 2]);
+          REQUIRE(pixel[3] == expected[3]);
+        }
+        for(uint32_t i=w*4;i<pitch;++i)
+          REQUIRE(row[i] == 0xcd);
+      }
+
+      // read back is row by row RGBA8, unbinding keeps content
+      REQUIRE(memcmp(gpu.getFramebufferColor(),reference.data(),reference.size()) == 0);
+      gpu.setColorBufferMemory(nullptr,0,false);
+      memory.assign(memory.size(),0);
+      REQUIRE(memcmp(gpu.getFramebufferColor(),reference.data(),reference.size()) == 0);
+    }
+
+  // resize returns color buffer into memory of the GPU
+  std::vector<uint8_t>memory(w*h*4);
+  gpu.createFramebuffer(w,h);
+  gpu.setColorBufferMemory(memory.data(),w*4,true);
+  gpu.resizeFramebuffer(w/2,h/2);
+  gpu.clear(1.f,1.f,1.f,1.f);
+  REQUIRE(gpu.getFramebufferColor()[0] == 255);
+  REQUIRE(memory[0] == 0);
+
+  // so does creation of framebuffer over memory of the caller
+  gpu.setColorBufferMemory(memory.data(),w*4,true);
+  memory.assign(memory.size(),0);
+  gpu.createFramebuffer(w,h);
+  REQUIRE(gpu.getFramebufferColor()[0] == 0);
+  gpu.clear(1.f,1.f,1.f,1.f);
+  REQUIRE(gpu.getFramebufferColor()[0] == 255);
+  REQUIRE(memory[0] == 0);
+}
+
+SCENARIO("conversion into SDL surface should flip rows and swizzle channels"){
+  std::cerr << "47 - conversion into SDL surface" << std::endl;
+  uint32_t const w = 13;
+  uint32_t const h = 5;
+  std::vector<uint8_t>frame(w*h*4);
+  for(size_t i=0;i<frame.size();++i)
+    frame[i] = static_cast<uint8_t>(i*7+3);
+
+  for(auto const pixelFormat:{SDL_PIXELFORMAT_ARGB8888,SDL_PIXELFORMAT_ABGR8888,SDL_PIXELFORMAT_RGB888,SDL_PIXELFORMAT_RGB24}){
+    auto surface = SDL_CreateRGBSurfaceWithFormat(0,w,h,32,pixelFormat);
+    REQUIRE(surface != nullptr);
+    copyToSDLSurface(surface,frame.data(),w,h);
+    for(uint32_t y=0;y<h;++y)
+      for(uint32_t x=0;x<w;++x){
+        uint8_t const*src = &frame[((h-1-y)*w+x)*4];
+        uint8_t const*dst = (uint8_t*)surface->pixels + y*surface->pitch + x*surface->format->BytesPerPixel;
+        REQUIRE(dst[surface->format->Rshift/8] == src[0]);
+        REQUIRE(dst[surface->format->Gshift/8] == src[1]);
+        REQUIRE(dst[surface->format->Bshift/8] == src[2]);
+      }
+    SDL_FreeSurface(surface);
+  }
+}
@@ -4,11 +4,18 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <thread>
 
 #include <BasicCamera/OrbitCamera.h>
 #include <BasicCamera/PerspectiveCamera.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <student/czFlagMethod.hpp>
+#include <student/application.hpp>
+#include <student/bunny.hpp>
 #include <student/phongMethod.hpp>
+#include <student/swapChain.hpp>
 #include <student/timer.hpp>
+#include <tests/bunnyScene.hpp>
 #include <tests/performanceTest.hpp>
 
 #define ___ std::cerr << __FILE__ << "/" << __LINE__ << std::endl
@@ -34,14 +41,409 @@ void runPerformanceTest(size_t framesPerMeasurement) {
   auto const camera = glm::vec3(glm::inverse(view)*glm::vec4(0.f,0.f,0.f,1.f));
 
 
-  Timer<float>timer;
-  timer.reset();
-  for (size_t i   = 0; i < framesPerMeasurement; ++i){
-    method->onDraw(proj,view,light,camera);
-  }
-  auto const time = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+  auto measure = [&](Method&m,size_t frames){
+    Timer<float>timer;
+    timer.reset();
+    for (size_t i   = 0; i < frames; ++i){
+      m.onDraw(proj,view,light,camera);
+    }
+    // method could submit its frames to render thread of the GPU
+    m.gpu.waitIdle();
+    return timer.elapsedFromStart() / static_cast<float>(frames);
+  };
+
+  auto const time = measure(*method,framesPerMeasurement);
 
   std::cout << "Seconds per frame: " << std::scientific << std::setprecision(10)
             << time << std::endl;
 
+  // bunny scene does not depend on phong method of student
+  GPU bunnyGpu;
+  bunnyGpu.createFramebuffer(width,height);
+  BunnyScene bunny(bunnyGpu);
+  auto measureBunny = [&](size_t frames){
+    Timer<float>timer;
+    timer.reset();
+    for (size_t i   = 0; i < frames; ++i){
+      bunnyGpu.clear(.5f,.5f,.5f,1.f);
+      bunny.draw(proj*view);
+    }
+    return timer.elapsedFromStart() / static_cast<float>(frames);
+  };
+
+  // post-transform vertex cache transforms vertices shared by neighbouring triangles once
+  for(auto const mode:{VertexCacheMode::DISABLED,VertexCacheMode::FIFO,VertexCacheMode::FULL}){
+    bunnyGpu.setVertexCacheMode(mode);
+    bunnyGpu.resetStats();
+    auto const cacheTime = measureBunny(framesPerMeasurement);
+    char const*const names[] = {"disabled","FIFO","full"};
+    std::cout << "Seconds per frame (bunny, " << names[static_cast<uint32_t>(mode)] << " vertex cache, hit rate "
+              << std::fixed << std::setprecision(3) << bunnyGpu.getStats().vertexCacheHitRate() << "): "
+              << std::scientific << std::setprecision(10) << cacheTime << std::endl;
+  }
+  bunnyGpu.setVertexCacheMode(VertexCacheMode::FIFO);
+
+  auto const nofThreads = std::max(std::thread::hardware_concurrency(),1u);
+  bunnyGpu.setThreadCount(nofThreads);
+  auto const threadedTime = measureBunny(framesPerMeasurement);
+  bunnyGpu.setThreadCount(1);
+
+  std::cout << "Seconds per frame (bunny, " << nofThreads << " threads): " << std::scientific << std::setprecision(10)
+            << threadedTime << std::endl;
+
+  bunnyGpu.setCullMode(CullMode::BACK);
+  bunnyGpu.resetStats();
+  auto const culledTime = measureBunny(framesPerMeasurement);
+  auto const culledPrimitives = bunnyGpu.getStats().culledPrimitives / framesPerMeasurement;
+  bunnyGpu.setCullMode(CullMode::NONE);
+
+  std::cout << "Seconds per frame (bunny, back-face culling, " << culledPrimitives << " culled triangles per frame): "
+            << std::scientific << std::setprecision(10) << culledTime << std::endl;
+
+  // overlapping bunnies drawn front to back, most of them are hidden
+  {
+    GPU gpu;
+    gpu.createFramebuffer(width,height);
+    BunnyScene bunny(gpu);
+    uint32_t const nofBunnies = 20;
+    Timer<float>timer;
+    timer.reset();
+    for(size_t i = 0; i < framesPerMeasurement; ++i){
+      gpu.clear(0,0,0,1);
+      for(uint32_t b = 0; b < nofBunnies; ++b)
+        bunny.draw(proj*view*glm::translate(glm::mat4(1.f),glm::vec3(.01f*b,0.f,-.1f*b)));
+    }
+    auto const bunniesTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+    auto const&stats = gpu.getStats();
+    std::cout << "Seconds per frame (" << nofBunnies << " overlapping bunnies, "
+              << stats.hizRejectedTriangles / framesPerMeasurement << " triangles and "
+              << stats.hizRejectedTiles / framesPerMeasurement << " tiles rejected by hierarchical z per frame): "
+              << std::scientific << std::setprecision(10) << bunniesTime << std::endl;
+  }
+
+  // the same bunnies with fragment shader invocations counted for both draw orders and render modes,
+  // visibility buffer shades every covered pixel once regardless of draw order
+  {
+    GPU gpu;
+    gpu.createFramebuffer(width,height);
+    BunnyScene bunny(gpu);
+    uint32_t const nofBunnies = 20;
+    for(auto const mode:{RenderMode::FORWARD,RenderMode::VISIBILITY})
+      for(bool const backToFront:{false,true}){
+        gpu.setRenderMode(mode);
+        gpu.resetStats();
+        Timer<float>timer;
+        timer.reset();
+        for(size_t i = 0; i < framesPerMeasurement; ++i){
+          gpu.clear(0,0,0,1);
+          for(uint32_t b = 0; b < nofBunnies; ++b){
+            uint32_t const bunnyID = backToFront ? nofBunnies - 1 - b : b;
+            bunny.draw(proj*view*glm::translate(glm::mat4(1.f),glm::vec3(.01f*bunnyID,0.f,-.1f*bunnyID)));
+          }
+          gpu.resolveVisibilityBuffer();
+        }
+        auto const frameTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+        auto const depth = gpu.getFramebufferDepth();
+        auto const covered = std::count_if(depth,depth+width*height,[](float d){return d < 1.1f;});
+        std::cout << "Seconds per frame (" << nofBunnies << " bunnies, "
+                  << (mode == RenderMode::VISIBILITY ? "visibility buffer" : "forward") << ", "
+                  << (backToFront ? "back to front" : "front to back") << ", "
+                  << gpu.getStats().fragmentShaderInvocations / framesPerMeasurement << " fragment shader invocations for "
+                  << covered << " covered pixels per frame): "
+                  << std::scientific << std::setprecision(10) << frameTime << std::endl;
+      }
+  }
+
+  // application logic of the next frame runs while the render thread rasterizes the current frame
+  {
+    GPU gpu;
+    gpu.createFramebuffer(width,height);
+    BunnyScene bunny(gpu);
+    uint32_t const nofBunnies = 20;
+    std::vector<glm::mat4>mvps(nofBunnies);
+    auto logic = [&](size_t frame){
+      // animation with some extra work that stands for update of the scene
+      glm::mat4 work = glm::mat4(1.f);
+      for(uint32_t i = 0; i < 20000; ++i)
+        work = glm::rotate(work,.001f,glm::vec3(0.f,1.f,0.f));
+      for(uint32_t b = 0; b < nofBunnies; ++b)
+        mvps[b] = proj*view*glm::translate(glm::mat4(1.f),glm::vec3(.01f*b,0.f,-.1f*b))*glm::rotate(work,.01f*frame,glm::vec3(0.f,1.f,0.f));
+    };
+    for(bool const submitted:{false,true}){
+      CommandBuffer commandBuffer;
+      Fence previous;
+      Timer<float>timer;
+      timer.reset();
+      for(size_t i = 0; i < framesPerMeasurement; ++i){
+        logic(i);
+        if(submitted){
+          commandBuffer.reset();
+          commandBuffer.clear(0,0,0,1);
+          for(auto const&mvp:mvps)
+            bunny.record(commandBuffer,mvp);
+          // at most two frames are in flight
+          gpu.waitFence(previous);
+          previous = gpu.submit(commandBuffer);
+        }else{
+          gpu.clear(0,0,0,1);
+          for(auto const&mvp:mvps)
+            bunny.draw(mvp);
+        }
+      }
+      gpu.waitIdle();
+      auto const frameTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+      std::cout << "Seconds per frame (" << nofBunnies << " bunnies with application logic, "
+                << (submitted ? "command buffers on render thread" : "immediate commands") << "): "
+                << std::scientific << std::setprecision(10) << frameTime << std::endl;
+    }
+  }
+
+  // bunnies filling 4K framebuffer, tiled layout keeps pixels of raster tiles in few cache lines
+  {
+    uint32_t const width4K = 3840;
+    uint32_t const height4K = 2160;
+    GPU gpu;
+    gpu.createFramebuffer(width4K,height4K);
+    BunnyScene bunny(gpu);
+    auto const viewProjection = bunnyViewProjection(width4K,height4K);
+    auto const frames4K = std::max<size_t>(framesPerMeasurement/10,1);
+    for(auto const layout:{FramebufferLayout::LINEAR,FramebufferLayout::TILED}){
+      gpu.setFramebufferLayout(layout);
+      Timer<float>timer;
+      timer.reset();
+      for(size_t i = 0; i < frames4K; ++i){
+        gpu.clear(0,0,0,1);
+        for(uint32_t b = 0; b < 4; ++b)
+          bunny.draw(viewProjection*glm::translate(glm::mat4(1.f),glm::vec3(.02f*b,0.f,-.1f*b)));
+      }
+      auto const frameTime = timer.elapsedFromStart() / static_cast<float>(frames4K);
+      std::cout << "Seconds per frame (4 bunnies, " << width4K << "x" << height4K << ", "
+                << (layout == FramebufferLayout::TILED ? "tiled" : "linear") << " framebuffer): "
+                << std::scientific << std::setprecision(10) << frameTime << std::endl;
+
+      // clear writes pixels only when they are read back or rasterized
+      timer.reset();
+      for(size_t i = 0; i < frames4K; ++i)
+        gpu.clear(0,0,0,1);
+      auto const clearTime = timer.elapsedFromStart() / static_cast<float>(frames4K);
+      timer.reset();
+      for(size_t i = 0; i < frames4K; ++i){
+        gpu.clear(0,0,0,1);
+        gpu.getFramebufferColor();
+        gpu.getFramebufferDepth();
+      }
+      auto const clearReadTime = timer.elapsedFromStart() / static_cast<float>(frames4K);
+      std::cout << "Seconds per clear (" << width4K << "x" << height4K << ", "
+                << (layout == FramebufferLayout::TILED ? "tiled" : "linear") << " framebuffer): "
+                << std::scientific << std::setprecision(10) << clearTime << ", with read back: " << clearReadTime << std::endl;
+    }
+
+    // compact formats halve bandwidth of framebuffer
+    gpu.setFramebufferLayout(FramebufferLayout::TILED);
+    gpu.createFramebuffer(width4K,height4K,ColorFormat::RGB565,DepthFormat::D16);
+    Timer<float>timer;
+    timer.reset();
+    for(size_t i = 0; i < frames4K; ++i){
+      gpu.clear(0,0,0,1);
+      for(uint32_t b = 0; b < 4; ++b)
+        bunny.draw(viewProjection*glm::translate(glm::mat4(1.f),glm::vec3(.02f*b,0.f,-.1f*b)));
+    }
+    auto const compactTime = timer.elapsedFromStart() / static_cast<float>(frames4K);
+    std::cout << "Seconds per frame (4 bunnies, " << width4K << "x" << height4K << ", tiled RGB565 + D16 framebuffer): "
+              << std::scientific << std::setprecision(10) << compactTime << std::endl;
+  }
+
+  // presentation into 24 bit surface runs on presenter thread of swap chain while next frame is rendered
+  {
+    auto surface = SDL_CreateRGBSurface(0,width,height,24,0,0,0,0);
+    auto present = [&](uint8_t const*color,uint32_t w,uint32_t h){copyToSDLSurface(surface,color,w,h);};
+    auto&gpu = bunnyGpu;
+    Timer<float>timer;
+    timer.reset();
+    for(size_t i = 0; i < framesPerMeasurement; ++i){
+      gpu.clear(.5f,.5f,.5f,1.f);
+      bunny.draw(proj*view);
+      present(gpu.getFramebufferColor(),gpu.getFramebufferWidth(),gpu.getFramebufferHeight());
+    }
+    auto const syncTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+    std::cout << "Seconds per frame (synchronous present): " << std::scientific << std::setprecision(10)
+              << syncTime << std::endl;
+    for(uint32_t const nofImages:{2u,3u}){
+      SwapChain swapChain(nofImages,present);
+      swapChain.acquire(gpu);
+      timer.reset();
+      for(size_t i = 0; i < framesPerMeasurement; ++i){
+        gpu.clear(.5f,.5f,.5f,1.f);
+        bunny.draw(proj*view);
+        swapChain.present(gpu);
+      }
+      swapChain.finish();
+      // color buffer returns into memory of the GPU before images are freed
+      gpu.setColorBufferMemory(nullptr,0,false);
+      auto const asyncTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+      std::cout << "Seconds per frame (swap chain of " << nofImages << " framebuffers): " << std::scientific << std::setprecision(10)
+                << asyncTime << std::endl;
+    }
+    SDL_FreeSurface(surface);
+  }
+
+  // 1080p frame converted into window like surface or rendered directly into it
+  {
+    uint32_t const width1080 = 1920;
+    uint32_t const height1080 = 1080;
+    auto surface = SDL_CreateRGBSurfaceWithFormat(0,width1080,height1080,32,SDL_PIXELFORMAT_RGB888);
+    GPU gpu;
+    gpu.createFramebuffer(width1080,height1080,ColorFormat::BGRA8);
+    BunnyScene bunny(gpu);
+    auto const viewProjection = bunnyViewProjection(width1080,height1080);
+    for(bool const zeroCopy:{false,true}){
+      gpu.setColorBufferMemory(zeroCopy ? (uint8_t*)surface->pixels : nullptr,surface->pitch,true);
+      Timer<float>timer;
+      timer.reset();
+      for(size_t i = 0; i < framesPerMeasurement; ++i){
+        gpu.clear(0,0,0,1);
+        bunny.draw(viewProjection);
+        if(zeroCopy)
+          gpu.finish();
+        else
+          copyToSDLSurface(surface,gpu.getFramebufferColor(),width1080,height1080);
+      }
+      auto const frameTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+      std::cout << "Seconds per frame (bunny, " << width1080 << "x" << height1080 << ", "
+                << (zeroCopy ? "rendered into surface" : "converted into surface") << "): "
+                << std::scientific << std::setprecision(10) << frameTime << std::endl;
+    }
+    SDL_FreeSurface(surface);
+  }
+
+  // many small bunnies, instanced draw resolves draw state and reads indices once for all instances
+  {
+    GPU gpu;
+    gpu.createFramebuffer(width,height);
+    gpu.setVertexCacheMode(VertexCacheMode::FIFO);
+    BunnyScene bunny(gpu);
+    uint32_t const nofBunnies = 1000;
+    bunny.setInstances(bunnyInstances(nofBunnies));
+    auto const viewProjection = bunnyViewProjection(width,height);
+    auto const bunnyFrames = std::max<size_t>(framesPerMeasurement/10,1);
+    for(bool const instanced:{false,true}){
+      Timer<float>timer;
+      timer.reset();
+      for(size_t i = 0; i < bunnyFrames; ++i){
+        gpu.clear(0,0,0,1);
+        if(instanced)bunny.drawInstanced(viewProjection);
+        else         bunny.drawInstancesSeparately(viewProjection);
+      }
+      auto const frameTime = timer.elapsedFromStart() / static_cast<float>(bunnyFrames);
+      std::cout << "Seconds per frame (" << nofBunnies << " bunnies, "
+                << (instanced ? "one instanced draw call" : "one draw call per bunny") << "): "
+                << std::scientific << std::setprecision(10) << frameTime << std::endl;
+    }
+  }
+
+  // mesh split into many small draws, multi draw and indirect draw share setup and binning of all draws
+  {
+    GPU gpu;
+    gpu.createFramebuffer(width,height);
+    gpu.setVertexCacheMode(VertexCacheMode::FIFO);
+    gpu.setThreadCount(nofThreads);
+    BunnyScene bunny(gpu);
+    auto const viewProjection = bunnyViewProjection(width,height);
+    auto const pieces = bunnyPieces(1000);
+    auto const nofPieces = static_cast<uint32_t>(pieces.size());
+    BufferID dbo = gpu.createBuffer(sizeof(DrawIndirectCommand)*nofPieces);
+    gpu.setBufferData(dbo,0,sizeof(DrawIndirectCommand)*nofPieces,pieces.data());
+    for(uint32_t method = 0; method < 3; ++method){
+      Timer<float>timer;
+      timer.reset();
+      for(size_t i = 0; i < framesPerMeasurement; ++i){
+        gpu.clear(0,0,0,1);
+        gpu.bindVertexPuller(bunny.vao);
+        gpu.useProgram(bunny.prg);
+        gpu.programUniformMatrix4f(bunny.prg,0,viewProjection);
+        if(method == 0)
+          for(auto const&piece:pieces)
+            gpu.multiDrawTriangles(&piece,1);
+        if(method == 1)gpu.multiDrawTriangles(pieces.data(),nofPieces);
+        if(method == 2)gpu.drawTrianglesIndirect(dbo,0,nofPieces);
+      }
+      auto const frameTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+      char const*const names[] = {"one draw call per piece","one multi draw call","one indirect draw call"};
+      std::cout << "Seconds per frame (bunny in " << nofPieces << " pieces, " << nofThreads << " threads, "
+                << names[method] << "): " << std::scientific << std::setprecision(10) << frameTime << std::endl;
+    }
+  }
+
+  // meshes with their own buffers and vertex pullers or packed into one buffer pair and drawn with offsets
+  {
+    GPU gpu;
+    gpu.createFramebuffer(width,height);
+    gpu.setVertexCacheMode(VertexCacheMode::FIFO);
+    uint32_t const nofMeshes = 50;
+    std::vector<std::unique_ptr<BunnyScene>>meshes;
+    for(uint32_t m = 0; m < nofMeshes; ++m)
+      meshes.push_back(std::make_unique<BunnyScene>(gpu));
+
+    uint32_t const nofMeshVertices = sizeof(bunnyVertices)/sizeof(BunnyVertex);
+    BufferID vbo = gpu.createBuffer(sizeof(bunnyVertices)*nofMeshes);
+    BufferID ebo = gpu.createBuffer(sizeof(bunnyIndices)*nofMeshes);
+    for(uint32_t m = 0; m < nofMeshes; ++m){
+      gpu.setBufferData(vbo,sizeof(bunnyVertices)*m,sizeof(bunnyVertices),bunnyVertices);
+      gpu.setBufferData(ebo,sizeof(bunnyIndices)*m,sizeof(bunnyIndices),bunnyIndices);
+    }
+    auto vao = gpu.createVertexPuller();
+    gpu.setVertexPullerHead(vao,0,AttributeType::VEC3,sizeof(BunnyVertex),0                ,vbo);
+    gpu.setVertexPullerHead(vao,1,AttributeType::VEC3,sizeof(BunnyVertex),sizeof(float)*3,vbo);
+    gpu.enableVertexPullerHead(vao,0);
+    gpu.enableVertexPullerHead(vao,1);
+    gpu.setVertexPullerIndexing(vao,IndexType::UINT32,ebo);
+    auto const prg = meshes.front()->prg;
+
+    auto const instances = bunnyInstances(nofMeshes);
+    auto const viewProjection = bunnyViewProjection(width,height);
+    auto const mvp = [&](uint32_t m){
+      auto const&instance = instances[m];
+      return viewProjection*glm::scale(glm::translate(glm::mat4(1.f),glm::vec3(instance)),glm::vec3(instance.w));
+    };
+    for(bool const shared:{false,true}){
+      Timer<float>timer;
+      timer.reset();
+      for(size_t i = 0; i < framesPerMeasurement; ++i){
+        gpu.clear(0,0,0,1);
+        if(shared){
+          gpu.bindVertexPuller(vao);
+          gpu.useProgram(prg);
+        }
+        for(uint32_t m = 0; m < nofMeshes; ++m){
+          if(!shared){
+            meshes[m]->draw(mvp(m));
+            continue;
+          }
+          gpu.programUniformMatrix4f(prg,0,mvp(m));
+          gpu.drawTriangles(bunnyNofIndices,bunnyNofIndices*m,static_cast<int32_t>(nofMeshVertices*m));
+        }
+      }
+      auto const frameTime = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+      std::cout << "Seconds per frame (" << nofMeshes << " meshes, "
+                << (shared ? "one buffer pair with first index and base vertex" : "buffers per mesh") << "): "
+                << std::scientific << std::setprecision(10) << frameTime << std::endl;
+    }
+    gpu.deleteVertexPuller(vao);
+    gpu.deleteBuffer(ebo);
+    gpu.deleteBuffer(vbo);
+  }
+
+  // dense flag is dominated by vertex processing
+  auto flag = std::make_shared<CZFlagMethod>(1000,1000);
+  flag->gpu.createFramebuffer(width,height);
+  auto const flagFrames = std::max<size_t>(framesPerMeasurement/10,1);
+  auto const flagTime = measure(*flag,flagFrames);
+  flag->gpu.setThreadCount(nofThreads);
+  auto const flagThreadedTime = measure(*flag,flagFrames);
+
+  std::cout << "Czech flag 1000x1000 seconds per frame: " << std::scientific << std::setprecision(10)
+            << flagTime << std::endl;
+  std::cout << "Czech flag 1000x1000 seconds per frame (" << nofThreads << " threads): " << std::scientific << std::setprecision(10)
+            << flagThreadedTime << std::endl;
+
 }
@@ -4,9 +4,14 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <numeric>
 
+#include <student/bunny.hpp>
 #include <student/gpu.hpp>
+#include <tests/allocationCounter.hpp>
+#include <tests/bunnyScene.hpp>
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -505,3 +510,647 @@ SCENARIO("vertex shader should receive correct attributes when using offset and
   REQUIRE(inVertices[5].attributes[0].v1 == 3.f);
 
 }
+
+SCENARIO("allocation counter should count allocations of C and C++ library"){
+  std::cerr << "48 - allocation counter" << std::endl;
+  if(!isAllocationCountingAvailable()){
+    WARN("allocations are counted only by izgProjectTests");
+    return;
+  }
+
+  // volatile keeps compiler from eliding allocations
+  startAllocationCounting();
+  void*volatile memory = std::malloc(16);
+  memory = std::realloc(memory,32);
+  std::free(memory);
+  memory = std::calloc(4,4);
+  std::free(memory);
+  int*volatile value = new int(0);
+  delete value;
+  auto const nofAllocations = stopAllocationCounting();
+
+  REQUIRE(nofAllocations == 4);
+}
+
+SCENARIO("vertex puller should not allocate memory when drawing a frame"){
+  std::cerr << "49 - vertex puller, no allocations per frame" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(200,200);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(200,200);
+
+  gpu.clear(0,0,0,1);
+  bunny.draw(mvp);
+
+  startAllocationCounting();
+  gpu.clear(0,0,0,1);
+  bunny.draw(mvp);
+  auto const nofAllocations = stopAllocationCounting();
+
+  if(isAllocationCountingAvailable())
+    REQUIRE(nofAllocations == 0);
+}
+
+SCENARIO("post-transform vertex cache should execute vertex shader once per unique index"){
+  std::cerr << "50 - vertex shader, post-transform vertex cache" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  std::vector<uint16_t> indices = {0,1,2,2,1,3,3,1,0};
+  auto indicesSize = indices.size()*sizeof(decltype(indices)::value_type);
+  BufferID ebo = gpu.createBuffer(indicesSize);
+  gpu.setBufferData(ebo,0,indicesSize,indices.data());
+
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerIndexing(vao,IndexType::UINT16,ebo);
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderCounter,fragmentShaderEmpty);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  gpu.setVertexCacheMode(VertexCacheMode::FULL);
+  vertexShaderInvocationCounter = 0;
+  gpu.drawTriangles(static_cast<uint32_t>(indices.size()));
+  REQUIRE(vertexShaderInvocationCounter == 4);
+  REQUIRE(gpu.getStats().vertexCacheMisses == 4);
+  REQUIRE(gpu.getStats().vertexCacheHits   == 5);
+
+  gpu.resetStats();
+  gpu.setVertexCacheMode(VertexCacheMode::FIFO,2);
+  vertexShaderInvocationCounter = 0;
+  gpu.drawTriangles(static_cast<uint32_t>(indices.size()));
+  REQUIRE(vertexShaderInvocationCounter == 6);
+  REQUIRE(gpu.getStats().vertexCacheHits == 3);
+
+  gpu.setVertexCacheMode(VertexCacheMode::DISABLED);
+  vertexShaderInvocationCounter = 0;
+  gpu.drawTriangles(static_cast<uint32_t>(indices.size()));
+  REQUIRE(vertexShaderInvocationCounter == indices.size());
+}
+
+SCENARIO("post-transform vertex cache should not change rendered image"){
+  std::cerr << "51 - vertex shader, post-transform vertex cache image" << std::endl;
+  uint32_t const w = 200;
+  uint32_t const h = 200;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto render = [&](VertexCacheMode mode){
+    gpu.setVertexCacheMode(mode);
+    gpu.clear(0,0,0,1);
+    bunny.draw(mvp);
+    return captureColor(gpu);
+  };
+
+  auto const reference = render(VertexCacheMode::DISABLED);
+  REQUIRE(gpu.getStats().vertexCacheHits+gpu.getStats().vertexCacheMisses == 0);
+
+  REQUIRE(render(VertexCacheMode::FIFO) == reference);
+  REQUIRE(gpu.getStats().vertexCacheHitRate() > 0.f);
+  REQUIRE(gpu.getStats().vertexCacheMisses < bunnyNofIndices);
+
+  gpu.resetStats();
+  REQUIRE(render(VertexCacheMode::FULL) == reference);
+  REQUIRE(gpu.getStats().vertexCacheMisses == 1048);
+}
+
+void vertexShaderCollapsed(OutVertex&out,InVertex const&,Uniforms const&){
+  out.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
+  vertexShaderInvocationCounter++;
+}
+
+SCENARIO("huge draw calls should be streamed through pipeline in bounded memory"){
+  std::cerr << "52 - vertex shader, streaming of huge draw calls" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderCollapsed,fragmentShaderEmpty);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  gpu.drawTriangles(primitiveChunkSize);
+
+  uint32_t const nofVertices = 1000*primitiveChunkSize + 3;
+  vertexShaderInvocationCounter = 0;
+  startAllocationCounting();
+  gpu.drawTriangles(nofVertices);
+  auto const nofAllocations = stopAllocationCounting();
+
+  REQUIRE(vertexShaderInvocationCounter == nofVertices);
+  if(isAllocationCountingAvailable())
+    REQUIRE(nofAllocations == 0);
+}
+
+std::atomic<uint32_t>parallelVertexShaderCounter{0};
+std::vector<std::atomic<uint32_t>>parallelVertexIDs(3*20000);
+void vertexShaderParallel(OutVertex&out,InVertex const&in,Uniforms const&){
+  out.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
+  parallelVertexShaderCounter++;
+  parallelVertexIDs.at(in.gl_VertexID)++;
+}
+
+SCENARIO("vertex shader should be executed once per invocation when running on worker threads"){
+  std::cerr << "53 - vertex shader, parallel execution" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+  gpu.setThreadCount(4);
+
+  auto vao = gpu.createVertexPuller();
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderParallel,fragmentShaderEmpty);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  auto const nofVertices = static_cast<uint32_t>(parallelVertexIDs.size());
+  parallelVertexShaderCounter = 0;
+  gpu.drawTriangles(nofVertices);
+
+  REQUIRE(parallelVertexShaderCounter == nofVertices);
+  for(auto const&count:parallelVertexIDs)
+    REQUIRE(count == 1);
+}
+
+SCENARIO("parallel vertex shader should not change rendered image"){
+  std::cerr << "54 - vertex shader, parallel execution image" << std::endl;
+  uint32_t const w = 200;
+  uint32_t const h = 200;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto render = [&](uint32_t nofThreads,VertexCacheMode mode){
+    gpu.setThreadCount(nofThreads);
+    gpu.setVertexCacheMode(mode);
+    gpu.clear(0,0,0,1);
+    bunny.draw(mvp);
+    return captureColor(gpu);
+  };
+
+  auto const reference = render(1,VertexCacheMode::DISABLED);
+  REQUIRE(render(4,VertexCacheMode::DISABLED) == reference);
+  REQUIRE(render(4,VertexCacheMode::FIFO    ) == reference);
+  REQUIRE(render(4,VertexCacheMode::FULL    ) == reference);
+}
+
+std::vector<uint32_t>batchVertexIds;
+std::vector<float   >batchVertexAttributes;
+void vertexShaderBatchRecorder(OutVertexBatch&out,InVertexBatch const&in,Uniforms const&){
+  for(uint32_t v=0;v<in.count;++v){
+    batchVertexIds       .push_back(in.gl_VertexID[v]);
+    batchVertexAttributes.push_back(in.attributes[3][0][v]);
+  }
+  for(uint32_t c=0;c<4;++c)
+    for(uint32_t v=0;v<vertexShaderBatchSize;++v)
+      out.gl_Position[c][v] = c==3?1.f:0.f;
+}
+
+SCENARIO("batched vertex shader should receive all vertices in structure of arrays form"){
+  std::cerr << "55 - batched vertex shader" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  uint32_t const nofVertices = 3*7;
+  std::vector<float>values;
+  for(uint32_t i=0;i<nofVertices;++i)values.push_back(10.f+i);
+  BufferID vbo = gpu.createBuffer(values.size()*sizeof(float));
+  gpu.setBufferData(vbo,0,values.size()*sizeof(float),values.data());
+
+  std::vector<uint8_t>indices;
+  for(uint32_t i=0;i<nofVertices;++i)indices.push_back(static_cast<uint8_t>(nofVertices-1-i));
+  BufferID ebo = gpu.createBuffer(indices.size());
+  gpu.setBufferData(ebo,0,indices.size(),indices.data());
+
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,3,AttributeType::FLOAT,sizeof(float),0,vbo);
+  gpu.enableVertexPullerHead(vao,3);
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderBatchRecorder,fragmentShaderEmpty);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  batchVertexIds.clear();
+  batchVertexAttributes.clear();
+  gpu.drawTriangles(nofVertices);
+  REQUIRE(batchVertexIds.size() == nofVertices);
+  for(uint32_t i=0;i<nofVertices;++i){
+    REQUIRE(batchVertexIds[i] == i);
+    REQUIRE(batchVertexAttributes[i] == values[i]);
+  }
+
+  gpu.setVertexPullerIndexing(vao,IndexType::UINT8,ebo);
+  batchVertexIds.clear();
+  batchVertexAttributes.clear();
+  gpu.drawTriangles(nofVertices);
+  REQUIRE(batchVertexIds.size() == nofVertices);
+  for(uint32_t i=0;i<nofVertices;++i){
+    REQUIRE(batchVertexIds[i] == indices[i]);
+    REQUIRE(batchVertexAttributes[i] == values[indices[i]]);
+  }
+}
+
+SCENARIO("batched vertex shader should render the same image as scalar vertex shader"){
+  std::cerr << "56 - batched vertex shader image" << std::endl;
+  uint32_t const w = 200;
+  uint32_t const h = 200;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto render = [&](uint32_t nofThreads,VertexCacheMode mode){
+    gpu.setThreadCount(nofThreads);
+    gpu.setVertexCacheMode(mode);
+    gpu.clear(0,0,0,1);
+    bunny.draw(mvp);
+    return captureColor(gpu);
+  };
+
+  auto const reference = render(1,VertexCacheMode::DISABLED);
+  bunny.useBatchedVertexShader();
+  REQUIRE(render(1,VertexCacheMode::DISABLED) == reference);
+  REQUIRE(render(1,VertexCacheMode::FULL    ) == reference);
+  REQUIRE(render(4,VertexCacheMode::FIFO    ) == reference);
+}
+
+struct InstanceRecord{
+  uint32_t vertexID;
+  uint32_t instanceID;
+  float    perVertex;
+  float    perInstance;
+};
+std::vector<InstanceRecord>instanceRecords;
+void vertexShaderInstanceRecorder(OutVertex&out,InVertex const&in,Uniforms const&){
+  instanceRecords.push_back({in.gl_VertexID,in.gl_InstanceID,in.attributes[0].v1,in.attributes[1].v1});
+  out.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
+}
+
+void vertexShaderBatchInstanceRecorder(OutVertexBatch&out,InVertexBatch const&in,Uniforms const&){
+  for(uint32_t v=0;v<in.count;++v)
+    instanceRecords.push_back({in.gl_VertexID[v],in.gl_InstanceID[v],in.attributes[0][0][v],in.attributes[1][0][v]});
+  for(uint32_t c=0;c<4;++c)
+    for(uint32_t v=0;v<vertexShaderBatchSize;++v)
+      out.gl_Position[c][v] = c==3?1.f:0.f;
+}
+
+SCENARIO("instanced draw should run vertex shader for every vertex of every instance"){
+  std::cerr << "57 - vertex shader, gl_InstanceID and per-instance attributes" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  uint32_t const nofVertices  = 6;
+  uint32_t const nofInstances = 5;
+  std::vector<float>perVertex;
+  for(uint32_t i=0;i<nofVertices;++i)perVertex.push_back(10.f+i);
+  std::vector<float>perInstance;
+  for(uint32_t i=0;i<nofInstances;++i)perInstance.push_back(100.f+i);
+  BufferID vbo = gpu.createBuffer(perVertex.size()*sizeof(float));
+  gpu.setBufferData(vbo,0,perVertex.size()*sizeof(float),perVertex.data());
+  BufferID ibo = gpu.createBuffer(perInstance.size()*sizeof(float));
+  gpu.setBufferData(ibo,0,perInstance.size()*sizeof(float),perInstance.data());
+
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,0,AttributeType::FLOAT,sizeof(float),0,vbo);
+  gpu.setVertexPullerHead(vao,1,AttributeType::FLOAT,sizeof(float),0,ibo);
+  gpu.setVertexPullerHeadDivisor(vao,1,2);
+  gpu.enableVertexPullerHead(vao,0);
+  gpu.enableVertexPullerHead(vao,1);
+  auto prg = gpu.createProgram();
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  for(bool const batched:{false,true}){
+    if(batched)gpu.attachShaders(prg,vertexShaderBatchInstanceRecorder,fragmentShaderEmpty);
+    else       gpu.attachShaders(prg,vertexShaderInstanceRecorder     ,fragmentShaderEmpty);
+
+    instanceRecords.clear();
+    gpu.drawTrianglesInstanced(nofVertices,nofInstances);
+    REQUIRE(instanceRecords.size() == nofVertices*nofInstances);
+    for(uint32_t i=0;i<nofInstances;++i)
+      for(uint32_t v=0;v<nofVertices;++v){
+        auto const&record = instanceRecords[i*nofVertices+v];
+        REQUIRE(record.vertexID    == v);
+        REQUIRE(record.instanceID  == i);
+        REQUIRE(record.perVertex   == perVertex[v]);
+        REQUIRE(record.perInstance == perInstance[i/2]);
+      }
+
+    // draw call that is not instanced draws instance 0
+    instanceRecords.clear();
+    gpu.drawTriangles(nofVertices);
+    REQUIRE(instanceRecords.size() == nofVertices);
+    for(auto const&record:instanceRecords){
+      REQUIRE(record.instanceID  == 0);
+      REQUIRE(record.perInstance == perInstance[0]);
+    }
+  }
+}
+
+SCENARIO("instanced draw should reuse post-transform vertex cache lookups within every instance"){
+  std::cerr << "58 - vertex shader, post-transform vertex cache of instanced draw" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  std::vector<float>values = {10.f,11.f,12.f,13.f};
+  BufferID vbo = gpu.createBuffer(values.size()*sizeof(float));
+  gpu.setBufferData(vbo,0,values.size()*sizeof(float),values.data());
+  std::vector<uint16_t>indices = {0,1,2,2,1,3};
+  BufferID ebo = gpu.createBuffer(indices.size()*sizeof(uint16_t));
+  gpu.setBufferData(ebo,0,indices.size()*sizeof(uint16_t),indices.data());
+
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,0,AttributeType::FLOAT,sizeof(float),0,vbo);
+  gpu.enableVertexPullerHead(vao,0);
+  gpu.setVertexPullerIndexing(vao,IndexType::UINT16,ebo);
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderInstanceRecorder,fragmentShaderEmpty);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  uint32_t const nofInstances = 3;
+  for(auto const mode:{VertexCacheMode::FIFO,VertexCacheMode::FULL}){
+    gpu.setVertexCacheMode(mode);
+    gpu.resetStats();
+    instanceRecords.clear();
+    gpu.drawTrianglesInstanced(static_cast<uint32_t>(indices.size()),nofInstances);
+
+    // every instance transforms its unique vertices once
+    REQUIRE(instanceRecords.size() == values.size()*nofInstances);
+    for(uint32_t i=0;i<instanceRecords.size();++i){
+      auto const&record = instanceRecords[i];
+      REQUIRE(record.instanceID == i/values.size());
+      REQUIRE(record.perVertex  == values[record.vertexID]);
+    }
+    REQUIRE(gpu.getStats().vertexCacheMisses == values.size()*nofInstances);
+    REQUIRE(gpu.getStats().vertexCacheHits   == (indices.size()-values.size())*nofInstances);
+  }
+}
+
+SCENARIO("instanced draw should render the same image as one draw call per instance"){
+  std::cerr << "59 - instanced draw image" << std::endl;
+  uint32_t const w = 150;
+  uint32_t const h = 150;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  bunny.setInstances(bunnyInstances(40));
+  auto const mvp = bunnyViewProjection(w,h);
+
+  auto render = [&](bool instanced){
+    gpu.clear(0,0,0,1);
+    if(instanced)bunny.drawInstanced(mvp);
+    else         bunny.drawInstancesSeparately(mvp);
+    gpu.resolveVisibilityBuffer();
+    return captureColor(gpu);
+  };
+
+  auto const reference = render(false);
+  REQUIRE(std::count(reference.begin(),reference.end(),0) < w*h*3);
+  REQUIRE(render(true) == reference);
+  for(uint32_t nofThreads:{1u,4u})
+    for(auto const mode:{VertexCacheMode::DISABLED,VertexCacheMode::FIFO,VertexCacheMode::FULL}){
+      gpu.setThreadCount(nofThreads);
+      gpu.setVertexCacheMode(mode);
+      REQUIRE(render(true) == reference);
+    }
+  gpu.setThreadCount(1);
+  gpu.setRenderMode(RenderMode::VISIBILITY);
+  REQUIRE(render(true) == reference);
+}
+
+SCENARIO("multi draw should execute draws in order with their first index, base vertex and instances"){
+  std::cerr << "60 - vertex shader, multi draw and indirect draw" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  std::vector<float>perVertex;
+  for(uint32_t i=0;i<8;++i)perVertex.push_back(10.f+i);
+  std::vector<float>perInstance = {100.f,101.f};
+  std::vector<uint16_t>indices = {0,1,2, 2,1,3, 0,2,1};
+  BufferID vbo = gpu.createBuffer(perVertex.size()*sizeof(float));
+  gpu.setBufferData(vbo,0,perVertex.size()*sizeof(float),perVertex.data());
+  BufferID ibo = gpu.createBuffer(perInstance.size()*sizeof(float));
+  gpu.setBufferData(ibo,0,perInstance.size()*sizeof(float),perInstance.data());
+  BufferID ebo = gpu.createBuffer(indices.size()*sizeof(uint16_t));
+  gpu.setBufferData(ebo,0,indices.size()*sizeof(uint16_t),indices.data());
+
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,0,AttributeType::FLOAT,sizeof(float),0,vbo);
+  gpu.setVertexPullerHead(vao,1,AttributeType::FLOAT,sizeof(float),0,ibo);
+  gpu.setVertexPullerHeadDivisor(vao,1,1);
+  gpu.enableVertexPullerHead(vao,0);
+  gpu.enableVertexPullerHead(vao,1);
+  gpu.setVertexPullerIndexing(vao,IndexType::UINT16,ebo);
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderInstanceRecorder,fragmentShaderEmpty);
+  gpu.bindVertexPuller(vao);
+  gpu.useProgram(prg);
+
+  std::vector<DrawIndirectCommand>draws(4);
+  draws[0].count = 3;draws[0].firstIndex = 0;draws[0].baseVertex = 0;draws[0].instanceCount = 1;
+  draws[1].count = 3;draws[1].firstIndex = 3;draws[1].baseVertex = 4;draws[1].instanceCount = 2;
+  draws[2].count = 3;draws[2].firstIndex = 0;draws[2].baseVertex = 0;draws[2].instanceCount = 0;
+  draws[3].count = 6;draws[3].firstIndex = 3;draws[3].baseVertex = 1;draws[3].instanceCount = 1;
+
+  std::vector<InstanceRecord>expected;
+  for(auto const&draw:draws)
+    for(uint32_t i=0;i<draw.instanceCount;++i)
+      for(uint32_t v=0;v<draw.count;++v){
+        uint32_t const id = indices[draw.firstIndex+v]+draw.baseVertex;
+        expected.push_back({id,i,perVertex[id],perInstance[i]});
+      }
+
+  auto check = [&]{
+    REQUIRE(instanceRecords.size() == expected.size());
+    for(size_t r=0;r<expected.size();++r){
+      REQUIRE(instanceRecords[r].vertexID    == expected[r].vertexID   );
+      REQUIRE(instanceRecords[r].instanceID  == expected[r].instanceID );
+      REQUIRE(instanceRecords[r].perVertex   == expected[r].perVertex  );
+      REQUIRE(instanceRecords[r].perInstance == expected[r].perInstance);
+    }
+  };
+
+  instanceRecords.clear();
+  gpu.multiDrawTriangles(draws.data(),static_cast<uint32_t>(draws.size()));
+  check();
+
+  // records are read from buffer, the first record is skipped by offset
+  std::vector<DrawIndirectCommand>records = draws;
+  records.insert(records.begin(),DrawIndirectCommand());
+  BufferID dbo = gpu.createBuffer(records.size()*sizeof(DrawIndirectCommand));
+  gpu.setBufferData(dbo,0,records.size()*sizeof(DrawIndirectCommand),records.data());
+  instanceRecords.clear();
+  gpu.drawTrianglesIndirect(dbo,sizeof(DrawIndirectCommand),static_cast<uint32_t>(draws.size()));
+  check();
+
+  // records outside of buffer are not executed
+  instanceRecords.clear();
+  gpu.drawTrianglesIndirect(dbo,sizeof(DrawIndirectCommand)*2,static_cast<uint32_t>(draws.size()));
+  REQUIRE(instanceRecords.empty());
+
+  // post-transform cache does not mix vertices of draws with different base vertex
+  gpu.setVertexCacheMode(VertexCacheMode::FULL);
+  instanceRecords.clear();
+  gpu.multiDrawTriangles(draws.data(),static_cast<uint32_t>(draws.size()));
+  for(auto const&record:instanceRecords)
+    REQUIRE(record.perVertex == perVertex[record.vertexID]);
+}
+
+SCENARIO("multi draw of pieces of mesh should render the same image as one draw call"){
+  std::cerr << "61 - multi draw image" << std::endl;
+  uint32_t const w = 150;
+  uint32_t const h = 150;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+  auto const pieces = bunnyPieces(100);
+  BufferID dbo = gpu.createBuffer(pieces.size()*sizeof(DrawIndirectCommand));
+  gpu.setBufferData(dbo,0,pieces.size()*sizeof(DrawIndirectCommand),pieces.data());
+
+  auto render = [&](uint32_t method){
+    gpu.clear(0,0,0,1);
+    if(method == 0)bunny.draw(mvp);
+    if(method == 1)bunny.multiDraw(mvp,pieces);
+    if(method == 2){
+      gpu.bindVertexPuller(bunny.vao);
+      gpu.useProgram(bunny.prg);
+      gpu.programUniformMatrix4f(bunny.prg,0,mvp);
+      gpu.drawTrianglesIndirect(dbo,0,static_cast<uint32_t>(pieces.size()));
+      gpu.unbindVertexPuller();
+    }
+    gpu.resolveVisibilityBuffer();
+    return captureColor(gpu);
+  };
+
+  auto const reference = render(0);
+  for(uint32_t nofThreads:{1u,4u})
+    for(auto const mode:{VertexCacheMode::DISABLED,VertexCacheMode::FIFO,VertexCacheMode::FULL}){
+      gpu.setThreadCount(nofThreads);
+      gpu.setVertexCacheMode(mode);
+      REQUIRE(render(1) == reference);
+      REQUIRE(render(2) == reference);
+    }
+  gpu.setThreadCount(1);
+  gpu.setRenderMode(RenderMode::VISIBILITY);
+  REQUIRE(render(1) == reference);
+}
+
+template<typename INDEX>
+BufferID createIndexBuffer(GPU&gpu,std::vector<uint32_t>const&indices){
+  std::vector<INDEX>data(indices.begin(),indices.end());
+  BufferID ebo = gpu.createBuffer(data.size()*sizeof(INDEX));
+  gpu.setBufferData(ebo,0,data.size()*sizeof(INDEX),data.data());
+  return ebo;
+}
+
+SCENARIO("draw call should read indices from first index and add base vertex for every index type"){
+  std::cerr << "62 - vertex shader, first index and base vertex" << std::endl;
+  auto gpu = GPU();
+  gpu.createFramebuffer(100,100);
+
+  // two meshes packed in one buffer pair, the second mesh starts at index 3 and at vertex 4
+  std::vector<float>values;
+  for(uint32_t i=0;i<12;++i)values.push_back(10.f+i);
+  std::vector<uint32_t>indices = {0,1,2, 2,0,1,1,2,0};
+  BufferID vbo = gpu.createBuffer(values.size()*sizeof(float));
+  gpu.setBufferData(vbo,0,values.size()*sizeof(float),values.data());
+
+  auto prg = gpu.createProgram();
+  gpu.attachShaders(prg,vertexShaderInstanceRecorder,fragmentShaderEmpty);
+  gpu.useProgram(prg);
+
+  auto check = [&](std::vector<uint32_t>const&expected){
+    REQUIRE(instanceRecords.size() == expected.size());
+    for(size_t r=0;r<expected.size();++r){
+      REQUIRE(instanceRecords[r].vertexID  == expected[r]);
+      REQUIRE(instanceRecords[r].perVertex == values[expected[r]]);
+    }
+  };
+
+  std::vector<BufferID>ebos = {
+    createIndexBuffer<uint8_t >(gpu,indices),
+    createIndexBuffer<uint16_t>(gpu,indices),
+    createIndexBuffer<uint32_t>(gpu,indices),
+  };
+  IndexType const types[] = {IndexType::UINT8,IndexType::UINT16,IndexType::UINT32};
+  for(uint32_t t=0;t<3;++t){
+    auto vao = gpu.createVertexPuller();
+    gpu.setVertexPullerHead(vao,0,AttributeType::FLOAT,sizeof(float),0,vbo);
+    gpu.enableVertexPullerHead(vao,0);
+    gpu.setVertexPullerIndexing(vao,types[t],ebos[t]);
+    gpu.bindVertexPuller(vao);
+    for(auto const mode:{VertexCacheMode::DISABLED,VertexCacheMode::FIFO,VertexCacheMode::FULL}){
+      gpu.setVertexCacheMode(mode);
+      instanceRecords.clear();
+      gpu.drawTriangles(6,3,4);
+      if(mode == VertexCacheMode::DISABLED)check({6,4,5,5,6,4});
+      else                                 check({6,4,5});
+
+      // offsets of the first mesh do not change the default draw call
+      instanceRecords.clear();
+      gpu.drawTriangles(3,0,0);
+      if(mode == VertexCacheMode::DISABLED)check({0,1,2});
+    }
+    gpu.setVertexCacheMode(VertexCacheMode::DISABLED);
+    gpu.deleteVertexPuller(vao);
+  }
+
+  // without indexing the first index selects the first vertex
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,0,AttributeType::FLOAT,sizeof(float),0,vbo);
+  gpu.enableVertexPullerHead(vao,0);
+  gpu.bindVertexPuller(vao);
+  instanceRecords.clear();
+  gpu.drawTriangles(6,3,2);
+  check({5,6,7,8,9,10});
+}
+
+SCENARIO("mesh in shared buffers should render the same image as mesh in its own buffers"){
+  std::cerr << "63 - first index and base vertex image" << std::endl;
+  uint32_t const w = 150;
+  uint32_t const h = 150;
+  auto gpu = GPU();
+  gpu.createFramebuffer(w,h);
+  auto bunny = BunnyScene(gpu);
+  auto const mvp = bunnyViewProjection(w,h);
+
+  // bunny is preceded by another mesh in both buffers
+  uint32_t const nofBunnyVertices = sizeof(bunnyVertices)/sizeof(BunnyVertex);
+  uint32_t const otherVertices = 7;
+  uint32_t const otherIndices = 9;
+  BufferID vbo = gpu.createBuffer(sizeof(BunnyVertex)*(otherVertices+nofBunnyVertices));
+  gpu.setBufferData(vbo,sizeof(BunnyVertex)*otherVertices,sizeof(bunnyVertices),bunnyVertices);
+  BufferID ebo = gpu.createBuffer(sizeof(VertexIndex)*(otherIndices+bunnyNofIndices));
+  gpu.setBufferData(ebo,sizeof(VertexIndex)*otherIndices,sizeof(bunnyIndices),bunnyIndices);
+  auto vao = gpu.createVertexPuller();
+  gpu.setVertexPullerHead(vao,0,AttributeType::VEC3,sizeof(BunnyVertex),0                ,vbo);
+  gpu.setVertexPullerHead(vao,1,AttributeType::VEC3,sizeof(BunnyVertex),sizeof(float)*3,vbo);
+  gpu.enableVertexPullerHead(vao,0);
+  gpu.enableVertexPullerHead(vao,1);
+  gpu.setVertexPullerIndexing(vao,IndexType::UINT32,ebo);
+
+  auto render = [&](bool shared){
+    gpu.clear(0,0,0,1);
+    if(shared){
+      gpu.bindVertexPuller(vao);
+      gpu.useProgram(bunny.prg);
+      gpu.programUniformMatrix4f(bunny.prg,0,mvp);
+      gpu.drawTriangles(bunnyNofIndices,otherIndices,otherVertices);
+    }else
+      bunny.draw(mvp);
+    return captureColor(gpu);
+  };
+
+  auto const reference = render(false);
+  for(uint32_t nofThreads:{1u,4u})
+    for(auto const mode:{VertexCacheMode::DISABLED,VertexCacheMode::FIFO,VertexCacheMode::FULL}){
+      gpu.setThreadCount(nofThreads);
+      gpu.setVertexCacheMode(mode);
+      REQUIRE(render(true) == reference);
+    }
+}